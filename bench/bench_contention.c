@@ -0,0 +1,247 @@
+// Renders a tree on the main thread while writer threads move and relink its
+// nodes, to see how frame latency holds up as writers are added. Build it
+// with ACGL_SANITIZE_THREAD=ON to have ThreadSanitizer watch the same run.
+//
+//   bench_contention [writers] [ops/s per writer] [% structure ops] [seconds]
+//
+// 0 ops/s runs the writers as fast as they can. Geometry ops lock a random
+// leaf (any writer may pick it) and move it; structure ops move the first
+// child of a parent the writer owns to the back. Defaults: 4 1000 10 5
+#include "gui.h"
+#include "threads.h"
+#include "clock.h"
+#include <string.h>
+
+#define BENCH_FANOUT 8
+#define BENCH_DEPTH 3
+#define BENCH_MAX_WRITERS 64
+#define BENCH_MAX_FRAMES (1 << 20)
+
+typedef struct {
+	ACGL_gui_object_t** parents; // only this writer relinks their children
+	size_t parents_size;
+	ACGL_gui_object_t** leaves;  // shared by every writer
+	size_t leaves_size;
+	int structure_percent;
+	Uint32 seed;
+
+	// only read once the thread is joined
+	Uint64 ops;
+	Uint64 lock_waits;
+	Uint64 lock_wait;
+	Uint64 lock_wait_max;
+} bench_writer_t;
+
+typedef struct {
+	ACGL_gui_object_t** parents;
+	size_t parents_size;
+	ACGL_gui_object_t** leaves;
+	size_t leaves_size;
+} bench_tree_t;
+
+static Uint32 bench_random(Uint32* seed) {
+	// xorshift32
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+static void bench_build(ACGL_gui_t* gui, bench_tree_t* tree, ACGL_gui_object_t* parent, int depth) {
+	if (depth == 0) {
+		tree->leaves[tree->leaves_size++] = parent;
+		return;
+	}
+	if (parent != gui->root) {
+		tree->parents[tree->parents_size++] = parent;
+	}
+	for (int i = 0; i < BENCH_FANOUT; ++i) {
+		ACGL_gui_object_t* child = ACGL_gui_node_init(gui, NULL, NULL, NULL);
+		if (child == NULL) {
+			return;
+		}
+		child->w = 1.0f / BENCH_FANOUT;
+		child->w_frac = true;
+		child->anchor = ACGL_GUI_ANCHOR_LEFT;
+		child->x = (ACGL_gui_pos_t)i / BENCH_FANOUT;
+		child->x_frac = true;
+		ACGL_gui_node_add_child_back(parent, child);
+		bench_build(gui, tree, child, depth - 1);
+	}
+}
+
+static bool bench_write(void* data) {
+	bench_writer_t* writer = (bench_writer_t*)data;
+	Uint32 pick = bench_random(&writer->seed);
+	if (writer->parents_size > 0 && (int)(pick % 100) < writer->structure_percent) {
+		ACGL_gui_object_t* parent = writer->parents[(pick / 100) % writer->parents_size];
+		ACGL_gui_object_t* child = parent->first_child;
+		ACGL_gui_node_remove_child(parent, child);
+		ACGL_gui_node_add_child_back(parent, child);
+	} else {
+		ACGL_gui_object_t* leaf = writer->leaves[(pick / 100) % writer->leaves_size];
+		// same accounting as ACGL_thread_lock_data: a free lock costs no clock reads
+		++writer->lock_waits;
+		if (ACGL_MUTEX_TRYLOCK(leaf->mutex) != 0) {
+			Uint64 started = ACGL_clock_now();
+			if (ACGL_gui_node_lock(leaf) != 0) {
+				return false;
+			}
+			Uint64 waited = ACGL_clock_now() - started;
+			writer->lock_wait += waited;
+			if (waited > writer->lock_wait_max) {
+				writer->lock_wait_max = waited;
+			}
+		}
+		leaf->h = 0.5f + (ACGL_gui_pos_t)(pick % 64) / 128;
+		leaf->h_frac = true;
+		leaf->needs_layout = true;
+		ACGL_gui_node_unlock(leaf);
+	}
+	++writer->ops;
+	return true;
+}
+
+static int bench_compare(const void* a, const void* b) {
+	Uint64 x = *(const Uint64*)a;
+	Uint64 y = *(const Uint64*)b;
+	return x < y ? -1 : x > y;
+}
+
+static Uint64 bench_percentile(const Uint64* sorted, size_t size, double percentile) {
+	if (size == 0) {
+		return 0;
+	}
+	size_t index = (size_t)(percentile / 100 * (double)(size - 1) + 0.5);
+	return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+	int writers_size = argc > 1 ? atoi(argv[1]) : 4;
+	int rate = argc > 2 ? atoi(argv[2]) : 1000;
+	int structure_percent = argc > 3 ? atoi(argv[3]) : 10;
+	int seconds = argc > 4 ? atoi(argv[4]) : 5;
+	if (writers_size < 0 || writers_size > BENCH_MAX_WRITERS || rate < 0 || seconds <= 0) {
+		fprintf(stderr, "usage: %s [writers, at most %d] [ops/s per writer] [%% structure ops] [seconds]\n", argv[0], BENCH_MAX_WRITERS);
+		return 1;
+	}
+#if !ACGL_THREADING
+	if (writers_size > 0) {
+		// they would edit the tree under the renderer with nothing in between
+		fprintf(stderr, "ACGL_THREADING is OFF, running without writers\n");
+		writers_size = 0;
+	}
+#endif
+
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		fprintf(stderr, "Error: could not init SDL. SDL_Error: %s\n", SDL_GetError());
+		return 1;
+	}
+	SDL_Window* window = SDL_CreateWindow("bench_contention", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1280, 720, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if (window == NULL) {
+		fprintf(stderr, "Error: could not create window. SDL_Error: %s\n", SDL_GetError());
+		SDL_Quit();
+		return 1;
+	}
+	ACGL_gui_t* gui = ACGL_gui_init(window);
+	Uint64* frames = (Uint64*)malloc(BENCH_MAX_FRAMES * sizeof(Uint64));
+	size_t leaves = 1;
+	size_t parents = 0;
+	for (int i = 0; i < BENCH_DEPTH; ++i) {
+		parents += leaves;
+		leaves *= BENCH_FANOUT;
+	}
+	bench_tree_t tree = {
+		(ACGL_gui_object_t**)malloc(parents * sizeof(ACGL_gui_object_t*)), 0,
+		(ACGL_gui_object_t**)malloc(leaves * sizeof(ACGL_gui_object_t*)), 0,
+	};
+	if (gui == NULL || frames == NULL || tree.parents == NULL || tree.leaves == NULL) {
+		fprintf(stderr, "Error: out of memory\n");
+		return 1;
+	}
+	bench_build(gui, &tree, gui->root, BENCH_DEPTH);
+
+	// parents are dealt out round robin, so no two writers relink the same
+	// children; relinking one child from two threads at once isn't supported
+	bench_writer_t writers[BENCH_MAX_WRITERS];
+	ACGL_thread_t* threads[BENCH_MAX_WRITERS];
+	int started = 0;
+	for (int i = 0; i < writers_size; ++i) {
+		bench_writer_t* writer = &writers[i];
+		memset(writer, 0, sizeof(bench_writer_t));
+		writer->parents = (ACGL_gui_object_t**)malloc((tree.parents_size / writers_size + 1) * sizeof(ACGL_gui_object_t*));
+		for (size_t j = i; writer->parents != NULL && j < tree.parents_size; j += writers_size) {
+			writer->parents[writer->parents_size++] = tree.parents[j];
+		}
+		writer->leaves = tree.leaves;
+		writer->leaves_size = tree.leaves_size;
+		writer->structure_percent = structure_percent;
+		writer->seed = 2463534242u + (Uint32)i * 7919u;
+
+		threads[i] = ACGL_thread_create(NULL, bench_write, NULL, 0, writer, NULL);
+		if (threads[i] == NULL) {
+			free(writer->parents);
+			break;
+		}
+		ACGL_thread_set_period(threads[i], rate > 0 ? ACGL_CLOCK_NS_PER_S / (Uint64)rate : 0);
+		if (ACGL_thread_start(threads[i], "bench_writer") != 0) {
+			ACGL_thread_destroy(threads[i]);
+			free(writer->parents);
+			break;
+		}
+		++started;
+	}
+	if (started < writers_size) {
+		fprintf(stderr, "Only %d of %d writers started\n", started, writers_size);
+	}
+
+	// every frame is a full redraw, so it takes every node's lock
+	size_t frames_size = 0;
+	Uint64 ends = ACGL_clock_now() + (Uint64)seconds * ACGL_CLOCK_NS_PER_S;
+	for (Uint64 now = ACGL_clock_now(); now < ends && frames_size < BENCH_MAX_FRAMES; ) {
+		ACGL_gui_force_update(gui);
+		ACGL_gui_render(gui);
+		Uint64 rendered = ACGL_clock_now();
+		frames[frames_size++] = rendered - now;
+		now = rendered;
+	}
+
+	Uint64 ops = 0;
+	Uint64 lock_waits = 0;
+	Uint64 lock_wait = 0;
+	Uint64 lock_wait_max = 0;
+	for (int i = 0; i < started; ++i) {
+		ACGL_thread_stop(threads[i]);
+		ACGL_thread_destroy(threads[i]);
+		ops += writers[i].ops;
+		lock_waits += writers[i].lock_waits;
+		lock_wait += writers[i].lock_wait;
+		if (writers[i].lock_wait_max > lock_wait_max) {
+			lock_wait_max = writers[i].lock_wait_max;
+		}
+	}
+	qsort(frames, frames_size, sizeof(Uint64), bench_compare);
+
+	printf("ACGL_THREADING=%s, %zu nodes, %d writers at %d ops/s (0 = unthrottled), %d%% structure\n",
+		ACGL_THREADING ? "ON" : "OFF", tree.parents_size + tree.leaves_size, started, rate, structure_percent);
+	printf("  frames:           %zu\n", frames_size);
+	printf("  frame p50:        %llu ns\n", (unsigned long long)bench_percentile(frames, frames_size, 50));
+	printf("  frame p99:        %llu ns\n", (unsigned long long)bench_percentile(frames, frames_size, 99));
+	printf("  frame p99.9:      %llu ns\n", (unsigned long long)bench_percentile(frames, frames_size, 99.9));
+	printf("  frame max:        %llu ns\n", (unsigned long long)(frames_size > 0 ? frames[frames_size - 1] : 0));
+	printf("  writer ops:       %llu (%llu/s per writer)\n", (unsigned long long)ops,
+		(unsigned long long)(started > 0 ? ops / (Uint64)seconds / (Uint64)started : 0));
+	printf("  leaf lock wait:   %llu ns per lock, %llu ns max\n",
+		(unsigned long long)(lock_waits > 0 ? lock_wait / lock_waits : 0), (unsigned long long)lock_wait_max);
+
+	for (int i = 0; i < started; ++i) {
+		free(writers[i].parents);
+	}
+	free(tree.parents);
+	free(tree.leaves);
+	free(frames);
+	ACGL_gui_destroy(gui);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+	return 0;
+}
@@ -0,0 +1,143 @@
+// Compares building a 10k node screen by hand with opening the same screen
+// from a binary layout. The layout lives in memory, so this measures parsing
+// and instantiation, not the disk.
+#include "layout.h"
+#include "clock.h"
+
+#define BENCH_FANOUT 100
+#define BENCH_ROUNDS 50
+
+static bool bench_render(SDL_Window* window, SDL_Rect rect, void* data) {
+	(void)window;
+	(void)rect;
+	(void)data;
+	return true;
+}
+
+static ACGL_gui_object_t* bench_by_hand(ACGL_gui_t* gui) {
+	ACGL_gui_object_t* root = ACGL_gui_node_init(gui, NULL, NULL, NULL);
+	for (int i = 0; root != NULL && i < BENCH_FANOUT; ++i) {
+		ACGL_gui_object_t* row = ACGL_gui_node_init(gui, NULL, NULL, NULL);
+		if (row == NULL) {
+			break;
+		}
+		row->h = 1.0f / BENCH_FANOUT;
+		row->h_frac = true;
+		row->y = (ACGL_gui_pos_t)i / BENCH_FANOUT;
+		row->y_frac = true;
+		row->anchor = ACGL_GUI_ANCHOR_TOP;
+		ACGL_gui_node_add_child_back(root, row);
+		for (int j = 0; j < BENCH_FANOUT - 1; ++j) {
+			ACGL_gui_object_t* cell = ACGL_gui_node_init(gui, bench_render, NULL, NULL);
+			if (cell == NULL) {
+				break;
+			}
+			cell->w = 1.0f / BENCH_FANOUT;
+			cell->w_frac = true;
+			cell->x = (ACGL_gui_pos_t)j / BENCH_FANOUT;
+			cell->x_frac = true;
+			cell->anchor = ACGL_GUI_ANCHOR_LEFT;
+			ACGL_gui_node_add_child_back(row, cell);
+		}
+	}
+	return root;
+}
+
+// The same tree as bench_by_hand, in the format acgl_layoutc writes
+static void* bench_layout_data(size_t* size) {
+	static const char name[] = "cell";
+	Uint32 count = 1 + BENCH_FANOUT * BENCH_FANOUT;
+	*size = sizeof(ACGL_layout_header_t) + count * sizeof(ACGL_layout_node_t) + sizeof(ACGL_layout_symbol_t) + sizeof(name) - 1;
+	Uint8* data = (Uint8*)SDL_calloc(1, *size);
+	if (data == NULL) {
+		return NULL;
+	}
+	ACGL_layout_header_t* header = (ACGL_layout_header_t*)data;
+	SDL_memcpy(header->magic, ACGL_LAYOUT_MAGIC, sizeof(header->magic));
+	header->version = ACGL_LAYOUT_VERSION;
+	header->node_count = count;
+	header->callback_count = 1;
+	header->strings_size = sizeof(name) - 1;
+
+	ACGL_layout_node_t* nodes = (ACGL_layout_node_t*)(header + 1);
+	for (Uint32 i = 0; i < count; ++i) {
+		nodes[i].w = 1;
+		nodes[i].h = 1;
+		nodes[i].min_w = ACGL_GUI_DIM_NONE;
+		nodes[i].min_h = ACGL_GUI_DIM_NONE;
+		nodes[i].max_w = ACGL_GUI_DIM_NONE;
+		nodes[i].max_h = ACGL_GUI_DIM_NONE;
+		nodes[i].callback = ACGL_LAYOUT_NO_CALLBACK;
+		nodes[i].node_type = ACGL_GUI_NODE_FILL_H + ACGL_GUI_NODE_FILL_W;
+	}
+	nodes[0].child_count = BENCH_FANOUT;
+	for (int i = 0; i < BENCH_FANOUT; ++i) {
+		ACGL_layout_node_t* row = &nodes[1 + i * BENCH_FANOUT];
+		row->child_count = BENCH_FANOUT - 1;
+		row->h = 1.0f / BENCH_FANOUT;
+		row->y = (float)i / BENCH_FANOUT;
+		row->flags = ACGL_LAYOUT_Y_FRAC | ACGL_LAYOUT_H_FRAC;
+		row->anchor = ACGL_GUI_ANCHOR_TOP;
+		for (int j = 0; j < BENCH_FANOUT - 1; ++j) {
+			ACGL_layout_node_t* cell = row + 1 + j;
+			cell->w = 1.0f / BENCH_FANOUT;
+			cell->x = (float)j / BENCH_FANOUT;
+			cell->flags = ACGL_LAYOUT_X_FRAC | ACGL_LAYOUT_W_FRAC;
+			cell->anchor = ACGL_GUI_ANCHOR_LEFT;
+			cell->callback = 0;
+		}
+	}
+	ACGL_layout_symbol_t* symbol = (ACGL_layout_symbol_t*)(nodes + count);
+	symbol->offset = 0;
+	symbol->length = sizeof(name) - 1;
+	SDL_memcpy(symbol + 1, name, sizeof(name) - 1);
+	return data;
+}
+
+int main(int argc, char* argv[]) {
+	(void)argc;
+	(void)argv;
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		fprintf(stderr, "Error: could not init SDL. SDL_Error: %s\n", SDL_GetError());
+		return 1;
+	}
+	SDL_Window* window = SDL_CreateWindow("bench_layout", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1280, 720, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	ACGL_gui_t* gui = window != NULL ? ACGL_gui_init(window) : NULL;
+	size_t size;
+	void* data = bench_layout_data(&size);
+	ACGL_layout_registry_t* registry = ACGL_layout_registry_create();
+	if (gui == NULL || data == NULL || registry == NULL || ACGL_layout_register(registry, "cell", bench_render, NULL) != 0) {
+		fprintf(stderr, "Error: could not set up the benchmark\n");
+		return 1;
+	}
+
+	Uint64 by_hand = 0, from_layout = 0;
+	for (int i = 0; i < BENCH_ROUNDS; ++i) {
+		Uint64 started = ACGL_clock_now();
+		ACGL_gui_object_t* root = bench_by_hand(gui);
+		by_hand += ACGL_clock_now() - started;
+		ACGL_gui_node_destroy(root);
+
+		started = ACGL_clock_now();
+		ACGL_layout_t* layout = ACGL_layout_open_memory(data, size);
+		root = layout != NULL ? ACGL_layout_instantiate(gui, layout, registry, NULL) : NULL;
+		ACGL_layout_close(layout);
+		from_layout += ACGL_clock_now() - started;
+		if (root == NULL) {
+			fprintf(stderr, "Error: could not instantiate the layout\n");
+			return 1;
+		}
+		ACGL_gui_node_destroy(root);
+	}
+
+	printf("ACGL_THREADING=%s, %d nodes\n", ACGL_THREADING ? "ON" : "OFF", 1 + BENCH_FANOUT * BENCH_FANOUT);
+	printf("  by hand:      %llu us\n", (unsigned long long)(by_hand / BENCH_ROUNDS / 1000));
+	printf("  from layout:  %llu us\n", (unsigned long long)(from_layout / BENCH_ROUNDS / 1000));
+
+	ACGL_layout_registry_destroy(registry);
+	SDL_free(data);
+	ACGL_gui_destroy(gui);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+	return 0;
+}
@@ -0,0 +1,80 @@
+// Measures what a frame and a tree mutation cost, to compare builds with
+// ACGL_THREADING on and off. Run it once from each build directory.
+#include "gui.h"
+#include "clock.h"
+
+#define BENCH_FANOUT 8
+#define BENCH_DEPTH 4
+#define BENCH_FRAMES 2000
+#define BENCH_MUTATIONS 200000
+
+static size_t bench_build(ACGL_gui_t* gui, ACGL_gui_object_t* parent, int depth) {
+	if (depth == 0) {
+		return 0;
+	}
+	size_t count = 0;
+	for (int i = 0; i < BENCH_FANOUT; ++i) {
+		ACGL_gui_object_t* child = ACGL_gui_node_init(gui, NULL, NULL, NULL);
+		if (child == NULL) {
+			return count;
+		}
+		child->w = 1.0f / BENCH_FANOUT;
+		child->w_frac = true;
+		child->anchor = ACGL_GUI_ANCHOR_LEFT;
+		child->x = (ACGL_gui_pos_t)i / BENCH_FANOUT;
+		child->x_frac = true;
+		ACGL_gui_node_add_child_back(parent, child);
+		count += 1 + bench_build(gui, child, depth - 1);
+	}
+	return count;
+}
+
+int main(int argc, char* argv[]) {
+	(void)argc;
+	(void)argv;
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		fprintf(stderr, "Error: could not init SDL. SDL_Error: %s\n", SDL_GetError());
+		return 1;
+	}
+	SDL_Window* window = SDL_CreateWindow("bench_render", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1280, 720, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if (window == NULL) {
+		fprintf(stderr, "Error: could not create window. SDL_Error: %s\n", SDL_GetError());
+		SDL_Quit();
+		return 1;
+	}
+	ACGL_gui_t* gui = ACGL_gui_init(window);
+	if (gui == NULL) {
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return 1;
+	}
+	size_t nodes = bench_build(gui, gui->root, BENCH_DEPTH);
+
+	// full redraws, every node is locked and laid out once per frame
+	Uint64 started = ACGL_clock_now();
+	for (int i = 0; i < BENCH_FRAMES; ++i) {
+		ACGL_gui_force_update(gui);
+		ACGL_gui_render(gui);
+	}
+	Uint64 frame = (ACGL_clock_now() - started) / BENCH_FRAMES;
+
+	// moving a leaf locks its parent, itself and a sibling each way
+	ACGL_gui_object_t* parent = gui->root->first_child;
+	ACGL_gui_object_t* leaf = parent->first_child;
+	started = ACGL_clock_now();
+	for (int i = 0; i < BENCH_MUTATIONS; ++i) {
+		ACGL_gui_node_remove_child(parent, leaf);
+		ACGL_gui_node_add_child_back(parent, leaf);
+	}
+	Uint64 mutation = (ACGL_clock_now() - started) / BENCH_MUTATIONS;
+
+	printf("ACGL_THREADING=%s, %zu nodes\n", ACGL_THREADING ? "ON" : "OFF", nodes);
+	printf("  full frame:       %llu ns\n", (unsigned long long)frame);
+	printf("  per node:         %llu ns\n", (unsigned long long)(frame / (nodes + 1)));
+	printf("  remove + re-add:  %llu ns\n", (unsigned long long)mutation);
+
+	ACGL_gui_destroy(gui);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+	return 0;
+}
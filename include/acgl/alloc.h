@@ -0,0 +1,117 @@
+#ifndef ACGL_ALLOC_H
+#define ACGL_ALLOC_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "contracts.h"
+
+// Alignment of everything ACGL_malloc, pools and arenas hand out
+#define ACGL_ALLOC_ALIGN 16
+
+// Every allocation ACGL makes goes through one allocator, which defaults to
+// malloc/realloc/free. The functions can be called from any ACGL thread at
+// the same time, so they have to be thread safe.
+typedef struct {
+  void* (*alloc)(size_t size, void* context);
+  // may be NULL, ACGL then allocates, copies and frees instead
+  void* (*realloc)(void* ptr, size_t old_size, size_t new_size, void* context);
+  // may be NULL for allocators that only release memory all at once
+  void (*free)(void* ptr, size_t size, void* context);
+  void* context;
+} ACGL_allocator_t;
+
+// Which part of ACGL an allocation belongs to, for ACGL_alloc_get_stats
+enum ACGL_ALLOC_SUBSYSTEM {
+  ACGL_ALLOC_GUI,
+  ACGL_ALLOC_ANIMATION,
+  ACGL_ALLOC_INPUT,
+  ACGL_ALLOC_THREADS,
+  ACGL_ALLOC_CHANNEL,
+  ACGL_ALLOC_TIMER,
+  ACGL_ALLOC_TASK,
+  ACGL_ALLOC_ARENA, // chunks backing pools and arenas
+  ACGL_ALLOC_SUBSYSTEM_COUNT,
+};
+
+typedef struct {
+  Uint64 allocations;
+  Uint64 frees;
+  Uint64 bytes;      // currently allocated
+  Uint64 peak_bytes;
+} ACGL_alloc_stats_t;
+
+// Replaces the allocator, or goes back to the default with NULL. Memory has
+// to be freed by the allocator that allocated it, so this only works while
+// ACGL owns no memory, i.e. before creating anything.
+// Returns: nonzero if ACGL still has live allocations
+extern int ACGL_set_allocator(const ACGL_allocator_t* allocator);
+extern void ACGL_get_allocator(ACGL_allocator_t* out);
+
+extern void ACGL_alloc_get_stats(int subsystem, ACGL_alloc_stats_t* out);
+// Sum over all subsystems
+extern void ACGL_alloc_get_total_stats(ACGL_alloc_stats_t* out);
+
+// What the rest of ACGL uses instead of the stdlib functions. Blocks carry a
+// small header with their size, so ACGL_free needs no subsystem. All of them
+// return NULL on failure and accept the same arguments malloc & co. do
+extern void* ACGL_malloc(int subsystem, size_t size);
+extern void* ACGL_calloc(int subsystem, size_t count, size_t size);
+extern void* ACGL_realloc(int subsystem, void* ptr, size_t size);
+extern void ACGL_free(void* ptr);
+
+// Fixed-size blocks carved out of larger chunks. Allocating and freeing pop
+// and push a free list. Not thread safe
+typedef struct ACGL_pool ACGL_pool_t;
+struct ACGL_pool {
+  ACGL_allocator_t parent; // where the chunks come from
+  size_t block_size;
+  size_t blocks_per_chunk;
+  void* chunks;     // singly linked through the first word of each chunk
+  void* free_list;  // singly linked through the first word of each free block
+  size_t blocks_used;
+  int subsystem;    // what the chunks count toward, ACGL_ALLOC_ARENA unless changed
+};
+
+// blocks_per_chunk of 0 picks one. Chunks come from the allocator that is
+// current at creation time. Returns: NULL on failure
+extern ACGL_pool_t* ACGL_pool_create(size_t block_size, size_t blocks_per_chunk);
+extern void ACGL_pool_destroy(ACGL_pool_t* pool);
+extern void* ACGL_pool_alloc(ACGL_pool_t* pool);
+extern void ACGL_pool_free(ACGL_pool_t* pool, void* block);
+
+// Bump allocator: allocating moves a pointer forward, nothing is freed
+// until ACGL_arena_reset releases everything at once. Not thread safe,
+// except through ACGL_arena_allocator
+typedef struct ACGL_arena_chunk ACGL_arena_chunk_t;
+typedef struct ACGL_arena ACGL_arena_t;
+struct ACGL_arena {
+  ACGL_allocator_t parent;
+  bool owns_chunks;   // false for arenas over a caller's buffer
+  size_t chunk_size;
+  size_t max_bytes;   // 0 for no limit
+  size_t reserved;    // bytes of chunks held
+  size_t used;        // bytes handed out since the last reset
+  size_t peak;
+  ACGL_arena_chunk_t* first;
+  ACGL_arena_chunk_t* current;
+  SDL_SpinLock lock;  // only taken by the ACGL_arena_allocator functions
+};
+
+// Grows by chunk_size (or bigger, for big allocations) at a time, but never
+// past max_bytes (0 for no limit). Returns: NULL on failure
+extern ACGL_arena_t* ACGL_arena_create(size_t chunk_size, size_t max_bytes);
+// Sets up an arena that lives entirely in buffer and never grows. Such an
+// arena needs no allocator at all, so it can back ACGL_set_allocator.
+// Returns: nonzero if buffer is too small to be useful
+extern int ACGL_arena_init(ACGL_arena_t* arena, void* buffer, size_t size);
+extern void ACGL_arena_destroy(ACGL_arena_t* arena);
+// Returns: ACGL_ALLOC_ALIGN aligned memory, NULL when out of budget
+extern void* ACGL_arena_alloc(ACGL_arena_t* arena, size_t size);
+// Keeps the chunks for reuse
+extern void ACGL_arena_reset(ACGL_arena_t* arena);
+// An allocator handing out memory from arena, e.g. for ACGL_set_allocator
+extern ACGL_allocator_t ACGL_arena_allocator(ACGL_arena_t* arena);
+
+#endif // ACGL_ALLOC_H
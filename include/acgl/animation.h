@@ -0,0 +1,106 @@
+#ifndef ACGL_ANIMATION_H
+#define ACGL_ANIMATION_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+#include "clock.h"
+#include "sync.h"
+
+// Batched animation of node geometry. Every running animation lives in a set
+// of packed arrays that ACGL_gui_animator_advance walks once per frame. New
+// values are written with needs_layout instead of needs_update, so a node only
+// redraws (with its children) when its rectangle moves by a whole pixel.
+//
+// Call advance from the UI thread right before ACGL_gui_render. Animations can
+// be started from any thread. A moved node doesn't redraw its parent, so give
+// it a parent that redraws (or force an update) if its old spot must be cleared.
+// Cancel a node's animations before destroying it.
+
+enum ACGL_GUI_PROPERTY {
+  ACGL_GUI_PROPERTY_X,
+  ACGL_GUI_PROPERTY_Y,
+  ACGL_GUI_PROPERTY_W,
+  ACGL_GUI_PROPERTY_H,
+};
+#define ACGL_GUI_PROPERTIES 4
+
+enum ACGL_GUI_ANIMATION_KIND {
+  ACGL_GUI_ANIMATION_TWEEN,
+  ACGL_GUI_ANIMATION_SPRING,
+};
+
+// Maps progress in [0, 1] to eased progress, 0 -> 0 and 1 -> 1
+typedef float (*ACGL_easing_t)(float);
+extern float ACGL_ease_linear(float t);
+extern float ACGL_ease_in_quad(float t);
+extern float ACGL_ease_out_quad(float t);
+extern float ACGL_ease_in_out_quad(float t);
+extern float ACGL_ease_in_out_cubic(float t);
+extern float ACGL_ease_out_back(float t);
+
+// A spring is at rest once both its distance to the target and its speed
+// (per second) are below this fraction of the distance it started from
+#define ACGL_GUI_SPRING_REST 0.001f
+// Springs are integrated in steps of at most this many nanoseconds
+#define ACGL_GUI_SPRING_STEP (4 * ACGL_CLOCK_NS_PER_MS)
+
+// New value for one property, computed by advance and then written to the node
+typedef struct ACGL_gui_animation_write ACGL_gui_animation_write_t;
+struct ACGL_gui_animation_write {
+  ACGL_gui_object_t* node;
+  ACGL_gui_pos_t value;
+  Uint8 property;
+};
+
+typedef struct ACGL_gui_animator ACGL_gui_animator_t;
+struct ACGL_gui_animator {
+  ACGL_MUTEX(mutex)
+
+  // one block per animated node, DO NOT EDIT BY HAND. A node's animations
+  // sit together so advance locks it once, and finished blocks are swapped
+  // out for the last one
+  Uint32 size, capacity; // in nodes
+  ACGL_gui_object_t** nodes;
+  Uint8* running; // a bit per property
+  Uint32* index;  // node -> block, open addressing over 2 * capacity slots
+
+  // per animation, at [block * ACGL_GUI_PROPERTIES + property]
+  Uint8* kinds;
+  ACGL_gui_pos_t* values; // current value
+  ACGL_gui_pos_t* from;   // tweens: start value. springs: distance at start
+  ACGL_gui_pos_t* to;
+  ACGL_gui_pos_t* velocity;
+  Uint64* start;
+  Uint64* duration;
+  ACGL_easing_t* easing;
+  float* stiffness;
+  float* damping;
+
+  // filled by advance, reused between calls
+  ACGL_gui_animation_write_t* writes;
+  Uint32 writes_capacity;
+};
+
+extern ACGL_gui_animator_t* ACGL_gui_animator_create(void);
+extern void ACGL_gui_animator_destroy(ACGL_gui_animator_t* animator);
+
+// Tweens property of node from its current value to `to` over duration_ns.
+// Replaces any animation already running on that property.
+// Returns: 0 on success, -1 on failure
+extern int ACGL_gui_animate(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node, int property, ACGL_gui_pos_t to, Uint64 duration_ns, ACGL_easing_t easing);
+// Moves property toward `to` like a damped spring. stiffness and damping are per second
+// (e.g. 170 and 26 for a quick, barely-bouncing motion). Retargeting a running spring
+// keeps its velocity. Returns: 0 on success, -1 on failure
+extern int ACGL_gui_animate_spring(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node, int property, ACGL_gui_pos_t to, float stiffness, float damping);
+// Stops every animation on node, leaving it where it is
+extern void ACGL_gui_animator_cancel(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node);
+extern bool ACGL_gui_animator_is_animating(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node);
+
+// Moves every animation to time `now` (from ACGL_clock_now) and writes the
+// results into the nodes. Returns: number of animations still running
+extern Uint32 ACGL_gui_animator_advance(ACGL_gui_animator_t* animator, Uint64 now);
+
+#endif // ACGL_ANIMATION_H
@@ -0,0 +1,50 @@
+#ifndef ACGL_ASSETS_H
+#define ACGL_ASSETS_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "common.h"
+#include "sync.h"
+
+// Loads things by name once and shares them between everyone asking, e.g.
+// textures used by several windows on one GL context. Assets are reference
+// counted; released ones stay cached until ACGL_asset_cache_trim, so closing
+// and reopening a page doesn't load everything again.
+
+// Returns: the loaded asset, NULL on failure
+typedef void* (*ACGL_asset_loader_t)(const char* name, void* context);
+
+typedef struct {
+  char* name; // NULL for an empty slot
+  Uint32 hash;
+  void* value;
+  Uint32 refs;
+} ACGL_asset_entry_t;
+
+// DO NOT EDIT BY HAND, use the functions below
+typedef struct ACGL_asset_cache ACGL_asset_cache_t;
+struct ACGL_asset_cache {
+  ACGL_asset_loader_t load;
+  ACGL_destroy_callback_t unload; // may be NULL
+  void* context;
+
+  ACGL_asset_entry_t* entries; // open addressing, at most half full
+  Uint32 size;
+  Uint32 capacity; // always a power of two
+  ACGL_MUTEX(mutex)
+};
+
+extern ACGL_asset_cache_t* ACGL_asset_cache_create(ACGL_asset_loader_t load, ACGL_destroy_callback_t unload, void* context);
+// Unloads every asset, held or not
+extern void ACGL_asset_cache_destroy(ACGL_asset_cache_t* cache);
+// Loads name on first use, under the cache's lock, so loads don't run in
+// parallel. Every successful acquire needs one release.
+// Returns: the asset, NULL if it could not be loaded
+extern void* ACGL_asset_acquire(ACGL_asset_cache_t* cache, const char* name);
+extern void ACGL_asset_release(ACGL_asset_cache_t* cache, const char* name);
+// Unloads the assets nobody holds. Returns: how many were unloaded
+extern size_t ACGL_asset_cache_trim(ACGL_asset_cache_t* cache);
+
+#endif // ACGL_ASSETS_H
@@ -0,0 +1,98 @@
+#ifndef ACGL_CHANNEL_H
+#define ACGL_CHANNEL_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "contracts.h"
+
+// Fixed-capacity ring buffers for passing values between ACGL threads and
+// the UI thread. All memory is allocated in ACGL_channel_create; sending and
+// receiving never allocate and never take a lock.
+enum ACGL_CHANNEL_KIND {
+  ACGL_CHANNEL_SPSC, // exactly one sending thread and one receiving thread
+  ACGL_CHANNEL_MPSC, // any number of sending threads, one receiving thread
+};
+
+#define ACGL_CHANNEL_CACHE_LINE 64
+
+typedef struct ACGL_channel ACGL_channel_t;
+struct ACGL_channel {
+  int kind;
+  size_t elem_size;
+  Uint32 capacity; // always a power of two
+  Uint32 mask;
+  Uint8* slots;
+  SDL_atomic_t* published; // MPSC only: slot i holds position p once published[i] == p + 1
+  Uint32 wake_event;       // SDL event type pushed when the channel becomes non-empty, 0 for none
+  SDL_sem* readable;
+  SDL_sem* writable;
+
+  // positions grow forever and wrap around at 2^32, kept on separate
+  // cache lines so the two sides don't fight over them
+  Uint8 pad0[ACGL_CHANNEL_CACHE_LINE];
+  SDL_atomic_t tail;           // next position to write
+  SDL_atomic_t send_waiting;   // number of blocked senders
+  Uint8 pad1[ACGL_CHANNEL_CACHE_LINE];
+  SDL_atomic_t head;           // next position to read
+  SDL_atomic_t recv_waiting;   // nonzero while the receiver is blocked
+  SDL_atomic_t notified;       // a wake event is in flight
+  Uint8 pad2[ACGL_CHANNEL_CACHE_LINE];
+};
+
+// capacity is rounded up to the next power of two
+extern ACGL_channel_t* ACGL_channel_create(int kind, size_t elem_size, Uint32 capacity);
+extern void ACGL_channel_destroy(ACGL_channel_t* channel);
+
+// Non-blocking. Returns: how many of the count items were sent/received
+extern size_t ACGL_channel_send(ACGL_channel_t* channel, const void* items, size_t count);
+extern size_t ACGL_channel_recv(ACGL_channel_t* channel, void* items, size_t max);
+// Blocking. send_wait returns once all items are sent or timeout_ms passes, recv_wait
+// once at least one item was received or timeout_ms passes. Use SDL_MUTEX_MAXWAIT
+// to wait forever. Returns: same as the non-blocking versions
+extern size_t ACGL_channel_send_wait(ACGL_channel_t* channel, const void* items, size_t count, Uint32 timeout_ms);
+extern size_t ACGL_channel_recv_wait(ACGL_channel_t* channel, void* items, size_t max, Uint32 timeout_ms);
+
+// Returns: number of items waiting, only exact when called by the receiver
+extern Uint32 ACGL_channel_size(ACGL_channel_t* channel);
+extern bool ACGL_channel_is_empty(ACGL_channel_t* channel);
+
+// Pushes an SDL_USEREVENT-style event of event_type (from SDL_RegisterEvents),
+// with user.data1 set to the channel, whenever the channel goes from empty to
+// non-empty. At most one such event is pending at a time; it is re-armed once
+// the receiver drains the channel. Pass 0 to turn it off
+extern void ACGL_channel_set_wake_event(ACGL_channel_t* channel, Uint32 event_type);
+
+// Declares type-checked wrappers, e.g. ACGL_CHANNEL_DECLARE(sample_channel, sample_t)
+// gives sample_channel_create(kind, capacity), sample_channel_send(ch, &s), ...
+#define ACGL_CHANNEL_DECLARE(name, type) \
+  static inline ACGL_channel_t* name##_create(int kind, Uint32 capacity) { \
+    return ACGL_channel_create(kind, sizeof(type), capacity); \
+  } \
+  static inline bool name##_send(ACGL_channel_t* channel, const type* item) { \
+    REQUIRES(channel->elem_size == sizeof(type)); \
+    return ACGL_channel_send(channel, item, 1) == 1; \
+  } \
+  static inline bool name##_recv(ACGL_channel_t* channel, type* item) { \
+    REQUIRES(channel->elem_size == sizeof(type)); \
+    return ACGL_channel_recv(channel, item, 1) == 1; \
+  } \
+  static inline size_t name##_send_batch(ACGL_channel_t* channel, const type* items, size_t count) { \
+    REQUIRES(channel->elem_size == sizeof(type)); \
+    return ACGL_channel_send(channel, items, count); \
+  } \
+  static inline size_t name##_recv_batch(ACGL_channel_t* channel, type* items, size_t max) { \
+    REQUIRES(channel->elem_size == sizeof(type)); \
+    return ACGL_channel_recv(channel, items, max); \
+  } \
+  static inline size_t name##_send_wait(ACGL_channel_t* channel, const type* items, size_t count, Uint32 timeout_ms) { \
+    REQUIRES(channel->elem_size == sizeof(type)); \
+    return ACGL_channel_send_wait(channel, items, count, timeout_ms); \
+  } \
+  static inline size_t name##_recv_wait(ACGL_channel_t* channel, type* items, size_t max, Uint32 timeout_ms) { \
+    REQUIRES(channel->elem_size == sizeof(type)); \
+    return ACGL_channel_recv_wait(channel, items, max, timeout_ms); \
+  }
+
+#endif // ACGL_CHANNEL_H
@@ -0,0 +1,22 @@
+#ifndef ACGL_CLOCK_H
+#define ACGL_CLOCK_H
+
+#include <SDL.h>
+#include <stdbool.h>
+
+#define ACGL_CLOCK_NS_PER_US 1000ull
+#define ACGL_CLOCK_NS_PER_MS 1000000ull
+#define ACGL_CLOCK_NS_PER_S  1000000000ull
+
+// Monotonic clock built on SDL_GetPerformanceCounter.
+// Returns: nanoseconds since an arbitrary (but fixed) point in time
+extern Uint64 ACGL_clock_now(void);
+// Converts a raw SDL_GetPerformanceCounter value to nanoseconds
+extern Uint64 ACGL_clock_from_counter(Uint64 counter);
+
+// Blocks until ACGL_clock_now() >= deadline. SDL_Delay is used while more
+// than `spin` nanoseconds remain, the rest is busy-waited so we don't pay for
+// the OS timer's wakeup slop.
+extern void ACGL_clock_sleep_until(Uint64 deadline, Uint64 spin);
+
+#endif // ACGL_CLOCK_H
@@ -0,0 +1,77 @@
+#ifndef ACGL_DISPLAY_H
+#define ACGL_DISPLAY_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+#include "inputhandler.h"
+#include "assets.h"
+
+// Drives several windows, one ACGL_gui_t each, from one loop:
+//
+//   while (!pump->quit_requested) {
+//     ACGL_ih_pump(pump);  // after ACGL_display_attach_pump
+//     if (ACGL_display_render(display) == 0) {
+//       SDL_WaitEventTimeout(NULL, 100);
+//     }
+//   }
+//
+// A window is only drawn after its tree changed (see ACGL_gui_request_render)
+// and while it can be seen, so idle monitors cost nothing. All windows share
+// one GL context, and with it the textures an asset cache hands out.
+
+typedef struct {
+  SDL_Window* window;
+  Uint32 id;
+  ACGL_gui_t* gui;
+  ACGL_ih_eventdata_t* medata; // this window's key and window callbacks, may be NULL
+  bool visible; // false while hidden or minimized
+  bool present; // drawn this frame and waiting to be presented
+} ACGL_display_window_t;
+
+typedef struct ACGL_display ACGL_display_t;
+struct ACGL_display {
+  SDL_GLContext context; // made current for each window, NULL to leave contexts alone
+  ACGL_display_window_t* windows;
+  size_t windows_size, windows_capacity;
+  SDL_Window* current;   // window the context was last made current on
+
+  // swap interval of the last window presented each frame; the others swap
+  // without waiting so a frame waits for the vertical blank once, not once
+  // per window. 1 (vsync) by default
+  int vsync;
+  int swap_interval; // what the context is set to, -1 if unknown
+
+  ACGL_ih_keybinds_t* keybinds; // key events go through these, may be NULL
+  ACGL_asset_cache_t* assets;   // NULL unless given to ACGL_display_create
+};
+
+// assets may be NULL, and is destroyed with the display otherwise.
+// Returns: NULL on failure
+extern ACGL_display_t* ACGL_display_create(SDL_GLContext context, ACGL_ih_keybinds_t* keybinds, ACGL_asset_cache_t* assets);
+// Destroys every gui and the asset cache, but not the windows
+extern void ACGL_display_destroy(ACGL_display_t* display);
+
+// Creates a gui for window. medata is owned by the caller and may be NULL.
+// Returns: the new gui, NULL on failure
+extern ACGL_gui_t* ACGL_display_add_window(ACGL_display_t* display, SDL_Window* window, ACGL_ih_eventdata_t* medata);
+// Destroys the window's gui, not the window
+extern void ACGL_display_remove_window(ACGL_display_t* display, SDL_Window* window);
+// Returns: the gui of the window with this SDL window ID, NULL if there is none
+extern ACGL_gui_t* ACGL_display_find(ACGL_display_t* display, Uint32 window_id);
+
+// Sends window and key events to the window they happened in, and keeps
+// track of which windows can be seen. Returns: false for events of other
+// types or windows
+extern bool ACGL_display_handle_event(ACGL_display_t* display, const SDL_Event* event);
+// Makes pump route window and key events through the display.
+// Returns: 0 on success, -1 on failure
+extern int ACGL_display_attach_pump(ACGL_display_t* display, ACGL_ih_pump_t* pump);
+
+// Renders every visible window that requested it, then presents them.
+// Returns: the number of windows presented, 0 when there was nothing to do
+extern int ACGL_display_render(ACGL_display_t* display);
+
+#endif // ACGL_DISPLAY_H
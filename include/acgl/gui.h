@@ -7,6 +7,8 @@
 #include <stdbool.h>
 #include <assert.h>
 #include "common.h"
+#include "alloc.h"
+#include "sync.h"
 
 typedef float ACGL_gui_pos_t;
 
@@ -38,16 +40,33 @@ static const ACGL_gui_pos_t ACGL_GUI_DIM_FILL = -2;
 
 typedef struct ACGL_gui_object ACGL_gui_object_t;
 typedef bool (*ACGL_render_callback_t)(SDL_Window*, SDL_Rect, void*);
+struct ACGL_gui;
 
 struct ACGL_gui_object {
-  SDL_mutex* mutex;
+  ACGL_MUTEX(mutex) // only in threaded builds, use ACGL_gui_node_lock
+  struct ACGL_gui* gui; // the node was created for. Nodes kept after it is
+                        // destroyed can only be destroyed. DO NOT EDIT
   ACGL_render_callback_t render_callback; // is called before any of the childrens'
   ACGL_destroy_callback_t destroy_callback; // is called when node is being destroyed to free callback data
   void* callback_data;
-  bool needs_update; // set this flag (after locking the mutex) whenever 
+  bool needs_update; // set this flag (after locking the node) whenever 
                      // you want the node and all its children to redraw 
                      // themselves. if set on a child, DOES NOT update 
                      // the parent.
+  bool needs_layout; // set this flag (after locking the node) when you only
+                     // changed the geometry below. the node and its children
+                     // only redraw if the node's rectangle actually changed
+  SDL_Rect rect; // where the node was last laid out, DO NOT EDIT
+  Uint64 key; // tells siblings apart for ACGL_gui_reconcile, 0 unless set
+  bool opaque; // set when the render callback paints every pixel of rect.
+               // nodes entirely behind an opaque node drawn after them
+               // don't get their render callback called
+  bool clip_children; // children are only drawn inside rect. Nodes entirely
+                      // outside don't get their render callback called, the
+                      // rest find what they may draw into with ACGL_gui_clip_rect
+  bool culled; // was hidden behind an opaque node or clipped away last frame, DO NOT EDIT
+  Uint64 shown_frame; // last frame (see ACGL_gui_t) the node was laid out
+                      // non-empty and not culled, 0 if never. DO NOT EDIT
 
   // change the following data points to change the node's drawing behavior
   int anchor;
@@ -68,10 +87,24 @@ struct ACGL_gui_object {
   ACGL_gui_object_t* last_child;
 };
 
+// Size of each chunk of the per-frame scratch arena
+#define ACGL_GUI_SCRATCH_CHUNK (16 * 1024)
+// How many opaque rects a frame remembers for culling, the biggest win
+#define ACGL_GUI_MAX_OCCLUDERS 16
+
+struct ACGL_gui_lazy;
+
 typedef struct ACGL_gui ACGL_gui_t;
 struct ACGL_gui {
   SDL_Window* window;
   ACGL_gui_object_t* root;
+  ACGL_arena_t* scratch; // reset at the end of every ACGL_gui_render
+  size_t opaque_nodes; // seen by the last ACGL_gui_render, DO NOT EDIT
+  SDL_atomic_t render_requested; // see ACGL_gui_request_render
+  Uint64 frame; // ACGL_gui_render calls so far, guarded by root's lock. DO NOT EDIT
+  SDL_Rect clip; // see ACGL_gui_clip_rect, DO NOT EDIT
+  struct ACGL_gui_lazy* lazy_nodes; // see lazy.h, DO NOT EDIT
+  ACGL_MUTEX(lazy_mutex) // guards lazy_nodes
 };
 
 
@@ -84,7 +117,13 @@ extern ACGL_gui_t* ACGL_gui_init(SDL_Window* window); // returns: a valid object
 extern void ACGL_gui_destroy(ACGL_gui_t* ACGL_gui); // destroys the ACGL_gui_t and the entire subtree
 
 extern ACGL_gui_object_t* ACGL_gui_node_init(ACGL_gui_t* gui, ACGL_render_callback_t render, ACGL_destroy_callback_t destroy, void* data);
+// Creates count default nodes (no callbacks, no data) into nodes, much cheaper
+// than count calls to ACGL_gui_node_init. Returns: false on failure, with no nodes created
+extern bool ACGL_gui_node_init_many(ACGL_gui_t* gui, ACGL_gui_object_t** nodes, size_t count);
 extern bool ACGL_gui_node_render(ACGL_gui_t* gui, ACGL_gui_object_t* node, SDL_Rect location); // returns: did render
+// Returns: where node would be laid out inside location, without touching it.
+// REQUIRES: node is locked, or not shared with other threads
+extern SDL_Rect ACGL_gui_node_place(const ACGL_gui_object_t* node, SDL_Rect location);
 extern void ACGL_gui_node_add_child_front(ACGL_gui_object_t* parent, ACGL_gui_object_t* child);
 extern void ACGL_gui_node_add_child_back(ACGL_gui_object_t* parent, ACGL_gui_object_t* child);
 extern void ACGL_gui_node_remove_child(ACGL_gui_object_t* parent, ACGL_gui_object_t* child);
@@ -95,5 +134,33 @@ extern void ACGL_gui_node_remove_all_children(ACGL_gui_object_t* parent);
 extern void ACGL_gui_node_destroy(ACGL_gui_object_t* node);
 extern void ACGL_gui_node_destroy_all_children(ACGL_gui_object_t* node);
 
+// Locks the node and sets needs_layout, see above
+extern void ACGL_gui_node_mark_dirty(ACGL_gui_object_t* node);
+// Guards changes to the node's fields against a render on another thread.
+// Do nothing when ACGL is built without threading, so only the thread that
+// renders may touch the tree then.
+// Returns nonzero if the node could not be locked
+extern int ACGL_gui_node_lock(ACGL_gui_object_t* node);
+extern void ACGL_gui_node_unlock(ACGL_gui_object_t* node);
+
 extern bool ACGL_gui_force_update(ACGL_gui_t* gui);
+// Tells whatever drives rendering (e.g. an ACGL_display_t) that the tree has
+// something to draw. Every ACGL function that changes a tree does this on its
+// own; call it after setting needs_update or needs_layout by hand. Safe from
+// any thread
+extern void ACGL_gui_request_render(ACGL_gui_t* gui);
+// Returns: whether a render was requested since the last call
+extern bool ACGL_gui_take_render_request(ACGL_gui_t* gui);
+
+// ACGL doesn't draw anything itself, so render callbacks clip their own
+// drawing (glScissor, SDL_RenderSetClipRect, ...) to this when it doesn't
+// contain their rect. Returns: the part of the window the node whose
+// callback is running may draw into, the whole window outside callbacks
+extern SDL_Rect ACGL_gui_clip_rect(SDL_Window* window);
+
+// Memory that only has to last until the current frame is rendered, e.g.
+// temporary buffers in render callbacks. Never free it, ACGL_gui_render
+// releases all of it at once. Only use from the thread calling ACGL_gui_render.
+// Returns: NULL when out of memory
+extern void* ACGL_gui_scratch_alloc(ACGL_gui_t* gui, size_t size);
 #endif //ACGL_GUI_H
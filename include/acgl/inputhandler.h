@@ -6,42 +6,169 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <assert.h>
+#include "sync.h"
 
-typedef int (*ACGL_ih_callback_t)(SDL_Event, void*);
+// Events are passed by pointer and only valid for the duration of the call
+typedef int (*ACGL_ih_callback_t)(const SDL_Event*, void*);
 
+// One key bound to one action. A key can trigger many actions and an action
+// can be triggered by many keys
 typedef struct {
-  SDL_Scancode* keycodes;
-  size_t keycodes_size;
+  SDL_Scancode scancode;
+  Uint16 action;
+} ACGL_ih_keybind_t;
+
+// Bindings compiled into a lookup table: the actions bound to scancode s are
+// actions[offsets[s]] up to (not including) actions[offsets[s+1]]
+typedef struct ACGL_ih_keymap_t ACGL_ih_keymap_t;
+struct ACGL_ih_keymap_t {
+  Uint32 offsets[SDL_NUM_SCANCODES + 1];
+  Uint16* actions;
+  ACGL_ih_keymap_t* next_retired;
+};
+
+// Rebinding builds a new keymap and swaps it in with one atomic store, so
+// handlers on other threads see either the old or the new bindings, never a
+// mix. Old keymaps are freed once no handler can still be reading them.
+// DO NOT EDIT THESE BY HAND, use the functions below
+typedef struct {
+  ACGL_ih_keybind_t* binds;
+  size_t binds_size;
+  size_t binds_capacity;
+
+  ACGL_ih_keymap_t* keymap; // current table, read with SDL_AtomicGetPtr
+  ACGL_ih_keymap_t* retired;
+  SDL_atomic_t readers;
+  ACGL_MUTEX(mutex) // serializes rebinding
 } ACGL_ih_keybinds_t;
 
-typedef struct ACGL_ih_callback_node_t ACGL_ih_callback_node_t;
+// Identifies one registered callback, 0 is never a valid handle
+typedef Uint64 ACGL_ih_handle_t;
+
+// see threads.h
+typedef struct ACGL_thread ACGL_thread_t;
 
-struct ACGL_ih_callback_node_t {
+typedef struct {
+  ACGL_ih_callback_t callback; // NULL while a removal is pending
+  void* data;
+  ACGL_thread_t* target; // when set, the event is posted to this thread's inbox instead
+  Uint32 registration;
+} ACGL_ih_callback_entry_t;
+
+// Callbacks for one action (or for window events), walked in order by dispatch
+typedef struct {
+  ACGL_ih_callback_entry_t* entries;
+  Uint32 size;
+  Uint32 capacity;
+} ACGL_ih_callback_list_t;
+
+// Where a handle's callback lives, so it can be removed without a search
+typedef struct {
   ACGL_ih_callback_t callback;
   void* data;
-  ACGL_ih_callback_node_t* next;
-};
+  ACGL_thread_t* target;
+  Uint32 list;     // action, or keyCallbacks_size for window events
+  Uint32 position; // index into that list's entries
+  Uint32 generation;
+  Uint32 next_free;
+  Uint8 state;
+} ACGL_ih_registration_t;
 
+// Callbacks registered or deregistered while an event is being dispatched
+// (e.g. from inside a callback) only take effect once dispatch finishes.
+// Storage grows as needed and is reused, so registering stops allocating once
+// the arrays are big enough. DO NOT EDIT THESE BY HAND
 typedef struct {
-  ACGL_ih_callback_node_t** keyCallbacks;
+  ACGL_ih_callback_list_t* keyCallbacks;
   size_t keyCallbacks_size;
-  ACGL_ih_callback_node_t* windowCallbacks;
+  ACGL_ih_callback_list_t windowCallbacks;
+
+  ACGL_ih_registration_t* registrations;
+  Uint32 registrations_size;
+  Uint32 registrations_capacity;
+  Uint32 free_list;
+
+  int dispatching; // depth of handle_* calls in progress
+  Uint32* pending; // registrations to add or remove once dispatch finishes
+  Uint32 pending_size;
+  Uint32 pending_capacity;
 } ACGL_ih_eventdata_t;
 
+// Binds action i to keycodes[i]
 extern ACGL_ih_keybinds_t* ACGL_ih_init_keybinds(const SDL_Scancode keycodes[], const size_t keycodes_size);
 extern ACGL_ih_eventdata_t* ACGL_ih_init_eventdata(const size_t keycodes_size);
 extern void ACGL_ih_deinit_keybinds(ACGL_ih_keybinds_t* keybinds);
 extern void ACGL_ih_deinit_eventdata(ACGL_ih_eventdata_t* medata);
 
-// inserts new event at head of ACGL_ih_callback_node_t linked list
-extern void ACGL_ih_register_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback, void* data);
-extern void ACGL_ih_register_windowevent(ACGL_ih_eventdata_t* medata, ACGL_ih_callback_t callback, void* data);
+// Rebinding, safe to call while other threads handle events. Each call
+// recompiles the table once. Returns: 0 on success, -1 on failure
+extern int ACGL_ih_bind_key(ACGL_ih_keybinds_t* keybinds, SDL_Scancode scancode, Uint16 action);
+extern int ACGL_ih_unbind_key(ACGL_ih_keybinds_t* keybinds, SDL_Scancode scancode, Uint16 action);
+// Replaces every key bound to action with just scancode
+extern int ACGL_ih_rebind_action(ACGL_ih_keybinds_t* keybinds, Uint16 action, SDL_Scancode scancode);
+// Replaces all bindings at once
+extern int ACGL_ih_set_keybinds(ACGL_ih_keybinds_t* keybinds, const ACGL_ih_keybind_t binds[], size_t binds_size);
+
+// Callbacks run in no particular order. Returns: a handle for ACGL_ih_deregister, 0 on failure
+extern ACGL_ih_handle_t ACGL_ih_register_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback, void* data);
+extern ACGL_ih_handle_t ACGL_ih_register_windowevent(ACGL_ih_eventdata_t* medata, ACGL_ih_callback_t callback, void* data);
+// Same, but the callback runs on thread (see ACGL_thread_enable_inbox) at the
+// start of its next tick, with a copy of the event. Dispatch only queues it.
+// Events already queued still arrive after deregistering, so data has to
+// outlive the thread's next tick
+extern ACGL_ih_handle_t ACGL_ih_register_keyevent_on(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_thread_t* thread, ACGL_ih_callback_t callback, void* data);
+extern ACGL_ih_handle_t ACGL_ih_register_windowevent_on(ACGL_ih_eventdata_t* medata, ACGL_thread_t* thread, ACGL_ih_callback_t callback, void* data);
 
+// Removes one registration in O(1). Returns: true if the handle was still registered
+extern bool ACGL_ih_deregister(ACGL_ih_eventdata_t* medata, ACGL_ih_handle_t handle);
 // check to see if there is a function registered with that event, and if so, deletes it
 extern void ACGL_ih_deregister_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback);
 extern void ACGL_ih_deregister_windowevent(ACGL_ih_eventdata_t* medata, ACGL_ih_callback_t callback);
 
-extern bool ACGL_ih_handle_keyevent(SDL_Event event, ACGL_ih_keybinds_t* keybinds, ACGL_ih_eventdata_t* medata);
-extern bool ACGL_ih_handle_windowevent(SDL_Event event, ACGL_ih_eventdata_t* medata);
+extern bool ACGL_ih_handle_keyevent(const SDL_Event* event, ACGL_ih_keybinds_t* keybinds, ACGL_ih_eventdata_t* medata);
+extern bool ACGL_ih_handle_windowevent(const SDL_Event* event, ACGL_ih_eventdata_t* medata);
+
+// Event pump: replaces the SDL_PollEvent loop. Drains the queue in batches,
+// drops mouse motion and window resizes that a later event in the same batch
+// supersedes, and dispatches each remaining event through a per-type table.
+// Without a handler of their own, key events go to ACGL_ih_handle_keyevent
+// and window events to ACGL_ih_handle_windowevent.
+#define ACGL_IH_PUMP_BATCH 128
+// Coalescing keeps track of at most this many windows per batch
+#define ACGL_IH_PUMP_WINDOWS 8
+
+typedef struct {
+  ACGL_ih_callback_t callback;
+  void* data;
+} ACGL_ih_event_handler_t;
+
+// see inputrecord.h
+typedef struct ACGL_ih_recorder ACGL_ih_recorder_t;
+// see inputstate.h
+typedef struct ACGL_ih_actions ACGL_ih_actions_t;
+
+typedef struct {
+  ACGL_ih_keybinds_t* keybinds; // may be NULL to not dispatch key events by default
+  ACGL_ih_eventdata_t* medata;  // may be NULL to not dispatch key or window events by default
+  // handlers[type >> 8][type & 0xFF], each page allocated on first use
+  ACGL_ih_event_handler_t* handlers[256];
+  bool coalesce_motion; // runs of motion events with nothing else between them merge into the last, with xrel/yrel summed
+  bool coalesce_resize; // only the last RESIZED and the last SIZE_CHANGED per window are kept
+  bool quit_requested;  // set once SDL_QUIT is seen
+  ACGL_ih_recorder_t* recorder; // when set, every dispatched event is also recorded
+  ACGL_ih_actions_t* actions;   // when set, key events are also fed to it
+  SDL_Event batch[ACGL_IH_PUMP_BATCH];
+} ACGL_ih_pump_t;
+
+extern ACGL_ih_pump_t* ACGL_ih_pump_create(ACGL_ih_keybinds_t* keybinds, ACGL_ih_eventdata_t* medata);
+extern void ACGL_ih_pump_destroy(ACGL_ih_pump_t* pump);
+// Sets the handler for one event type; a NULL callback goes back to the default.
+// Returns: 0 on success, -1 on failure
+extern int ACGL_ih_pump_set_handler(ACGL_ih_pump_t* pump, Uint32 type, ACGL_ih_callback_t callback, void* data);
+// Handles every queued event. Call once per frame from the thread that
+// created the window. Returns: number of events dispatched
+extern int ACGL_ih_pump(ACGL_ih_pump_t* pump);
+// Sends one event through the pump's table, as ACGL_ih_pump would
+extern void ACGL_ih_pump_dispatch(ACGL_ih_pump_t* pump, const SDL_Event* event);
 
 #endif // ACGL_INPUTHANDLER_H
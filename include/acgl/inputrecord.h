@@ -0,0 +1,72 @@
+#ifndef ACGL_INPUTRECORD_H
+#define ACGL_INPUTRECORD_H
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "inputhandler.h"
+
+// Recording and replaying the input stream. Set a recorder on an
+// ACGL_ih_pump_t and every frame and every event it dispatches is appended to
+// a compact binary log (varint fields, a few bytes per event). Replaying feeds
+// the log back through ACGL_ih_pump_dispatch one recorded frame at a time,
+// either paced like the original session or as fast as frames are requested.
+//
+// Pointers are never replayed. Dropped files and text are copied into the
+// log and handed to handlers as new SDL_malloc'd strings, which they free as
+// usual. User events keep their code, but data1 and data2 come back NULL.
+
+#define ACGL_IH_RECORD_MAGIC "ACGLREC"
+#define ACGL_IH_RECORD_VERSION 2
+#define ACGL_IH_RECORD_BUFFER 4096
+
+enum ACGL_IH_REPLAY_MODE {
+  ACGL_IH_REPLAY_REALTIME, // a frame is replayed once as much time has passed as when it was recorded
+  ACGL_IH_REPLAY_FAST,     // every call replays the next frame
+};
+
+struct ACGL_ih_recorder {
+  SDL_RWops* out;
+  Uint64 last_frame; // ACGL_clock_now() at the previous frame, 0 before the first
+  bool failed;       // a write failed, nothing more is recorded
+  Uint64 frames, events;
+  size_t buffer_size;
+  Uint8 buffer[ACGL_IH_RECORD_BUFFER];
+};
+
+typedef struct ACGL_ih_replayer ACGL_ih_replayer_t;
+struct ACGL_ih_replayer {
+  SDL_RWops* in;
+  int mode;
+  Uint64 start;      // ACGL_clock_now() when the first frame was replayed
+  Uint64 frame_time; // when the next frame was recorded, relative to the first
+  bool started;
+  bool finished;     // the log ran out (or was corrupt)
+  Uint64 frames, events;
+  size_t buffer_pos, buffer_size;
+  Uint8 buffer[ACGL_IH_RECORD_BUFFER];
+};
+
+// Writes the log header to out. out stays owned by the caller, but must
+// outlive the recorder. Returns: NULL on failure
+extern ACGL_ih_recorder_t* ACGL_ih_recorder_create(SDL_RWops* out);
+// Flushes whatever is buffered, doesn't close out
+extern void ACGL_ih_recorder_destroy(ACGL_ih_recorder_t* recorder);
+// Marks the start of a frame at time now (from ACGL_clock_now). Returns: 0 on success, -1 on failure
+extern int ACGL_ih_recorder_frame(ACGL_ih_recorder_t* recorder, Uint64 now);
+// Returns: 0 on success, -1 on failure
+extern int ACGL_ih_recorder_write(ACGL_ih_recorder_t* recorder, const SDL_Event* event);
+extern int ACGL_ih_recorder_flush(ACGL_ih_recorder_t* recorder);
+
+// Checks the log header. in stays owned by the caller. Returns: NULL on failure
+extern ACGL_ih_replayer_t* ACGL_ih_replayer_create(SDL_RWops* in, int mode);
+extern void ACGL_ih_replayer_destroy(ACGL_ih_replayer_t* replayer);
+// Dispatches the next recorded frame's events through pump. In realtime mode
+// nothing happens until that frame is due. From the first frame on, the
+// pump's actions (if any) take held keys from the replayed events instead of
+// the keyboard; clear their keys_from_events to go back. Returns: number of
+// events dispatched, -1 once the log is finished
+extern int ACGL_ih_replay_frame(ACGL_ih_replayer_t* replayer, ACGL_ih_pump_t* pump);
+
+#endif // ACGL_INPUTRECORD_H
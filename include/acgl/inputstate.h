@@ -0,0 +1,107 @@
+#ifndef ACGL_INPUTSTATE_H
+#define ACGL_INPUTSTATE_H
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "inputhandler.h"
+#include "threads.h"
+
+// Polled action state, for input that's checked every tick (movement,
+// scrolling) instead of reacted to. Once per frame the tracker reads
+// SDL_GetKeyboardState (or, while an input log is replayed, the keys its
+// events hold down), maps held keys to actions through the keybinds, and
+// builds bitsets of what is held, what was pressed and what was released
+// this frame. Chords (actions held together) and sequences (actions pressed
+// in order) are tracked on top of that as "combos".
+//
+// The result is a plain struct, cheap to copy. Worker threads each subscribe
+// to get their own ACGL_snapshot_t with the latest state, which they read
+// without locking.
+
+#define ACGL_IH_MAX_ACTIONS 256
+#define ACGL_IH_ACTION_WORDS (ACGL_IH_MAX_ACTIONS / 64)
+#define ACGL_IH_MAX_COMBOS 64
+#define ACGL_IH_MAX_COMBO_LENGTH 8
+#define ACGL_IH_MAX_SUBSCRIBERS 8
+
+typedef struct {
+  Uint64 frame; // counts updates, starting at 1
+  Uint64 time;  // ACGL_clock_now() of the update
+  Uint64 held[ACGL_IH_ACTION_WORDS];
+  Uint64 pressed[ACGL_IH_ACTION_WORDS];  // went down this frame
+  Uint64 released[ACGL_IH_ACTION_WORDS]; // went up this frame
+  Uint64 combos_held;  // chords whose actions are all held
+  Uint64 combos_fired; // chords completed and sequences finished this frame
+  // wrapping counts since the tracker was created. Readers that can miss
+  // frames diff these against their previous copy to not lose presses
+  Uint8 presses[ACGL_IH_MAX_ACTIONS];
+  Uint8 combo_fires[ACGL_IH_MAX_COMBOS];
+} ACGL_ih_action_state_t;
+
+static inline bool ACGL_ih_action_held(const ACGL_ih_action_state_t* state, Uint16 action) {
+  return action < ACGL_IH_MAX_ACTIONS && (state->held[action >> 6] >> (action & 63)) & 1;
+}
+static inline bool ACGL_ih_action_pressed(const ACGL_ih_action_state_t* state, Uint16 action) {
+  return action < ACGL_IH_MAX_ACTIONS && (state->pressed[action >> 6] >> (action & 63)) & 1;
+}
+static inline bool ACGL_ih_action_released(const ACGL_ih_action_state_t* state, Uint16 action) {
+  return action < ACGL_IH_MAX_ACTIONS && (state->released[action >> 6] >> (action & 63)) & 1;
+}
+static inline bool ACGL_ih_combo_held(const ACGL_ih_action_state_t* state, int combo) {
+  return combo >= 0 && combo < ACGL_IH_MAX_COMBOS && (state->combos_held >> combo) & 1;
+}
+static inline bool ACGL_ih_combo_fired(const ACGL_ih_action_state_t* state, int combo) {
+  return combo >= 0 && combo < ACGL_IH_MAX_COMBOS && (state->combos_fired >> combo) & 1;
+}
+
+enum ACGL_IH_COMBO_KIND {
+  ACGL_IH_COMBO_CHORD,
+  ACGL_IH_COMBO_SEQUENCE,
+};
+
+// DO NOT EDIT BY HAND
+typedef struct {
+  Uint8 kind;
+  Uint8 length;
+  Uint8 progress;  // sequences: how many steps are done
+  Uint16 actions[ACGL_IH_MAX_COMBO_LENGTH];
+  Uint64 mask[ACGL_IH_ACTION_WORDS]; // chords: every action in it
+  Uint64 timeout;  // sequences: most ns allowed between steps
+  Uint64 last;     // sequences: time of the last step
+} ACGL_ih_combo_t;
+
+struct ACGL_ih_actions {
+  ACGL_ih_keybinds_t* keybinds;
+  ACGL_ih_action_state_t state; // latest state, only for the updating thread
+  Uint64 tapped[ACGL_IH_ACTION_WORDS]; // went down in an event since the last update
+  Uint8 keys[SDL_NUM_SCANCODES]; // held according to the key events fed in
+  bool keys_from_events; // read keys instead of the keyboard, set by ACGL_ih_replay_frame
+  ACGL_ih_combo_t combos[ACGL_IH_MAX_COMBOS];
+  int combos_size;
+  ACGL_snapshot_t* subscribers[ACGL_IH_MAX_SUBSCRIBERS];
+  int subscribers_size;
+};
+
+extern ACGL_ih_actions_t* ACGL_ih_actions_create(ACGL_ih_keybinds_t* keybinds);
+extern void ACGL_ih_actions_destroy(ACGL_ih_actions_t* actions);
+
+// Both return: the combo's id, -1 on failure. Add combos before subscribing threads read them
+extern int ACGL_ih_actions_add_chord(ACGL_ih_actions_t* actions, const Uint16 chord[], int length);
+// timeout_ns is the longest gap allowed between two steps
+extern int ACGL_ih_actions_add_sequence(ACGL_ih_actions_t* actions, const Uint16 sequence[], int length, Uint64 timeout_ns);
+
+// Feed key events here (the pump does this when its actions field is set) so
+// a tap that starts and ends between two updates still counts as pressed,
+// and so replayed keys are held without the keyboard
+extern void ACGL_ih_actions_handle_event(ACGL_ih_actions_t* actions, const SDL_Event* event);
+// Builds this frame's state and publishes it to every subscriber. Call once
+// per frame on the thread that pumps events. Returns: the new state
+extern const ACGL_ih_action_state_t* ACGL_ih_actions_update(ACGL_ih_actions_t* actions, Uint64 now);
+
+// Returns: a snapshot of ACGL_ih_action_state_t for exactly one reader thread,
+// NULL on failure. Subscribe from the updating thread; the tracker owns it
+extern ACGL_snapshot_t* ACGL_ih_actions_subscribe(ACGL_ih_actions_t* actions);
+
+#endif // ACGL_INPUTSTATE_H
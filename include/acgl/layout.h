@@ -0,0 +1,109 @@
+#ifndef ACGL_LAYOUT_H
+#define ACGL_LAYOUT_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+
+// Screens stored as compact binary files instead of hand-written C. A file is
+// mapped into memory as-is and turned into a subtree in one pass, so even
+// big screens open almost instantly. tools/acgl_layoutc.c compiles the text
+// form into this format.
+//
+// File layout, little-endian, every field naturally aligned:
+//   ACGL_layout_header_t
+//   ACGL_layout_node_t    nodes[node_count]         in preorder
+//   ACGL_layout_symbol_t  callbacks[callback_count]
+//   char                  strings[strings_size]     callback names, not NUL-terminated
+
+#define ACGL_LAYOUT_MAGIC "ACGLLAY"
+#define ACGL_LAYOUT_VERSION 1
+#define ACGL_LAYOUT_NO_CALLBACK 0xFFFFFFFFu
+
+typedef struct {
+  char magic[7];
+  Uint8 version;
+  Uint32 node_count;
+  Uint32 callback_count;
+  Uint32 strings_size;
+} ACGL_layout_header_t;
+
+enum ACGL_LAYOUT_FLAGS {
+  ACGL_LAYOUT_X_FRAC = 0b0001,
+  ACGL_LAYOUT_Y_FRAC = 0b0010,
+  ACGL_LAYOUT_W_FRAC = 0b0100,
+  ACGL_LAYOUT_H_FRAC = 0b1000,
+  ACGL_LAYOUT_OPAQUE = 0b10000,
+};
+
+// One ACGL_gui_object_t. Its children are the child_count subtrees that
+// directly follow it
+typedef struct {
+  float x, y, w, h;
+  float min_w, min_h, max_w, max_h;
+  Uint32 child_count;
+  Uint32 callback; // index into the callback table, ACGL_LAYOUT_NO_CALLBACK for none
+  Uint8 anchor;    // ACGL_GUI_ANCHOR_POINTS
+  Uint8 node_type; // ACGL_GUI_NODE_TYPE
+  Uint8 flags;     // ACGL_LAYOUT_FLAGS
+  Uint8 reserved;
+} ACGL_layout_node_t;
+
+typedef struct {
+  Uint32 offset; // into strings
+  Uint32 length;
+} ACGL_layout_symbol_t;
+
+// A checked, read-only view of one layout file
+typedef struct ACGL_layout ACGL_layout_t;
+struct ACGL_layout {
+  const ACGL_layout_header_t* header;
+  const ACGL_layout_node_t* nodes;
+  const ACGL_layout_symbol_t* callbacks;
+  const char* strings;
+
+  // where the bytes came from, DO NOT EDIT
+  const void* data;
+  size_t size;
+  int backing;
+  void* handle;
+};
+
+// Callback IDs in layout files are names; a registry maps them to functions.
+// Every node using a name shares its data, which the registry doesn't own
+typedef struct {
+  char* name;
+  Uint32 length; // of name, checked before comparing its bytes
+  Uint32 hash;
+  ACGL_render_callback_t render;
+  void* data;
+} ACGL_layout_entry_t;
+
+typedef struct {
+  ACGL_layout_entry_t* entries; // open addressing, NULL name for an empty slot
+  Uint32 size;
+  Uint32 capacity; // always a power of two
+} ACGL_layout_registry_t;
+
+// Maps the file at path and checks it. Returns: NULL if it can't be read or isn't a valid layout
+extern ACGL_layout_t* ACGL_layout_open(const char* path);
+// Uses size bytes at data in place, e.g. a layout compiled into the program.
+// data must be 4-byte aligned and outlive the layout. Returns: NULL if it isn't a valid layout
+extern ACGL_layout_t* ACGL_layout_open_memory(const void* data, size_t size);
+// Nodes made from the layout stay valid after closing it
+extern void ACGL_layout_close(ACGL_layout_t* layout);
+
+extern ACGL_layout_registry_t* ACGL_layout_registry_create(void);
+extern void ACGL_layout_registry_destroy(ACGL_layout_registry_t* registry);
+// Registering a name again replaces it. Returns: 0 on success, -1 on failure
+extern int ACGL_layout_register(ACGL_layout_registry_t* registry, const char* name, ACGL_render_callback_t render, void* data);
+
+// Builds the layout's tree. The root is returned detached, add it wherever it
+// belongs. When nodes isn't NULL it receives every node in file order
+// (header->node_count entries), e.g. to hook up per-node data.
+// Returns: NULL on failure, including callback names missing from registry
+extern ACGL_gui_object_t* ACGL_layout_instantiate(ACGL_gui_t* gui, const ACGL_layout_t* layout, const ACGL_layout_registry_t* registry, ACGL_gui_object_t** nodes);
+
+#endif // ACGL_LAYOUT_H
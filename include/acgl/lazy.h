@@ -0,0 +1,57 @@
+#ifndef ACGL_LAZY_H
+#define ACGL_LAZY_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+
+// A node whose children only exist while it is on screen, for pages, tabs
+// and other subtrees that are mostly hidden. The children are built by a
+// callback the first time the node is drawn with a non-empty rect and not
+// culled, and destroyed again once it has been hidden (empty, culled, or off
+// the tree) for a while. Showing it again builds them anew, so startup cost
+// and resident memory follow what is visible, not everything that could be.
+//
+// Anything the children need to survive being rebuilt (scroll offsets, text
+// typed in) belongs in data, not in the children.
+
+typedef struct ACGL_gui_lazy ACGL_gui_lazy_t;
+// Adds node's children. Returns: false on failure, whatever was added is
+// destroyed and building is tried again the next time node is shown
+typedef bool (*ACGL_gui_lazy_build_t)(ACGL_gui_t* gui, ACGL_gui_object_t* node, void* data);
+
+// DO NOT EDIT BY HAND, use the functions below
+struct ACGL_gui_lazy {
+  ACGL_gui_t* gui;
+  ACGL_gui_object_t* node;
+  ACGL_gui_lazy_build_t build;
+  ACGL_destroy_callback_t destroy; // frees data with the node, optional
+  void* data;
+  Uint64 evict_after; // ns hidden before the children go, 0 to keep them
+  bool built;
+  Uint64 shown_at; // clock when last seen shown
+  ACGL_gui_lazy_t* prev;
+  ACGL_gui_lazy_t* next;
+};
+
+// Creates an empty lazy node. Its render and destroy callbacks are taken,
+// give it a background child to draw anything of its own.
+// Returns: NULL on failure
+extern ACGL_gui_object_t* ACGL_gui_lazy_create(ACGL_gui_t* gui, ACGL_gui_lazy_build_t build, ACGL_destroy_callback_t destroy, void* data, Uint64 evict_after);
+// REQUIRES: node came from ACGL_gui_lazy_create, and so for the rest
+extern void ACGL_gui_lazy_set_evict_after(ACGL_gui_object_t* node, Uint64 evict_after);
+extern bool ACGL_gui_lazy_is_built(ACGL_gui_object_t* node);
+// Destroys the children now, e.g. because what they show changed. They are
+// built again when the node is next shown, which may be the next frame
+extern void ACGL_gui_lazy_evict(ACGL_gui_object_t* node);
+
+// Destroys the children of lazy nodes hidden longer than their evict_after,
+// and builds those of shown nodes that weren't drawn since they were shown
+// (e.g. added back to the tree without being marked). Call it once per loop
+// iteration, before rendering. Lazy nodes another thread holds are skipped
+// until the next call. Returns: how many subtrees were destroyed
+extern size_t ACGL_gui_lazy_update(ACGL_gui_t* gui);
+
+#endif // ACGL_LAZY_H
@@ -0,0 +1,78 @@
+#ifndef ACGL_RECONCILE_H
+#define ACGL_RECONCILE_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+
+// Describe what a node's children should look like every time the app state
+// changes, and ACGL_gui_reconcile makes the retained tree match: nodes are
+// matched to descriptions by key among their siblings, then kept and updated,
+// moved, created or destroyed. Only nodes whose fields actually changed are
+// marked dirty, plus the parent when its children were added, removed or
+// reordered (it has to repaint what is behind them).
+
+enum ACGL_GUI_DESC_FLAGS {
+  // leave the node's current children alone, child_count has to be 0
+  ACGL_GUI_DESC_KEEP_CHILDREN = 0b0001,
+};
+
+// The wanted state of one node. Descriptions are stored in preorder: the
+// child_count subtrees that directly follow one are its children, as in
+// layout files
+typedef struct {
+  Uint64 key; // matched against ACGL_gui_object_t.key of the same parent's children
+  ACGL_render_callback_t render;
+  // nodes own their data like with ACGL_gui_node_init: when a kept node gets
+  // different data, its old data is destroyed with its old destroy callback
+  ACGL_destroy_callback_t destroy;
+  void* data;
+
+  int anchor;
+  int node_type;
+  ACGL_gui_pos_t x, y;
+  ACGL_gui_pos_t w, h;
+  ACGL_gui_pos_t min_w, min_h;
+  ACGL_gui_pos_t max_w, max_h;
+  bool x_frac, y_frac;
+  bool w_frac, h_frac;
+  bool opaque;
+
+  int flags; // ACGL_GUI_DESC_FLAGS
+  Uint32 child_count;
+} ACGL_gui_desc_t;
+
+// Builds descriptions in preorder with the same defaults as ACGL_gui_node_init.
+// Clear and refill it every update, it keeps its memory
+typedef struct {
+  ACGL_gui_desc_t* items;
+  size_t size;
+  size_t capacity;
+
+  // items currently taking children, DO NOT EDIT
+  size_t* open;
+  size_t depth;
+  size_t open_capacity;
+} ACGL_gui_desc_buffer_t;
+
+extern void ACGL_gui_desc_buffer_init(ACGL_gui_desc_buffer_t* buffer);
+extern void ACGL_gui_desc_buffer_free(ACGL_gui_desc_buffer_t* buffer);
+extern void ACGL_gui_desc_buffer_clear(ACGL_gui_desc_buffer_t* buffer);
+// Appends a description, as a child of the innermost open one. The pointer is
+// valid until the next push. Returns: NULL when out of memory
+extern ACGL_gui_desc_t* ACGL_gui_desc_push(ACGL_gui_desc_buffer_t* buffer, Uint64 key, ACGL_render_callback_t render, void* data);
+// Following pushes become children of the last pushed description, until
+// the matching ACGL_gui_desc_close. Returns: 0 on success, -1 on failure
+extern int ACGL_gui_desc_open(ACGL_gui_desc_buffer_t* buffer);
+extern void ACGL_gui_desc_close(ACGL_gui_desc_buffer_t* buffer);
+
+// Makes parent's children match the size descriptions at descs, a list of
+// subtrees in preorder (e.g. a closed buffer's items and size). Keys should
+// be unique among siblings; a repeated key gets a new node every time.
+// Each level is only touched once its new nodes exist, so a failure leaves a
+// valid tree, updated down to where it failed. Returns: 0 on success, -1 on failure
+extern int ACGL_gui_reconcile(ACGL_gui_t* gui, ACGL_gui_object_t* parent, const ACGL_gui_desc_t* descs, size_t size);
+
+#endif // ACGL_RECONCILE_H
@@ -0,0 +1,46 @@
+#ifndef ACGL_SYNC_H
+#define ACGL_SYNC_H
+
+#include <SDL.h>
+#include <stdbool.h>
+#include "config.h"
+
+// Locking used by the objects that can be shared between threads. In a
+// single-threaded build (ACGL_THREADING=OFF) all of it compiles to nothing:
+// the mutex fields disappear from the structs, and lock/unlock never
+// evaluate their argument, so they can name fields that don't exist.
+#if ACGL_THREADING
+
+// Declares a mutex field, e.g. ACGL_MUTEX(mutex)
+#define ACGL_MUTEX(name) SDL_mutex* name;
+// Returns: true on success
+#define ACGL_MUTEX_CREATE(m) (((m) = SDL_CreateMutex()) != NULL)
+#define ACGL_MUTEX_DESTROY(m) \
+  do { \
+    if ((m) != NULL) { \
+      SDL_DestroyMutex(m); \
+      (m) = NULL; \
+    } \
+  } while (0)
+// Returns: 0 on success, like SDL_LockMutex
+#define ACGL_MUTEX_LOCK(m) SDL_LockMutex(m)
+#define ACGL_MUTEX_TRYLOCK(m) SDL_TryLockMutex(m)
+#define ACGL_MUTEX_UNLOCK(m) SDL_UnlockMutex(m)
+
+#else
+
+// a call rather than a bare 0, so unchecked locks don't warn
+static inline int __acgl_mutex_nop(void) {
+  return 0;
+}
+
+#define ACGL_MUTEX(name)
+#define ACGL_MUTEX_CREATE(m) true
+#define ACGL_MUTEX_DESTROY(m) ((void)0)
+#define ACGL_MUTEX_LOCK(m) __acgl_mutex_nop()
+#define ACGL_MUTEX_TRYLOCK(m) __acgl_mutex_nop()
+#define ACGL_MUTEX_UNLOCK(m) ((void)0)
+
+#endif
+
+#endif // ACGL_SYNC_H
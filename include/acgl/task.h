@@ -0,0 +1,153 @@
+#ifndef ACGL_TASK_H
+#define ACGL_TASK_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "common.h"
+#include "clock.h"
+#include "channel.h"
+
+// Cooperative tasks for the UI thread: small state machines (fades, delayed
+// reveals, polling loops) that would otherwise each need an ACGL_thread_t.
+// A task is a plain function that is re-entered from the top every time it is
+// resumed and jumps straight back to where it last yielded, so it has no
+// stack of its own. Locals don't survive a yield; keep state in the task's data.
+//
+//   static bool fade_in(ACGL_task_t* task, void* data) {
+//     struct fade* fade = data;
+//     ACGL_TASK_BEGIN(task);
+//     for (fade->alpha = 0; fade->alpha < 255; fade->alpha += 15) {
+//       ACGL_TASK_SLEEP(task, 16 * ACGL_CLOCK_NS_PER_MS);
+//     }
+//     ACGL_TASK_END(task);
+//   }
+//
+// Don't use a switch statement that spans a yield inside a task function.
+// A scheduler is owned by one thread: spawn, cancel and run from that thread
+// only. Signals may be raised from any thread.
+
+enum ACGL_TASK_WAIT {
+  ACGL_TASK_WAIT_NONE,    // resume on the next run
+  ACGL_TASK_WAIT_TIME,    // resume once ACGL_clock_now() passes until
+  ACGL_TASK_WAIT_CHANNEL, // resume once channel is non-empty (or until passes)
+  ACGL_TASK_WAIT_SIGNAL,  // resume once signal is raised (or until passes)
+};
+
+// Edge-triggered event: every raise wakes every task waiting on the signal at that time
+typedef struct ACGL_task_signal ACGL_task_signal_t;
+struct ACGL_task_signal {
+  SDL_atomic_t count;
+};
+
+typedef struct ACGL_task ACGL_task_t;
+// Returns: true while the task wants to keep running, false once it's finished
+typedef bool (*ACGL_task_callback_t)(ACGL_task_t* task, void* data);
+// 0 is never a valid id
+typedef Uint64 ACGL_task_id_t;
+
+// Task bookkeeping. The task function reads timed_out and now, the macros
+// below write the rest. Anything else, DO NOT EDIT BY HAND
+struct ACGL_task {
+  Uint32 resume;    // where to continue in the task function, 0 to start over
+  Uint8 wait;       // ACGL_TASK_WAIT
+  Uint8 state;
+  bool timed_out;   // the last channel/signal wait ended by its timeout
+  Uint64 until;     // deadline in ns, 0 for none
+  Uint64 now;       // time of the run that resumed the task
+  ACGL_channel_t* channel;
+  ACGL_task_signal_t* signal;
+  int signal_seen;
+
+  ACGL_task_callback_t callback;
+  void* data;
+  ACGL_destroy_callback_t data_destroy;
+  Uint32 generation;
+  Uint32 next_free;
+};
+
+#define ACGL_TASK_CHUNK_BITS 8
+#define ACGL_TASK_CHUNK_SIZE (1 << ACGL_TASK_CHUNK_BITS)
+
+typedef struct ACGL_task_scheduler ACGL_task_scheduler_t;
+struct ACGL_task_scheduler {
+  // tasks live in fixed-size chunks so a running task's pointer stays valid
+  // when it spawns more tasks
+  ACGL_task_t** chunks;
+  Uint32 chunks_size;
+  Uint32 free_list;
+
+  Uint32* active; // indices of live tasks, in the order they are resumed
+  Uint32 active_size, active_capacity;
+  bool running;
+};
+
+// Task function structure. Everything between BEGIN and END runs as one resumable body
+#define ACGL_TASK_BEGIN(task) switch ((task)->resume) { case 0:
+#define ACGL_TASK_END(task) } (task)->resume = 0; return false
+
+// Saves the current position and returns to the scheduler; the next resume starts here
+#define __ACGL_TASK_SUSPEND(task) \
+  do { (task)->resume = __LINE__; return true; case __LINE__:; } while (0)
+
+// Gives up the rest of this frame
+#define ACGL_TASK_YIELD(task) \
+  do { (task)->wait = ACGL_TASK_WAIT_NONE; __ACGL_TASK_SUSPEND(task); } while (0)
+// Sleeps for at least ns nanoseconds
+#define ACGL_TASK_SLEEP(task, ns) \
+  do { \
+    (task)->until = ACGL_clock_now() + (Uint64)(ns); \
+    (task)->wait = ACGL_TASK_WAIT_TIME; \
+    __ACGL_TASK_SUSPEND(task); \
+  } while (0)
+// Polls cond once per run until it's true
+#define ACGL_TASK_WAIT_UNTIL(task, cond) \
+  do { \
+    (task)->wait = ACGL_TASK_WAIT_NONE; \
+    (task)->resume = __LINE__; case __LINE__: \
+    if (!(cond)) return true; \
+  } while (0)
+// Waits until chan has something to receive, or timeout_ns passes (0 waits forever).
+// The scheduler checks the channel itself, so a waiting task costs no call
+#define ACGL_TASK_WAIT_CHANNEL(task, chan, timeout_ns) \
+  do { \
+    (task)->channel = (chan); \
+    (task)->until = (timeout_ns) ? ACGL_clock_now() + (Uint64)(timeout_ns) : 0; \
+    (task)->wait = ACGL_TASK_WAIT_CHANNEL; \
+    __ACGL_TASK_SUSPEND(task); \
+  } while (0)
+// Waits until sig is raised after this point, or timeout_ns passes (0 waits forever)
+#define ACGL_TASK_WAIT_SIGNAL(task, sig, timeout_ns) \
+  do { \
+    (task)->signal = (sig); \
+    (task)->signal_seen = SDL_AtomicGet(&(sig)->count); \
+    (task)->until = (timeout_ns) ? ACGL_clock_now() + (Uint64)(timeout_ns) : 0; \
+    (task)->wait = ACGL_TASK_WAIT_SIGNAL; \
+    __ACGL_TASK_SUSPEND(task); \
+  } while (0)
+// Finishes the task early
+#define ACGL_TASK_EXIT(task) do { (task)->resume = 0; return false; } while (0)
+
+extern void ACGL_task_signal_init(ACGL_task_signal_t* signal);
+// Safe from any thread
+extern void ACGL_task_signal_raise(ACGL_task_signal_t* signal);
+
+extern ACGL_task_scheduler_t* ACGL_task_scheduler_create(void);
+// Destroys the data of every unfinished task
+extern void ACGL_task_scheduler_destroy(ACGL_task_scheduler_t* scheduler);
+
+// The new task first runs on the next ACGL_task_scheduler_run (not the current
+// one, when spawned from inside a task). Returns: the task's id, 0 on failure
+extern ACGL_task_id_t ACGL_task_spawn(ACGL_task_scheduler_t* scheduler, ACGL_task_callback_t callback, void* data, ACGL_destroy_callback_t data_destroy);
+// The task is never resumed again and its data is destroyed. A task may cancel itself.
+// Returns: true if the task was still alive
+extern bool ACGL_task_cancel(ACGL_task_scheduler_t* scheduler, ACGL_task_id_t id);
+extern bool ACGL_task_is_alive(ACGL_task_scheduler_t* scheduler, ACGL_task_id_t id);
+extern Uint32 ACGL_task_scheduler_count(ACGL_task_scheduler_t* scheduler);
+
+// Resumes every task whose wait is over, call once per frame with ACGL_clock_now().
+// Returns: number of tasks resumed
+extern Uint32 ACGL_task_scheduler_run(ACGL_task_scheduler_t* scheduler, Uint64 now);
+
+#endif // ACGL_TASK_H
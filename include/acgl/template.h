@@ -0,0 +1,70 @@
+#ifndef ACGL_TEMPLATE_H
+#define ACGL_TEMPLATE_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+
+// A widget repeated many times, built once as an ordinary subtree and then
+// drawn wherever it is needed. Instances share the template's nodes, their
+// geometry and callback_data; each only brings the data that differs, which
+// the template nodes marked with ACGL_gui_template_pass_data get instead of
+// their own callback_data. Laying the template out is cached for the last
+// few instance sizes, so same-size instances only offset stored rects.
+//
+// An instance can be a node of its own (ACGL_gui_template_instance), or
+// just a rect and a pointer drawn by a render callback that loops over many
+// of them with ACGL_gui_template_draw, which costs no node at all.
+//
+// A template is immutable once created: do not change its nodes, and
+// destroy it only after every instance of it.
+
+// Instance sizes whose layout a template remembers
+#define ACGL_GUI_TEMPLATE_CACHED_SIZES 4
+
+typedef struct {
+  ACGL_gui_object_t* node;
+  size_t parent; // index of the parent's entry, ACGL_GUI_TEMPLATE_ROOT for the root
+  bool pass_data; // gets the instance's data instead of node->callback_data
+} ACGL_gui_template_entry_t;
+
+#define ACGL_GUI_TEMPLATE_ROOT ((size_t)-1)
+
+typedef struct {
+  int w, h;     // instance size this layout is for, w < 0 if unused
+  SDL_Rect* rects; // one per entry, relative to the instance's top left
+} ACGL_gui_template_layout_t;
+
+// DO NOT EDIT BY HAND, use the functions below
+typedef struct ACGL_gui_template ACGL_gui_template_t;
+struct ACGL_gui_template {
+  ACGL_gui_object_t* root;
+  ACGL_gui_template_entry_t* entries; // in drawing order, parents first
+  size_t size;
+  ACGL_gui_template_layout_t layouts[ACGL_GUI_TEMPLATE_CACHED_SIZES];
+  int next_layout; // replaced when a size misses the cache
+  ACGL_MUTEX(mutex) // guards layouts, instances may be drawn from several threads
+};
+
+// Takes over root and its subtree, which must not be part of a tree.
+// Returns: NULL on failure, with root left to the caller
+extern ACGL_gui_template_t* ACGL_gui_template_create(ACGL_gui_object_t* root);
+// Destroys the template's nodes too
+extern void ACGL_gui_template_destroy(ACGL_gui_template_t* tmpl);
+// Makes node (root or any node below it) get each instance's data.
+// Returns: false if node isn't part of the template
+extern bool ACGL_gui_template_pass_data(ACGL_gui_template_t* tmpl, ACGL_gui_object_t* node);
+
+// Draws one instance of the template into rect.
+// Returns: whether anything was drawn, like a render callback
+extern bool ACGL_gui_template_draw(ACGL_gui_template_t* tmpl, SDL_Window* window, SDL_Rect rect, void* data);
+// Creates a node that draws an instance with data wherever it is laid out.
+// data is not freed with the node. Returns: NULL on failure
+extern ACGL_gui_object_t* ACGL_gui_template_instance(ACGL_gui_t* gui, ACGL_gui_template_t* tmpl, void* data);
+// Gives an instance node other data and redraws it.
+// REQUIRES: node came from ACGL_gui_template_instance
+extern void ACGL_gui_template_instance_set_data(ACGL_gui_object_t* node, void* data);
+
+#endif // ACGL_TEMPLATE_H
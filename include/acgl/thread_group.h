@@ -0,0 +1,74 @@
+#ifndef ACGL_THREAD_GROUP_H
+#define ACGL_THREAD_GROUP_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "threads.h"
+
+// Reusable barrier. With held set, the last thread to arrive does not
+// release the others; a controller (e.g. the UI thread) waits for everyone
+// with ACGL_barrier_wait_arrivals, does its work while they are parked, then
+// lets them go with ACGL_barrier_release.
+struct ACGL_barrier {
+  SDL_mutex* mutex;
+  SDL_cond* cond;
+  Uint32 count;      // threads that have to arrive
+  Uint32 arrived;
+  Uint32 generation; // bumped on every release
+  bool held;
+  bool cancelled;
+};
+
+#define ACGL_BARRIER_SERIAL 1    // returned to the last thread to arrive at a barrier that isn't held
+#define ACGL_BARRIER_CANCELLED (-1)
+
+extern ACGL_barrier_t* ACGL_barrier_create(Uint32 count, bool held);
+extern void ACGL_barrier_destroy(ACGL_barrier_t* barrier);
+// Returns: 0 or ACGL_BARRIER_SERIAL once released, ACGL_BARRIER_CANCELLED if cancelled
+extern int ACGL_barrier_wait(ACGL_barrier_t* barrier);
+// Controller side of a held barrier. Returns: false on timeout or cancellation
+extern bool ACGL_barrier_wait_arrivals(ACGL_barrier_t* barrier, Uint32 timeout_ms);
+extern void ACGL_barrier_release(ACGL_barrier_t* barrier);
+// Wakes every waiter with ACGL_BARRIER_CANCELLED, and makes all waits fail until reset
+extern void ACGL_barrier_cancel(ACGL_barrier_t* barrier);
+extern void ACGL_barrier_reset(ACGL_barrier_t* barrier, Uint32 count);
+// For a participant that won't arrive anymore (e.g. its thread exited)
+extern void ACGL_barrier_leave(ACGL_barrier_t* barrier);
+
+// A set of ACGL_thread_t's that start and stop together. Stopping signals
+// every member before joining any of them, so it takes about as long as
+// the slowest tick instead of the sum of all of them.
+typedef struct ACGL_thread_group ACGL_thread_group_t;
+struct ACGL_thread_group {
+  ACGL_thread_t** members;
+  size_t members_size, members_capacity;
+  ACGL_barrier_t* phase; // NULL unless phase sync is on
+};
+
+extern ACGL_thread_group_t* ACGL_thread_group_create(void);
+// destroy_members also calls ACGL_thread_destroy on every member
+extern void ACGL_thread_group_destroy(ACGL_thread_group_t* group, bool destroy_members);
+// Members can only be added while the group is stopped. Returns nonzero on failure
+extern int ACGL_thread_group_add(ACGL_thread_group_t* group, ACGL_thread_t* thread);
+// Makes every member wait at the group's barrier after each tick until the
+// controller calls ACGL_thread_group_release. Only while stopped. Returns nonzero on failure
+extern int ACGL_thread_group_enable_phase_sync(ACGL_thread_group_t* group);
+
+// Threads are named "<name>-<index>". Returns nonzero (with no member left
+// running) if any member could not be started
+extern int ACGL_thread_group_start(ACGL_thread_group_t* group, const char* name);
+// Returns: 0 if every member's thread returned 0
+extern int ACGL_thread_group_stop(ACGL_thread_group_t* group);
+// Joins every member without asking them to stop, for groups whose tick
+// functions finish on their own. Returns: same as ACGL_thread_group_stop
+extern int ACGL_thread_group_wait(ACGL_thread_group_t* group);
+
+// Phase sync: wait until every running member finished its tick, look at
+// their results, then release them into the next tick.
+// Returns: false on timeout or while stopping
+extern bool ACGL_thread_group_sync(ACGL_thread_group_t* group, Uint32 timeout_ms);
+extern void ACGL_thread_group_release(ACGL_thread_group_t* group);
+
+#endif // ACGL_THREAD_GROUP_H
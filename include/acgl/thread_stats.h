@@ -0,0 +1,46 @@
+#ifndef ACGL_THREAD_STATS_H
+#define ACGL_THREAD_STATS_H
+
+#include <SDL.h>
+#include <stdbool.h>
+
+// HDR-style histogram of nanosecond values: each power of two is split into
+// 2^ACGL_HISTOGRAM_SUB_BITS linear buckets, so any recorded value is off by
+// at most 1/2^ACGL_HISTOGRAM_SUB_BITS (12.5%). Values above 2^ACGL_HISTOGRAM_MAX_BITS
+// ns (about 18 minutes) land in the last bucket.
+#define ACGL_HISTOGRAM_SUB_BITS 3
+#define ACGL_HISTOGRAM_MAX_BITS 40
+#define ACGL_HISTOGRAM_BUCKETS ((ACGL_HISTOGRAM_MAX_BITS - ACGL_HISTOGRAM_SUB_BITS + 2) << ACGL_HISTOGRAM_SUB_BITS)
+
+typedef struct ACGL_histogram ACGL_histogram_t;
+struct ACGL_histogram {
+  Uint64 count;
+  Uint64 sum;
+  Uint64 min, max;
+  Uint32 buckets[ACGL_HISTOGRAM_BUCKETS];
+};
+
+extern void ACGL_histogram_reset(ACGL_histogram_t* histogram);
+extern void ACGL_histogram_record(ACGL_histogram_t* histogram, Uint64 value);
+// p in [0, 1]. Returns: upper bound of the bucket holding that percentile, 0 if empty
+extern Uint64 ACGL_histogram_percentile(const ACGL_histogram_t* histogram, double p);
+
+// What an ACGL_thread_t measured about itself since it was last started.
+// All times are in nanoseconds
+typedef struct ACGL_thread_stats ACGL_thread_stats_t;
+struct ACGL_thread_stats {
+  Uint64 ticks;
+  Uint64 overruns;   // ticks that ended after the next tick should have started
+  Uint64 skipped;    // ticks dropped to get back on schedule
+  Uint64 jitter;     // smoothed change in lateness between ticks (RFC 3550 style)
+  Uint64 lock_waits; // calls to ACGL_thread_lock_data made by the thread itself
+  Uint64 lock_wait;  // total time those calls spent waiting for the mutex
+  ACGL_histogram_t duration; // time spent in tickfn
+  ACGL_histogram_t lateness; // how long after its deadline each tick started
+};
+
+typedef void (*ACGL_thread_stats_callback_t)(const ACGL_thread_stats_t*, void*);
+
+extern void ACGL_thread_stats_reset(ACGL_thread_stats_t* stats);
+
+#endif // ACGL_THREAD_STATS_H
@@ -7,19 +7,85 @@
 #include <stdlib.h>
 #include <time.h>
 #include "common.h"
+#include "clock.h"
+#include "thread_stats.h"
+#include "channel.h"
+#include "sync.h"
 
-// How long of a gap we should have before enforcing min_tick
-extern Uint32 ACGL_THREAD_DELAY_CUTOFF; // = 5
+// How close to a tick deadline (in ms) we stop sleeping and spin instead.
+// Larger values trade CPU time for less jitter.
+extern Uint32 ACGL_THREAD_DELAY_CUTOFF; // = 2
+
+// What to do when a tick finishes after the next one should have started
+enum ACGL_THREAD_OVERRUN_POLICY {
+  ACGL_THREAD_OVERRUN_SKIP,     // drop the missed ticks and stay in phase with the schedule
+  ACGL_THREAD_OVERRUN_CATCH_UP, // run late ticks back-to-back (at most max_catch_up) until on schedule again
+};
+
+// Scheduling classes. Each picks a default priority and how the scheduler
+// waits for the next tick
+enum ACGL_THREAD_CLASS {
+  ACGL_THREAD_CLASS_NORMAL,      // normal priority, spins the last ACGL_THREAD_DELAY_CUTOFF ms
+  ACGL_THREAD_CLASS_BACKGROUND,  // low priority, never spins; would rather be late than burn CPU
+  ACGL_THREAD_CLASS_INTERACTIVE, // high priority, e.g. input handling
+  ACGL_THREAD_CLASS_DEADLINE,    // time critical priority, spins twice as long to hit every deadline
+};
+
+// How often a running thread publishes its ACGL_thread_stats_t, in ns
+#define ACGL_THREAD_STATS_PUBLISH_INTERVAL (10 * ACGL_CLOCK_NS_PER_MS)
+
+typedef struct ACGL_snapshot ACGL_snapshot_t;
+typedef struct ACGL_barrier ACGL_barrier_t; // see thread_group.h
 
 // Tick function to be called every loop iteration in a thread
 // Returns false when loop should stop
 typedef bool (*ACGL_tick_callback_t)(void*);
 
+// Same shape as the input handler callbacks, run on the thread when it
+// drains its inbox. The return value is ignored
+typedef int (*ACGL_thread_event_callback_t)(const SDL_Event*, void*);
+
+// One queued event, copied into the inbox by ACGL_thread_post
+typedef struct ACGL_thread_message ACGL_thread_message_t;
+struct ACGL_thread_message {
+  ACGL_thread_event_callback_t callback;
+  void* data;
+  SDL_Event event;
+};
+
+// How many inbox messages are received at once at the start of a tick
+#define ACGL_THREAD_INBOX_BATCH 32
+
 typedef struct ACGL_thread_data ACGL_thread_data_t;
 struct ACGL_thread_data {
-  SDL_mutex* mutex;
-  bool running;
-  Uint32 min_tick;
+  // control state, only touched through the ACGL_thread_* functions.
+  // none of it needs a lock, so stopping never waits on a tick in progress
+  SDL_atomic_t running;        // nonzero between ACGL_thread_start and the join
+  SDL_atomic_t stop_requested; // checked by the scheduler between ticks
+  SDL_sem* wake;               // posted to cut the scheduler's sleep short
+  Uint64 period; // nanoseconds between tick starts, 0 to tick as fast as possible
+  int overrun_policy;
+  Uint32 max_catch_up;
+  int thread_class;
+  int priority;        // an SDL_ThreadPriority, or -1 for the class default
+  Uint64 affinity;     // bit n allows running on CPU n, 0 for anywhere
+  size_t stack_size;   // 0 for SDL's default
+  ACGL_barrier_t* tick_barrier; // waited on after every tick, set by ACGL_thread_group_enable_phase_sync
+  ACGL_channel_t* inbox;        // MPSC channel of ACGL_thread_message_t, NULL unless enabled
+  SDL_atomic_t inbox_dropped;   // messages lost because the inbox was full
+
+  // telemetry. stats is only ever touched by the running thread, which
+  // copies it into stats_snapshot for ACGL_thread_get_stats
+  ACGL_thread_stats_t* stats;
+  ACGL_snapshot_t* stats_snapshot;
+  ACGL_thread_stats_callback_t stats_callback;
+  void* stats_callback_data;
+  Uint64 stats_interval;
+
+  // user state. the tick callbacks run WITHOUT this mutex held; both sides
+  // take it (briefly!) through ACGL_thread_lock_data when touching whatever
+  // part of extra_data they share, or use an ACGL_snapshot_t instead
+  ACGL_MUTEX(mutex)
   void* extra_data; // passed to the wrapped tick function
 };
 
@@ -33,7 +99,8 @@ struct ACGL_thread {
   ACGL_thread_data_t* data;
 };
 
-// Creates a new thread to run, but does not start it
+// Creates a new thread to run, but does not start it. min_tick is in milliseconds,
+// use ACGL_thread_set_period for finer control
 extern ACGL_thread_t* ACGL_thread_create(
   ACGL_tick_callback_t setupfn,
   ACGL_tick_callback_t tickfn,
@@ -42,16 +109,79 @@ extern ACGL_thread_t* ACGL_thread_create(
   void* extra_data,
   ACGL_destroy_callback_t extra_data_destroy
 );
-// Starts running a thread if it isn't running already. Returns nonzero when thread could not be started
+// Scheduling settings, only take effect when set before ACGL_thread_start
+extern void ACGL_thread_set_period(ACGL_thread_t* target, Uint64 period_ns);
+extern void ACGL_thread_set_overrun_policy(ACGL_thread_t* target, int policy, Uint32 max_catch_up);
+extern void ACGL_thread_set_class(ACGL_thread_t* target, int thread_class);
+extern void ACGL_thread_set_priority(ACGL_thread_t* target, SDL_ThreadPriority priority);
+extern void ACGL_thread_set_stack_size(ACGL_thread_t* target, size_t stack_size);
+// Only supported on Linux, where the mask covers CPUs 0-63.
+// Returns nonzero when affinity can't be set on this platform
+extern int ACGL_thread_set_affinity(ACGL_thread_t* target, Uint64 cpu_mask);
+// Gives the thread an inbox of (at least) capacity messages, drained at the
+// start of every tick before tickfn runs. Call before ACGL_thread_start.
+// Returns nonzero if the inbox could not be created
+extern int ACGL_thread_enable_inbox(ACGL_thread_t* target, Uint32 capacity);
+// Queues callback(event, data) to run on the thread. Never blocks and never
+// allocates, so it is cheap enough for the UI thread's event loop. Messages
+// from one sending thread arrive in the order they were posted.
+// Returns: false if the thread has no inbox or it is full (the message is dropped)
+extern bool ACGL_thread_post(ACGL_thread_t* target, ACGL_thread_event_callback_t callback, void* data, const SDL_Event* event);
+// Returns: how many posted messages were dropped so far
+extern Uint32 ACGL_thread_inbox_dropped(ACGL_thread_t* target);
+// Starts running a thread if it isn't running already. Returns nonzero when thread could not be started.
+// Threads still run when ACGL is built with ACGL_THREADING=OFF and channels and inboxes still
+// work, but nothing else is synchronized: a gui tree or timer wheel is then only for one thread
 extern int ACGL_thread_start(ACGL_thread_t* target, const char* thread_name);
 // Stops a running thread. Returns same as return code of thread
 extern int ACGL_thread_stop(ACGL_thread_t* target);
+// The two halves of ACGL_thread_stop. request_stop never blocks; the thread
+// exits as soon as its current tick (if any) returns
+extern void ACGL_thread_request_stop(ACGL_thread_t* target);
+extern int ACGL_thread_join(ACGL_thread_t* target);
+extern bool ACGL_thread_is_running(ACGL_thread_t* target);
+// Long-running tick functions can poll this to bail out early
+extern bool ACGL_thread_should_stop(ACGL_thread_t* target);
+// Returns: the ACGL_thread_t running the calling code, NULL on threads not started by ACGL
+extern ACGL_thread_t* ACGL_thread_current(void);
+// Copies the thread's most recently published statistics (at most
+// ACGL_THREAD_STATS_PUBLISH_INTERVAL old) into out. Only call this from one
+// thread, normally the UI thread. Returns: false if nothing was published yet
+extern bool ACGL_thread_get_stats(ACGL_thread_t* target, ACGL_thread_stats_t* out);
+// Calls callback on the thread itself about every interval_ns with its live
+// statistics. Only takes effect when set before ACGL_thread_start
+extern void ACGL_thread_set_stats_callback(ACGL_thread_t* target, ACGL_thread_stats_callback_t callback, Uint64 interval_ns, void* data);
+// Short critical sections around shared parts of extra_data. Without threading
+// (ACGL_THREADING=OFF) these don't lock anything, share through a channel or
+// ACGL_snapshot_t instead. Returns nonzero if the mutex could not be locked
+extern int ACGL_thread_lock_data(ACGL_thread_t* target);
+extern void ACGL_thread_unlock_data(ACGL_thread_t* target);
 // Destroys a thread object, freeing all memory associated with it
 extern void ACGL_thread_destroy(ACGL_thread_t* target);
 // Function that actually runs the loop
 // Returns 0 if tick function stops on its own
 extern int ACGL_thread_mainloop(void* target);
 
+// Lock-free triple buffer for publishing a worker's results. The writer fills
+// the buffer from ACGL_snapshot_write_buffer and publishes it; the reader always
+// gets the most recently published copy without ever waiting on the writer.
+// Exactly one thread may write and one thread may read.
+struct ACGL_snapshot {
+  Uint8* buffers; // 3 * size bytes
+  size_t size;
+  SDL_atomic_t middle; // index of the shared buffer, plus ACGL_SNAPSHOT_FRESH if unread
+  int back;  // index owned by the writer
+  int front; // index owned by the reader
+};
+
+extern ACGL_snapshot_t* ACGL_snapshot_create(size_t size);
+extern void ACGL_snapshot_destroy(ACGL_snapshot_t* snapshot);
+extern void* ACGL_snapshot_write_buffer(ACGL_snapshot_t* snapshot);
+extern void ACGL_snapshot_publish(ACGL_snapshot_t* snapshot);
+// Returns: the newest published buffer, valid until the next call. fresh (if not NULL)
+// is set when it differs from what the previous call returned
+extern const void* ACGL_snapshot_read(ACGL_snapshot_t* snapshot, bool* fresh);
+
 // Safety functions
 extern bool __acgl_is_thread_data(ACGL_thread_data_t* data);
 extern bool __acgl_is_thread(ACGL_thread_t* target);
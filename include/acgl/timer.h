@@ -0,0 +1,87 @@
+#ifndef ACGL_TIMER_H
+#define ACGL_TIMER_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "clock.h"
+#include "sync.h"
+
+// Hierarchical timer wheel: lots of one-shot and repeating timers serviced
+// from one thread. Adding and cancelling are O(1); expired timers are
+// collected in one pass and their callbacks run afterwards as a batch.
+//
+// Either call ACGL_timer_wheel_advance from the UI thread's frame loop, or
+// run the wheel on its own ACGL_thread_t with ACGL_timer_wheel_tick as the
+// tickfn and the wheel as extra_data. Timers may be added or cancelled from
+// any thread, including from inside timer callbacks.
+
+#define ACGL_TIMER_LEVELS 6
+#define ACGL_TIMER_SLOTS_BITS 6
+#define ACGL_TIMER_SLOTS (1 << ACGL_TIMER_SLOTS_BITS)
+#define ACGL_TIMER_NIL 0xFFFFFFFFu
+
+// 0 is never a valid id
+typedef Uint64 ACGL_timer_id_t;
+typedef void (*ACGL_timer_callback_t)(ACGL_timer_id_t, void*);
+
+typedef struct ACGL_timer_expiry ACGL_timer_expiry_t;
+struct ACGL_timer_expiry {
+  ACGL_timer_id_t id;
+  ACGL_timer_callback_t callback;
+  void* data;
+};
+
+// Internal bookkeeping for one timer, DO NOT EDIT BY HAND
+typedef struct ACGL_timer ACGL_timer_t;
+struct ACGL_timer {
+  Uint64 expires; // in wheel ticks
+  Uint64 period;  // in wheel ticks, 0 for one-shot timers
+  ACGL_timer_callback_t callback;
+  void* data;
+  Uint32 generation;
+  Uint32 prev, next; // links within a wheel slot, or the free list
+  Uint16 slot;       // level * ACGL_TIMER_SLOTS + index, while scheduled
+  Uint8 state;
+};
+
+typedef struct ACGL_timer_wheel ACGL_timer_wheel_t;
+struct ACGL_timer_wheel {
+  ACGL_MUTEX(mutex)
+  Uint64 resolution; // nanoseconds per wheel tick
+  Uint64 origin;     // ACGL_clock_now() at wheel tick 0
+  Uint64 now;        // next wheel tick to process
+  Uint32 active;     // number of scheduled timers
+
+  ACGL_timer_t* timers;
+  Uint32 timers_size, timers_capacity;
+  Uint32 free_list;
+  Uint32 slots[ACGL_TIMER_LEVELS][ACGL_TIMER_SLOTS];
+
+  // expirations collected by the last advance, reused between calls
+  ACGL_timer_expiry_t* batch;
+  size_t batch_size, batch_capacity;
+};
+
+// resolution is the length of one wheel tick in nanoseconds; delays are rounded up to it.
+// Delays past the wheel's span (2^36 ticks) still fire on time, they are only
+// filed away again each time the top level comes round to them
+extern ACGL_timer_wheel_t* ACGL_timer_wheel_create(Uint64 resolution);
+extern void ACGL_timer_wheel_destroy(ACGL_timer_wheel_t* wheel);
+
+// delay and period in nanoseconds. period 0 makes a one-shot timer.
+// Returns: the new timer's id, 0 on failure
+extern ACGL_timer_id_t ACGL_timer_add(ACGL_timer_wheel_t* wheel, Uint64 delay, Uint64 period, ACGL_timer_callback_t callback, void* data);
+// Returns: true if the timer was still pending and will now never fire
+extern bool ACGL_timer_cancel(ACGL_timer_wheel_t* wheel, ACGL_timer_id_t id);
+
+// Runs every timer due at time `now` (from ACGL_clock_now). Returns: number of callbacks run
+extern size_t ACGL_timer_wheel_advance(ACGL_timer_wheel_t* wheel, Uint64 now);
+// Like advance, but copies up to max due expirations into out instead of running callbacks.
+// Anything over max stays due for the next call
+extern size_t ACGL_timer_wheel_poll(ACGL_timer_wheel_t* wheel, Uint64 now, ACGL_timer_expiry_t* out, size_t max);
+// ACGL_tick_callback_t that advances the wheel (passed as extra_data) to the current time
+extern bool ACGL_timer_wheel_tick(void* wheel);
+
+#endif // ACGL_TIMER_H
@@ -0,0 +1,105 @@
+#ifndef ACGL_VLIST_H
+#define ACGL_VLIST_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gui.h"
+
+// A scrolling list (or grid) of any number of items that only has nodes for
+// the rows in view plus a few around them. Rows scrolling out of view give
+// their nodes to rows scrolling in, and rows that stay in view are only
+// moved, not bound again. Memory and frame cost follow the viewport, not the
+// item count.
+//
+// Rows have one fixed extent (height, or width for horizontal lists), or are
+// measured once when they first come into view. Until then they count as the
+// fixed extent, so the content extent is an estimate that sharpens while
+// scrolling.
+//
+// The list works off the container's rect from the last render, so call
+// ACGL_vlist_update before every ACGL_gui_render. It requests another render
+// when the viewport turns out to have changed.
+//
+// The container clips its children: rows wholly outside it are not drawn.
+// A row only partly inside is drawn, and should clip its own drawing to
+// ACGL_gui_clip_rect so it stays off the container's neighbours.
+
+typedef struct ACGL_vlist ACGL_vlist_t;
+// Makes node show item index: set its render callback, data and anything else
+// but its position, which the list owns. node may have shown another item
+// before, and still has that item's callback_data; reuse it rather than
+// allocating per item
+typedef void (*ACGL_vlist_bind_t)(ACGL_vlist_t* list, ACGL_gui_object_t* node, size_t index, void* data);
+// Returns: the extent of row row in pixels. In a grid a row holds columns items
+typedef ACGL_gui_pos_t (*ACGL_vlist_measure_t)(ACGL_vlist_t* list, size_t row, void* data);
+
+typedef struct {
+  ACGL_gui_object_t* node;
+  size_t index; // item shown
+  bool stale;   // the item changed since it was bound
+} ACGL_vlist_slot_t;
+
+#define ACGL_VLIST_NONE ((size_t)-1)
+
+struct ACGL_vlist {
+  ACGL_gui_t* gui;
+  ACGL_gui_object_t* node; // the container, add it wherever it belongs
+  ACGL_vlist_bind_t bind;
+  ACGL_vlist_measure_t measure; // NULL for rows of the fixed extent
+  void* data;
+  // drawn under the rows, optional. background_data isn't freed
+  ACGL_render_callback_t background;
+  void* background_data;
+
+  bool horizontal;     // rows go left to right instead of top to bottom
+  size_t overscan;     // rows kept bound past either end of the viewport
+
+  // set these through the functions below, DO NOT EDIT
+  size_t count;           // items
+  size_t columns;         // items per row
+  size_t rows;
+  ACGL_gui_pos_t extent;  // of every row, or the estimate for unmeasured ones
+  double scroll;          // offset of the viewport into the content
+  size_t scroll_item;     // brought into view on update, ACGL_VLIST_NONE if none
+  SDL_Rect viewport;      // container rect the rows were placed for
+  float* measured;        // each row's measured extent, negative if unknown
+  double* tree;           // Fenwick tree over the row extents, when measuring
+  // slots[0, bound) show items first_item, first_item + 1, ... in order and
+  // are children of node; the rest are spare nodes off the tree. back is
+  // scratch space of the same capacity
+  ACGL_vlist_slot_t* slots;
+  ACGL_vlist_slot_t* back;
+  size_t slots_size, slots_bound, slots_capacity;
+  size_t first_item;
+};
+
+// Creates the list with its container node: vertical, one column, rows of
+// 24 pixels and 2 rows of overscan. Destroying the container (directly or
+// with its parent) destroys the list. Returns: NULL on failure
+extern ACGL_vlist_t* ACGL_vlist_create(ACGL_gui_t* gui, ACGL_vlist_bind_t bind, void* data);
+
+// Returns: 0 on success, -1 on failure with the list unchanged
+extern int ACGL_vlist_set_count(ACGL_vlist_t* list, size_t count);
+extern int ACGL_vlist_set_columns(ACGL_vlist_t* list, size_t columns);
+// measure may be NULL to go back to fixed extents
+extern int ACGL_vlist_set_measure(ACGL_vlist_t* list, ACGL_vlist_measure_t measure);
+extern void ACGL_vlist_set_extent(ACGL_vlist_t* list, ACGL_gui_pos_t extent);
+// The items changed: they are bound again, and their rows measured again
+extern void ACGL_vlist_invalidate(ACGL_vlist_t* list, size_t first, size_t count);
+
+// Offsets are clamped to the content on the next update
+extern void ACGL_vlist_scroll_to(ACGL_vlist_t* list, ACGL_gui_pos_t offset);
+extern void ACGL_vlist_scroll_by(ACGL_vlist_t* list, ACGL_gui_pos_t delta);
+// Scrolls just far enough for the item's row to be in view. Happens on the
+// next update, after the rows around it are measured
+extern void ACGL_vlist_scroll_to_item(ACGL_vlist_t* list, size_t index);
+// Returns: the length of all rows together, e.g. for a scrollbar
+extern ACGL_gui_pos_t ACGL_vlist_content_extent(const ACGL_vlist_t* list);
+
+// Binds, recycles and places the rows for the current scroll offset.
+// Returns: 0 on success, -1 on failure
+extern int ACGL_vlist_update(ACGL_vlist_t* list);
+
+#endif // ACGL_VLIST_H
@@ -0,0 +1,415 @@
+#include "alloc.h"
+#include <string.h>
+
+#define ACGL_ALLOC_ROUND(size) (((size) + ACGL_ALLOC_ALIGN - 1) & ~(size_t)(ACGL_ALLOC_ALIGN - 1))
+
+// Sits in front of every block from ACGL_malloc
+typedef union {
+	struct {
+		size_t size; // what the caller asked for
+		int subsystem;
+	} info;
+	Uint8 pad[ACGL_ALLOC_ALIGN];
+} __acgl_alloc_header_t;
+
+struct ACGL_arena_chunk {
+	ACGL_arena_chunk_t* next;
+	size_t size; // usable bytes after the (rounded up) chunk header
+	size_t used;
+};
+
+#define ACGL_ARENA_CHUNK_HEADER ACGL_ALLOC_ROUND(sizeof(ACGL_arena_chunk_t))
+#define ACGL_POOL_CHUNK_HEADER ACGL_ALLOC_ROUND(sizeof(void*))
+
+static void* __acgl_default_alloc(size_t size, void* context) {
+	(void)context;
+	return malloc(size);
+}
+
+static void* __acgl_default_realloc(void* ptr, size_t old_size, size_t new_size, void* context) {
+	(void)old_size;
+	(void)context;
+	return realloc(ptr, new_size);
+}
+
+static void __acgl_default_free(void* ptr, size_t size, void* context) {
+	(void)size;
+	(void)context;
+	free(ptr);
+}
+
+static ACGL_allocator_t __acgl_allocator = {
+	__acgl_default_alloc,
+	__acgl_default_realloc,
+	__acgl_default_free,
+	NULL,
+};
+
+static struct {
+	SDL_SpinLock lock;
+	ACGL_alloc_stats_t stats;
+} __acgl_alloc_counters[ACGL_ALLOC_SUBSYSTEM_COUNT];
+
+static void __acgl_alloc_count(int subsystem, Sint64 allocations, Sint64 frees, Sint64 bytes) {
+	SDL_AtomicLock(&__acgl_alloc_counters[subsystem].lock);
+	ACGL_alloc_stats_t* stats = &__acgl_alloc_counters[subsystem].stats;
+	stats->allocations += (Uint64)allocations;
+	stats->frees += (Uint64)frees;
+	stats->bytes += (Uint64)bytes;
+	if (stats->bytes > stats->peak_bytes) {
+		stats->peak_bytes = stats->bytes;
+	}
+	SDL_AtomicUnlock(&__acgl_alloc_counters[subsystem].lock);
+}
+
+int ACGL_set_allocator(const ACGL_allocator_t* allocator) {
+	REQUIRES(allocator == NULL || allocator->alloc != NULL);
+	// pools and arenas keep the allocator they were created with, so their
+	// chunks don't stand in the way
+	for (int i = 0; i < ACGL_ALLOC_ARENA; ++i) {
+		ACGL_alloc_stats_t stats;
+		ACGL_alloc_get_stats(i, &stats);
+		if (stats.allocations != stats.frees) {
+			fprintf(stderr, "Error: ACGL still owns memory, can't replace the allocator in ACGL_set_allocator\n");
+			return -1;
+		}
+	}
+	if (allocator == NULL) {
+		__acgl_allocator.alloc = __acgl_default_alloc;
+		__acgl_allocator.realloc = __acgl_default_realloc;
+		__acgl_allocator.free = __acgl_default_free;
+		__acgl_allocator.context = NULL;
+	} else {
+		__acgl_allocator = *allocator;
+	}
+	return 0;
+}
+
+void ACGL_get_allocator(ACGL_allocator_t* out) {
+	REQUIRES(out != NULL);
+	*out = __acgl_allocator;
+}
+
+void ACGL_alloc_get_stats(int subsystem, ACGL_alloc_stats_t* out) {
+	REQUIRES(subsystem >= 0 && subsystem < ACGL_ALLOC_SUBSYSTEM_COUNT);
+	REQUIRES(out != NULL);
+	SDL_AtomicLock(&__acgl_alloc_counters[subsystem].lock);
+	*out = __acgl_alloc_counters[subsystem].stats;
+	SDL_AtomicUnlock(&__acgl_alloc_counters[subsystem].lock);
+}
+
+void ACGL_alloc_get_total_stats(ACGL_alloc_stats_t* out) {
+	REQUIRES(out != NULL);
+	memset(out, 0, sizeof(ACGL_alloc_stats_t));
+	for (int i = 0; i < ACGL_ALLOC_SUBSYSTEM_COUNT; ++i) {
+		ACGL_alloc_stats_t stats;
+		ACGL_alloc_get_stats(i, &stats);
+		out->allocations += stats.allocations;
+		out->frees += stats.frees;
+		out->bytes += stats.bytes;
+		// peaks of different subsystems needn't line up, so this is an upper bound
+		out->peak_bytes += stats.peak_bytes;
+	}
+}
+
+void* ACGL_malloc(int subsystem, size_t size) {
+	REQUIRES(subsystem >= 0 && subsystem < ACGL_ALLOC_SUBSYSTEM_COUNT);
+	if (size > (size_t)-1 - sizeof(__acgl_alloc_header_t)) {
+		return NULL;
+	}
+	__acgl_alloc_header_t* header = (__acgl_alloc_header_t*)(*__acgl_allocator.alloc)(sizeof(__acgl_alloc_header_t) + size, __acgl_allocator.context);
+	if (header == NULL) {
+		return NULL;
+	}
+	header->info.size = size;
+	header->info.subsystem = subsystem;
+	__acgl_alloc_count(subsystem, 1, 0, (Sint64)size);
+	return header + 1;
+}
+
+void* ACGL_calloc(int subsystem, size_t count, size_t size) {
+	if (size != 0 && count > (size_t)-1 / size) {
+		return NULL;
+	}
+	void* ptr = ACGL_malloc(subsystem, count * size);
+	if (ptr != NULL) {
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+
+void* ACGL_realloc(int subsystem, void* ptr, size_t size) {
+	if (ptr == NULL) {
+		return ACGL_malloc(subsystem, size);
+	}
+	if (size > (size_t)-1 - sizeof(__acgl_alloc_header_t)) {
+		return NULL;
+	}
+	__acgl_alloc_header_t* header = (__acgl_alloc_header_t*)ptr - 1;
+	size_t old_size = header->info.size;
+	// the block stays in the subsystem it was allocated for
+	subsystem = header->info.subsystem;
+
+	__acgl_alloc_header_t* grown;
+	if (__acgl_allocator.realloc != NULL) {
+		grown = (__acgl_alloc_header_t*)(*__acgl_allocator.realloc)(header, sizeof(__acgl_alloc_header_t) + old_size, sizeof(__acgl_alloc_header_t) + size, __acgl_allocator.context);
+		if (grown == NULL) {
+			return NULL;
+		}
+	} else {
+		grown = (__acgl_alloc_header_t*)(*__acgl_allocator.alloc)(sizeof(__acgl_alloc_header_t) + size, __acgl_allocator.context);
+		if (grown == NULL) {
+			return NULL;
+		}
+		memcpy(grown + 1, header + 1, SDL_min(old_size, size));
+		if (__acgl_allocator.free != NULL) {
+			(*__acgl_allocator.free)(header, sizeof(__acgl_alloc_header_t) + old_size, __acgl_allocator.context);
+		}
+	}
+	grown->info.size = size;
+	grown->info.subsystem = subsystem;
+	__acgl_alloc_count(subsystem, 0, 0, (Sint64)size - (Sint64)old_size);
+	return grown + 1;
+}
+
+void ACGL_free(void* ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+	__acgl_alloc_header_t* header = (__acgl_alloc_header_t*)ptr - 1;
+	__acgl_alloc_count(header->info.subsystem, 0, 1, -(Sint64)header->info.size);
+	if (__acgl_allocator.free != NULL) {
+		(*__acgl_allocator.free)(header, sizeof(__acgl_alloc_header_t) + header->info.size, __acgl_allocator.context);
+	}
+}
+
+// Chunks for pools and arenas come straight from their parent allocator,
+// so an arena can be the global allocator without allocating from itself
+static void* __acgl_alloc_chunk(ACGL_allocator_t* parent, int subsystem, size_t size) {
+	void* chunk = (*parent->alloc)(size, parent->context);
+	if (chunk != NULL) {
+		__acgl_alloc_count(subsystem, 1, 0, (Sint64)size);
+	}
+	return chunk;
+}
+
+static void __acgl_free_chunk(ACGL_allocator_t* parent, int subsystem, void* chunk, size_t size) {
+	__acgl_alloc_count(subsystem, 0, 1, -(Sint64)size);
+	if (parent->free != NULL) {
+		(*parent->free)(chunk, size, parent->context);
+	}
+}
+
+ACGL_pool_t* ACGL_pool_create(size_t block_size, size_t blocks_per_chunk) {
+	REQUIRES(block_size > 0);
+	ACGL_allocator_t parent = __acgl_allocator;
+	ACGL_pool_t* pool = (ACGL_pool_t*)__acgl_alloc_chunk(&parent, ACGL_ALLOC_ARENA, sizeof(ACGL_pool_t));
+	if (pool == NULL) {
+		fprintf(stderr, "Error: could not allocate pool in ACGL_pool_create!\n");
+		return NULL;
+	}
+	pool->parent = parent;
+	// free blocks hold the free list link, and every block stays aligned
+	pool->block_size = ACGL_ALLOC_ROUND(SDL_max(block_size, sizeof(void*)));
+	pool->blocks_per_chunk = blocks_per_chunk > 0 ? blocks_per_chunk : SDL_max(4096 / pool->block_size, (size_t)8);
+	pool->chunks = NULL;
+	pool->free_list = NULL;
+	pool->blocks_used = 0;
+	pool->subsystem = ACGL_ALLOC_ARENA;
+	return pool;
+}
+
+void ACGL_pool_destroy(ACGL_pool_t* pool) {
+	if (pool == NULL) {
+		return;
+	}
+	size_t chunk_size = ACGL_POOL_CHUNK_HEADER + pool->block_size * pool->blocks_per_chunk;
+	void* chunk = pool->chunks;
+	while (chunk != NULL) {
+		void* next = *(void**)chunk;
+		__acgl_free_chunk(&pool->parent, pool->subsystem, chunk, chunk_size);
+		chunk = next;
+	}
+	ACGL_allocator_t parent = pool->parent;
+	__acgl_free_chunk(&parent, ACGL_ALLOC_ARENA, pool, sizeof(ACGL_pool_t));
+}
+
+void* ACGL_pool_alloc(ACGL_pool_t* pool) {
+	REQUIRES(pool != NULL);
+	if (pool->free_list == NULL) {
+		Uint8* chunk = (Uint8*)__acgl_alloc_chunk(&pool->parent, pool->subsystem, ACGL_POOL_CHUNK_HEADER + pool->block_size * pool->blocks_per_chunk);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		*(void**)chunk = pool->chunks;
+		pool->chunks = chunk;
+		// thread the new blocks onto the free list back to front, so they
+		// are handed out in address order
+		for (size_t i = pool->blocks_per_chunk; i > 0; --i) {
+			void* block = chunk + ACGL_POOL_CHUNK_HEADER + (i - 1) * pool->block_size;
+			*(void**)block = pool->free_list;
+			pool->free_list = block;
+		}
+	}
+	void* block = pool->free_list;
+	pool->free_list = *(void**)block;
+	++pool->blocks_used;
+	return block;
+}
+
+void ACGL_pool_free(ACGL_pool_t* pool, void* block) {
+	REQUIRES(pool != NULL);
+	if (block == NULL) {
+		return;
+	}
+	REQUIRES(pool->blocks_used > 0);
+	*(void**)block = pool->free_list;
+	pool->free_list = block;
+	--pool->blocks_used;
+}
+
+static void __acgl_arena_setup(ACGL_arena_t* arena) {
+	arena->reserved = 0;
+	arena->used = 0;
+	arena->peak = 0;
+	arena->first = NULL;
+	arena->current = NULL;
+	arena->lock = 0;
+}
+
+ACGL_arena_t* ACGL_arena_create(size_t chunk_size, size_t max_bytes) {
+	REQUIRES(chunk_size > 0);
+	ACGL_allocator_t parent = __acgl_allocator;
+	ACGL_arena_t* arena = (ACGL_arena_t*)__acgl_alloc_chunk(&parent, ACGL_ALLOC_ARENA, sizeof(ACGL_arena_t));
+	if (arena == NULL) {
+		fprintf(stderr, "Error: could not allocate arena in ACGL_arena_create!\n");
+		return NULL;
+	}
+	__acgl_arena_setup(arena);
+	arena->parent = parent;
+	arena->owns_chunks = true;
+	arena->chunk_size = ACGL_ALLOC_ROUND(chunk_size);
+	arena->max_bytes = max_bytes;
+	return arena;
+}
+
+int ACGL_arena_init(ACGL_arena_t* arena, void* buffer, size_t size) {
+	REQUIRES(arena != NULL);
+	REQUIRES(buffer != NULL);
+	__acgl_arena_setup(arena);
+	memset(&arena->parent, 0, sizeof(ACGL_allocator_t));
+	arena->owns_chunks = false;
+	arena->chunk_size = 0;
+	arena->max_bytes = size;
+
+	// the one chunk's header lives at the (aligned) start of the buffer
+	size_t skip = ACGL_ALLOC_ROUND((size_t)buffer) - (size_t)buffer;
+	if (size < skip + ACGL_ARENA_CHUNK_HEADER + ACGL_ALLOC_ALIGN) {
+		fprintf(stderr, "Error: buffer of %zu bytes is too small in ACGL_arena_init\n", size);
+		return -1;
+	}
+	ACGL_arena_chunk_t* chunk = (ACGL_arena_chunk_t*)((Uint8*)buffer + skip);
+	chunk->next = NULL;
+	chunk->size = (size - skip - ACGL_ARENA_CHUNK_HEADER) & ~(size_t)(ACGL_ALLOC_ALIGN - 1);
+	chunk->used = 0;
+	arena->first = chunk;
+	arena->current = chunk;
+	arena->reserved = size;
+	return 0;
+}
+
+void ACGL_arena_destroy(ACGL_arena_t* arena) {
+	if (arena == NULL || !arena->owns_chunks) {
+		// nothing of an arena over a caller's buffer is ours
+		return;
+	}
+	ACGL_arena_chunk_t* chunk = arena->first;
+	while (chunk != NULL) {
+		ACGL_arena_chunk_t* next = chunk->next;
+		__acgl_free_chunk(&arena->parent, ACGL_ALLOC_ARENA, chunk, ACGL_ARENA_CHUNK_HEADER + chunk->size);
+		chunk = next;
+	}
+	ACGL_allocator_t parent = arena->parent;
+	__acgl_free_chunk(&parent, ACGL_ALLOC_ARENA, arena, sizeof(ACGL_arena_t));
+}
+
+void* ACGL_arena_alloc(ACGL_arena_t* arena, size_t size) {
+	REQUIRES(arena != NULL);
+	if (size > (size_t)-1 - ACGL_ALLOC_ALIGN - ACGL_ARENA_CHUNK_HEADER) {
+		return NULL;
+	}
+	size = ACGL_ALLOC_ROUND(size);
+
+	// chunks past current are all empty since the last reset
+	ACGL_arena_chunk_t* last = NULL;
+	for (ACGL_arena_chunk_t* chunk = arena->current; chunk != NULL; chunk = chunk->next) {
+		if (chunk->size - chunk->used >= size) {
+			arena->current = chunk;
+			void* ptr = (Uint8*)chunk + ACGL_ARENA_CHUNK_HEADER + chunk->used;
+			chunk->used += size;
+			arena->used += size;
+			arena->peak = SDL_max(arena->peak, arena->used);
+			return ptr;
+		}
+		last = chunk;
+	}
+	if (!arena->owns_chunks) {
+		return NULL;
+	}
+
+	size_t chunk_size = SDL_max(arena->chunk_size, size);
+	if (arena->max_bytes != 0) {
+		size_t left = arena->max_bytes > arena->reserved ? arena->max_bytes - arena->reserved : 0;
+		left = left > ACGL_ARENA_CHUNK_HEADER ? (left - ACGL_ARENA_CHUNK_HEADER) & ~(size_t)(ACGL_ALLOC_ALIGN - 1) : 0;
+		if (left < size) {
+			return NULL;
+		}
+		chunk_size = SDL_min(chunk_size, left);
+	}
+	ACGL_arena_chunk_t* chunk = (ACGL_arena_chunk_t*)__acgl_alloc_chunk(&arena->parent, ACGL_ALLOC_ARENA, ACGL_ARENA_CHUNK_HEADER + chunk_size);
+	if (chunk == NULL) {
+		return NULL;
+	}
+	chunk->next = NULL;
+	chunk->size = chunk_size;
+	chunk->used = size;
+	if (last == NULL) {
+		arena->first = chunk;
+	} else {
+		last->next = chunk;
+	}
+	arena->current = chunk;
+	arena->reserved += ACGL_ARENA_CHUNK_HEADER + chunk_size;
+	arena->used += size;
+	arena->peak = SDL_max(arena->peak, arena->used);
+	return (Uint8*)chunk + ACGL_ARENA_CHUNK_HEADER;
+}
+
+void ACGL_arena_reset(ACGL_arena_t* arena) {
+	REQUIRES(arena != NULL);
+	for (ACGL_arena_chunk_t* chunk = arena->first; chunk != NULL; chunk = chunk->next) {
+		chunk->used = 0;
+	}
+	arena->current = arena->first;
+	arena->used = 0;
+}
+
+static void* __acgl_arena_allocator_alloc(size_t size, void* context) {
+	ACGL_arena_t* arena = (ACGL_arena_t*)context;
+	SDL_AtomicLock(&arena->lock);
+	void* ptr = ACGL_arena_alloc(arena, size);
+	SDL_AtomicUnlock(&arena->lock);
+	return ptr;
+}
+
+ACGL_allocator_t ACGL_arena_allocator(ACGL_arena_t* arena) {
+	REQUIRES(arena != NULL);
+	// no realloc or free, the arena only ever lets go of everything at once
+	ACGL_allocator_t allocator = {
+		__acgl_arena_allocator_alloc,
+		NULL,
+		NULL,
+		arena,
+	};
+	return allocator;
+}
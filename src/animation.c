@@ -0,0 +1,457 @@
+#include "animation.h"
+#include "alloc.h"
+#include "gui_safety.h"
+#include "contracts.h"
+#include <math.h>
+#include <string.h>
+
+float ACGL_ease_linear(float t) {
+  return t;
+}
+
+float ACGL_ease_in_quad(float t) {
+  return t * t;
+}
+
+float ACGL_ease_out_quad(float t) {
+  return t * (2.0f - t);
+}
+
+float ACGL_ease_in_out_quad(float t) {
+  return t < 0.5f ? 2.0f * t * t : -1.0f + (4.0f - 2.0f * t) * t;
+}
+
+float ACGL_ease_in_out_cubic(float t) {
+  if (t < 0.5f) {
+    return 4.0f * t * t * t;
+  }
+  float u = 2.0f * t - 2.0f;
+  return 0.5f * u * u * u + 1.0f;
+}
+
+float ACGL_ease_out_back(float t) {
+  const float c1 = 1.70158f;
+  const float c3 = c1 + 1.0f;
+  float u = t - 1.0f;
+  return 1.0f + c3 * u * u * u + c1 * u * u;
+}
+
+static ACGL_gui_pos_t* __acgl_gui_property(ACGL_gui_object_t* node, int property) {
+  switch (property) {
+    case ACGL_GUI_PROPERTY_X: return &node->x;
+    case ACGL_GUI_PROPERTY_Y: return &node->y;
+    case ACGL_GUI_PROPERTY_W: return &node->w;
+    case ACGL_GUI_PROPERTY_H: return &node->h;
+  }
+  return NULL;
+}
+
+// an empty slot in the node index, which stays at most half full
+#define ACGL_GUI_ANIMATOR_EMPTY 0xFFFFFFFFu
+
+static Uint32 __acgl_gui_animator_hash(const ACGL_gui_object_t* node) {
+  Uint64 key = (Uint64)(uintptr_t)node;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  return (Uint32)key;
+}
+
+// Returns: the index slot holding node's block, or the empty slot it would go in
+static Uint32* __acgl_gui_animator_find(ACGL_gui_animator_t* animator, const ACGL_gui_object_t* node) {
+  Uint32 mask = animator->capacity * 2 - 1;
+  for (Uint32 i = __acgl_gui_animator_hash(node) & mask;; i = (i + 1) & mask) {
+    if (animator->index[i] == ACGL_GUI_ANIMATOR_EMPTY || animator->nodes[animator->index[i]] == node) {
+      return &animator->index[i];
+    }
+  }
+}
+
+// Empties an index slot, moving later entries of its probe run back into
+// the hole so lookups never need tombstones
+static void __acgl_gui_animator_unindex(ACGL_gui_animator_t* animator, Uint32* slot) {
+  Uint32 mask = animator->capacity * 2 - 1;
+  Uint32 hole = (Uint32)(slot - animator->index);
+  for (Uint32 i = (hole + 1) & mask; animator->index[i] != ACGL_GUI_ANIMATOR_EMPTY; i = (i + 1) & mask) {
+    Uint32 home = __acgl_gui_animator_hash(animator->nodes[animator->index[i]]) & mask;
+    // only entries whose home isn't between the hole and them can move up
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      animator->index[hole] = animator->index[i];
+      hole = i;
+    }
+  }
+  animator->index[hole] = ACGL_GUI_ANIMATOR_EMPTY;
+}
+
+// Grows every array at once, so capacity is only raised if all succeed
+static bool __acgl_gui_animator_grow(ACGL_gui_animator_t* animator) {
+  Uint32 capacity = animator->capacity == 0 ? 32 : animator->capacity * 2;
+  Uint32* index = (Uint32*)ACGL_malloc(ACGL_ALLOC_ANIMATION, capacity * 2 * sizeof(Uint32));
+  if (index == NULL) {
+    return false;
+  }
+#define __ACGL_GROW(field, count) \
+  do { \
+    void* grown = ACGL_realloc(ACGL_ALLOC_ANIMATION, animator->field, (size_t)(count) * sizeof(*animator->field)); \
+    if (grown == NULL) { ACGL_free(index); return false; } \
+    animator->field = grown; \
+  } while (0)
+  __ACGL_GROW(nodes, capacity);
+  __ACGL_GROW(running, capacity);
+  __ACGL_GROW(kinds, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(values, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(from, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(to, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(velocity, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(start, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(duration, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(easing, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(stiffness, capacity * ACGL_GUI_PROPERTIES);
+  __ACGL_GROW(damping, capacity * ACGL_GUI_PROPERTIES);
+#undef __ACGL_GROW
+
+  ACGL_free(animator->index);
+  animator->index = index;
+  animator->capacity = capacity;
+  memset(index, 0xFF, capacity * 2 * sizeof(Uint32));
+  for (Uint32 block=0; block<animator->size; ++block) {
+    *__acgl_gui_animator_find(animator, animator->nodes[block]) = block;
+  }
+  return true;
+}
+
+// Drops block, moving the last one into its place
+static void __acgl_gui_animator_remove(ACGL_gui_animator_t* animator, Uint32 block) {
+  __acgl_gui_animator_unindex(animator, __acgl_gui_animator_find(animator, animator->nodes[block]));
+  Uint32 last = --animator->size;
+  if (block == last) {
+    return;
+  }
+  *__acgl_gui_animator_find(animator, animator->nodes[last]) = block;
+  animator->nodes[block] = animator->nodes[last];
+  animator->running[block] = animator->running[last];
+  Uint32 dst = block * ACGL_GUI_PROPERTIES;
+  Uint32 src = last * ACGL_GUI_PROPERTIES;
+#define __ACGL_MOVE(field) memcpy(&animator->field[dst], &animator->field[src], ACGL_GUI_PROPERTIES * sizeof(*animator->field))
+  __ACGL_MOVE(kinds);
+  __ACGL_MOVE(values);
+  __ACGL_MOVE(from);
+  __ACGL_MOVE(to);
+  __ACGL_MOVE(velocity);
+  __ACGL_MOVE(start);
+  __ACGL_MOVE(duration);
+  __ACGL_MOVE(easing);
+  __ACGL_MOVE(stiffness);
+  __ACGL_MOVE(damping);
+#undef __ACGL_MOVE
+}
+
+ACGL_gui_animator_t* ACGL_gui_animator_create(void) {
+  ACGL_gui_animator_t* animator = (ACGL_gui_animator_t*)ACGL_calloc(ACGL_ALLOC_ANIMATION, 1, sizeof(ACGL_gui_animator_t));
+  if (animator == NULL) {
+    fprintf(stderr, "Error! Could not malloc animator in ACGL_gui_animator_create\n");
+    return NULL;
+  }
+  if (!ACGL_MUTEX_CREATE(animator->mutex)) {
+    fprintf(stderr, "Could not create mutex in ACGL_gui_animator_create! SDL Error: %s\n", SDL_GetError());
+    ACGL_free(animator);
+    return NULL;
+  }
+  if (!__acgl_gui_animator_grow(animator)) {
+    fprintf(stderr, "Error! Could not malloc animations in ACGL_gui_animator_create\n");
+    ACGL_gui_animator_destroy(animator);
+    return NULL;
+  }
+  return animator;
+}
+
+void ACGL_gui_animator_destroy(ACGL_gui_animator_t* animator) {
+  if (animator != NULL) {
+    ACGL_MUTEX_DESTROY(animator->mutex);
+    ACGL_free(animator->nodes);
+    ACGL_free(animator->running);
+    ACGL_free(animator->index);
+    ACGL_free(animator->kinds);
+    ACGL_free(animator->values);
+    ACGL_free(animator->from);
+    ACGL_free(animator->to);
+    ACGL_free(animator->velocity);
+    ACGL_free(animator->start);
+    ACGL_free(animator->duration);
+    ACGL_free(animator->easing);
+    ACGL_free(animator->stiffness);
+    ACGL_free(animator->damping);
+    ACGL_free(animator->writes);
+    ACGL_free(animator);
+  }
+}
+
+// Finds the running animation for node's property, or makes a new one.
+// Call with the animator locked. Returns: its index, -1 if out of memory
+static int __acgl_gui_animator_slot(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node, int property, bool* existing) {
+  Uint32* slot = __acgl_gui_animator_find(animator, node);
+  if (*slot == ACGL_GUI_ANIMATOR_EMPTY) {
+    if (animator->size == animator->capacity) {
+      if (!__acgl_gui_animator_grow(animator)) {
+        return -1;
+      }
+      slot = __acgl_gui_animator_find(animator, node);
+    }
+    *slot = animator->size++;
+    animator->nodes[*slot] = node;
+    animator->running[*slot] = 0;
+  }
+
+  Uint32 block = *slot;
+  Uint32 index = block * ACGL_GUI_PROPERTIES + (Uint32)property;
+  *existing = (animator->running[block] >> property) & 1;
+  if (!*existing) {
+    animator->running[block] |= (Uint8)(1 << property);
+    animator->velocity[index] = 0;
+  }
+  return (int)index;
+}
+
+// Returns: the property's current value, read under the node's lock
+static bool __acgl_gui_animator_read(ACGL_gui_object_t* node, int property, ACGL_gui_pos_t* value, const char* caller) {
+  if (__acgl_gui_property(node, property) == NULL) {
+    fprintf(stderr, "Error! Unknown property %d in %s\n", property, caller);
+    return false;
+  }
+  if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+    fprintf(stderr, "Could not lock node mutex in %s. SDL_Error: %s\n", caller, SDL_GetError());
+    return false;
+  }
+  *value = *__acgl_gui_property(node, property);
+  ACGL_MUTEX_UNLOCK(node->mutex);
+  return true;
+}
+
+int ACGL_gui_animate(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node, int property, ACGL_gui_pos_t to, Uint64 duration_ns, ACGL_easing_t easing) {
+  REQUIRES(animator != NULL);
+  REQUIRES(__ACGL_is_gui_object_t(node));
+
+  ACGL_gui_pos_t current;
+  if (!__acgl_gui_animator_read(node, property, &current, "ACGL_gui_animate")) {
+    return -1;
+  }
+  if (ACGL_MUTEX_LOCK(animator->mutex) != 0) {
+    fprintf(stderr, "Could not lock animator mutex in ACGL_gui_animate. SDL_Error: %s\n", SDL_GetError());
+    return -1;
+  }
+
+  bool existing;
+  int index = __acgl_gui_animator_slot(animator, node, property, &existing);
+  if (index < 0) {
+    fprintf(stderr, "Error! Could not grow animations in ACGL_gui_animate\n");
+    ACGL_MUTEX_UNLOCK(animator->mutex);
+    return -1;
+  }
+  if (existing) {
+    // carry on from wherever the old animation got to
+    current = animator->values[index];
+  }
+  animator->kinds[index] = ACGL_GUI_ANIMATION_TWEEN;
+  animator->values[index] = current;
+  animator->from[index] = current;
+  animator->to[index] = to;
+  animator->start[index] = ACGL_clock_now();
+  animator->duration[index] = duration_ns;
+  animator->easing[index] = easing != NULL ? easing : ACGL_ease_linear;
+
+  ACGL_MUTEX_UNLOCK(animator->mutex);
+  return 0;
+}
+
+int ACGL_gui_animate_spring(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node, int property, ACGL_gui_pos_t to, float stiffness, float damping) {
+  REQUIRES(animator != NULL);
+  REQUIRES(__ACGL_is_gui_object_t(node));
+  REQUIRES(stiffness > 0 && damping >= 0);
+
+  ACGL_gui_pos_t current;
+  if (!__acgl_gui_animator_read(node, property, &current, "ACGL_gui_animate_spring")) {
+    return -1;
+  }
+  if (ACGL_MUTEX_LOCK(animator->mutex) != 0) {
+    fprintf(stderr, "Could not lock animator mutex in ACGL_gui_animate_spring. SDL_Error: %s\n", SDL_GetError());
+    return -1;
+  }
+
+  bool existing;
+  int index = __acgl_gui_animator_slot(animator, node, property, &existing);
+  if (index < 0) {
+    fprintf(stderr, "Error! Could not grow animations in ACGL_gui_animate_spring\n");
+    ACGL_MUTEX_UNLOCK(animator->mutex);
+    return -1;
+  }
+  if (existing) {
+    current = animator->values[index];
+    if (animator->kinds[index] != ACGL_GUI_ANIMATION_SPRING) {
+      animator->velocity[index] = 0;
+    }
+  }
+  animator->kinds[index] = ACGL_GUI_ANIMATION_SPRING;
+  animator->values[index] = current;
+  animator->from[index] = SDL_max(fabsf(to - current), 1e-3f);
+  animator->to[index] = to;
+  animator->start[index] = ACGL_clock_now();
+  animator->stiffness[index] = stiffness;
+  animator->damping[index] = damping;
+
+  ACGL_MUTEX_UNLOCK(animator->mutex);
+  return 0;
+}
+
+void ACGL_gui_animator_cancel(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node) {
+  REQUIRES(animator != NULL);
+
+  ACGL_MUTEX_LOCK(animator->mutex);
+  Uint32* slot = __acgl_gui_animator_find(animator, node);
+  if (*slot != ACGL_GUI_ANIMATOR_EMPTY) {
+    __acgl_gui_animator_remove(animator, *slot);
+  }
+  ACGL_MUTEX_UNLOCK(animator->mutex);
+}
+
+bool ACGL_gui_animator_is_animating(ACGL_gui_animator_t* animator, ACGL_gui_object_t* node) {
+  REQUIRES(animator != NULL);
+
+  ACGL_MUTEX_LOCK(animator->mutex);
+  bool found = *__acgl_gui_animator_find(animator, node) != ACGL_GUI_ANIMATOR_EMPTY;
+  ACGL_MUTEX_UNLOCK(animator->mutex);
+  return found;
+}
+
+// Returns: true once the spring has come to rest
+static bool __acgl_gui_animator_spring(ACGL_gui_animator_t* animator, Uint32 i, Uint64 now) {
+  Uint64 elapsed = now > animator->start[i] ? now - animator->start[i] : 0;
+  // don't try to simulate the whole time we were in the background
+  if (elapsed > 100 * ACGL_CLOCK_NS_PER_MS) {
+    elapsed = 100 * ACGL_CLOCK_NS_PER_MS;
+  }
+  animator->start[i] = now;
+
+  float x = animator->values[i];
+  float v = animator->velocity[i];
+  float to = animator->to[i];
+  while (elapsed > 0) {
+    Uint64 step = SDL_min(elapsed, (Uint64)ACGL_GUI_SPRING_STEP);
+    float dt = (float)step / (float)ACGL_CLOCK_NS_PER_S;
+    // semi-implicit Euler, stable for the step sizes we use
+    v += (animator->stiffness[i] * (to - x) - animator->damping[i] * v) * dt;
+    x += v * dt;
+    elapsed -= step;
+  }
+
+  float rest = ACGL_GUI_SPRING_REST * animator->from[i];
+  if (fabsf(to - x) <= rest && fabsf(v) <= rest) {
+    animator->values[i] = to;
+    animator->velocity[i] = 0;
+    return true;
+  }
+  animator->values[i] = x;
+  animator->velocity[i] = v;
+  return false;
+}
+
+Uint32 ACGL_gui_animator_advance(ACGL_gui_animator_t* animator, Uint64 now) {
+  REQUIRES(animator != NULL);
+
+  if (ACGL_MUTEX_LOCK(animator->mutex) != 0) {
+    fprintf(stderr, "Could not lock animator mutex in ACGL_gui_animator_advance. SDL_Error: %s\n", SDL_GetError());
+    return 0;
+  }
+
+  // only advance resizes writes, so it stays put while the nodes are written below
+  if (animator->writes_capacity < animator->size * ACGL_GUI_PROPERTIES) {
+    Uint32 capacity = animator->capacity * ACGL_GUI_PROPERTIES;
+    ACGL_gui_animation_write_t* writes = (ACGL_gui_animation_write_t*)ACGL_realloc(ACGL_ALLOC_ANIMATION, animator->writes, capacity * sizeof(ACGL_gui_animation_write_t));
+    if (writes == NULL) {
+      fprintf(stderr, "Error! Could not grow writes in ACGL_gui_animator_advance\n");
+      ACGL_MUTEX_UNLOCK(animator->mutex);
+      return animator->size;
+    }
+    animator->writes = writes;
+    animator->writes_capacity = capacity;
+  }
+
+  // step every animation, swapping out the nodes whose animations all finished
+  Uint32 writes_size = 0;
+  Uint32 kept = 0;
+  Uint32 block = 0;
+  while (block < animator->size) {
+    Uint8 running = animator->running[block];
+    for (int property=0; property<ACGL_GUI_PROPERTIES; ++property) {
+      if (!((running >> property) & 1)) {
+        continue;
+      }
+      Uint32 i = block * ACGL_GUI_PROPERTIES + (Uint32)property;
+      bool done;
+      if (animator->kinds[i] == ACGL_GUI_ANIMATION_SPRING) {
+        done = __acgl_gui_animator_spring(animator, i, now);
+      } else {
+        Uint64 elapsed = now > animator->start[i] ? now - animator->start[i] : 0;
+        done = elapsed >= animator->duration[i];
+        if (done) {
+          animator->values[i] = animator->to[i];
+        } else {
+          float t = (float)elapsed / (float)animator->duration[i];
+          float eased = (*animator->easing[i])(t);
+          animator->values[i] = animator->from[i] + (animator->to[i] - animator->from[i]) * eased;
+        }
+      }
+
+      ACGL_gui_animation_write_t* write = &animator->writes[writes_size++];
+      write->node = animator->nodes[block];
+      write->property = (Uint8)property;
+      write->value = animator->values[i];
+
+      if (done) {
+        running &= (Uint8)~(1 << property);
+      } else {
+        ++kept;
+      }
+    }
+
+    animator->running[block] = running;
+    if (running == 0) {
+      // the last block moves in here and is stepped next
+      __acgl_gui_animator_remove(animator, block);
+    } else {
+      ++block;
+    }
+  }
+
+  // nodes are locked after letting go of the animator, so a thread holding
+  // a node's lock can still start animations
+  ACGL_MUTEX_UNLOCK(animator->mutex);
+
+  ACGL_gui_object_t* locked = NULL;
+  ACGL_gui_t* requested = NULL;
+  for (Uint32 i=0; i<writes_size; ++i) {
+    ACGL_gui_animation_write_t* write = &animator->writes[i];
+    if (write->node != locked) {
+      if (locked != NULL) {
+        ACGL_MUTEX_UNLOCK(locked->mutex);
+        locked = NULL;
+      }
+      if (ACGL_MUTEX_LOCK(write->node->mutex) != 0) {
+        fprintf(stderr, "Could not lock node mutex in ACGL_gui_animator_advance. SDL_Error: %s\n", SDL_GetError());
+        continue;
+      }
+      locked = write->node;
+    }
+    *__acgl_gui_property(write->node, write->property) = write->value;
+    write->node->needs_layout = true;
+    // an animator's nodes are nearly always in one gui
+    if (write->node->gui != requested) {
+      requested = write->node->gui;
+      ACGL_gui_request_render(requested);
+    }
+  }
+  if (locked != NULL) {
+    ACGL_MUTEX_UNLOCK(locked->mutex);
+  }
+
+  return kept;
+}
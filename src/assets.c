@@ -0,0 +1,179 @@
+#include "assets.h"
+#include "alloc.h"
+#include "contracts.h"
+#include <string.h>
+
+// FNV-1a
+static Uint32 __acgl_asset_hash(const char* name) {
+	Uint32 hash = 2166136261u;
+	for (; *name != '\0'; ++name) {
+		hash = (hash ^ (Uint8)*name) * 16777619u;
+	}
+	return hash;
+}
+
+// Returns: the entry for name, or the empty slot it would go in
+static ACGL_asset_entry_t* __acgl_asset_find(ACGL_asset_entry_t* entries, Uint32 capacity, const char* name, Uint32 hash) {
+	Uint32 mask = capacity - 1;
+	for (Uint32 i = hash & mask;; i = (i + 1) & mask) {
+		ACGL_asset_entry_t* entry = &entries[i];
+		if (entry->name == NULL || (entry->hash == hash && strcmp(entry->name, name) == 0)) {
+			return entry;
+		}
+	}
+}
+
+// Moves every entry into a table of capacity slots, unloading the unheld
+// ones first when trim is set. Returns: false if out of memory, with nothing changed
+static bool __acgl_asset_rehash(ACGL_asset_cache_t* cache, Uint32 capacity, bool trim) {
+	ACGL_asset_entry_t* entries = (ACGL_asset_entry_t*)ACGL_calloc(ACGL_ALLOC_GUI, capacity, sizeof(ACGL_asset_entry_t));
+	if (entries == NULL) {
+		return false;
+	}
+	for (Uint32 i = 0; i < cache->capacity; ++i) {
+		ACGL_asset_entry_t* entry = &cache->entries[i];
+		if (entry->name == NULL) {
+			continue;
+		}
+		if (trim && entry->refs == 0) {
+			if (cache->unload != NULL) {
+				(*cache->unload)(entry->value);
+			}
+			ACGL_free(entry->name);
+			--cache->size;
+			continue;
+		}
+		*__acgl_asset_find(entries, capacity, entry->name, entry->hash) = *entry;
+	}
+	ACGL_free(cache->entries);
+	cache->entries = entries;
+	cache->capacity = capacity;
+	return true;
+}
+
+ACGL_asset_cache_t* ACGL_asset_cache_create(ACGL_asset_loader_t load, ACGL_destroy_callback_t unload, void* context) {
+	REQUIRES(load != NULL);
+
+	ACGL_asset_cache_t* cache = (ACGL_asset_cache_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_asset_cache_t));
+	if (cache == NULL) {
+		fprintf(stderr, "Error! could not malloc cache in ACGL_asset_cache_create\n");
+		return NULL;
+	}
+	cache->load = load;
+	cache->unload = unload;
+	cache->context = context;
+	cache->size = 0;
+	cache->capacity = 32;
+	cache->entries = (ACGL_asset_entry_t*)ACGL_calloc(ACGL_ALLOC_GUI, cache->capacity, sizeof(ACGL_asset_entry_t));
+	if (cache->entries == NULL) {
+		fprintf(stderr, "Error! could not malloc entries in ACGL_asset_cache_create\n");
+		ACGL_free(cache);
+		return NULL;
+	}
+	if (!ACGL_MUTEX_CREATE(cache->mutex)) {
+		fprintf(stderr, "Could not create mutex in ACGL_asset_cache_create! SDL Error: %s\n", SDL_GetError());
+		ACGL_free(cache->entries);
+		ACGL_free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+void ACGL_asset_cache_destroy(ACGL_asset_cache_t* cache) {
+	if (cache == NULL) {
+		return;
+	}
+	for (Uint32 i = 0; i < cache->capacity; ++i) {
+		ACGL_asset_entry_t* entry = &cache->entries[i];
+		if (entry->name != NULL) {
+			if (cache->unload != NULL) {
+				(*cache->unload)(entry->value);
+			}
+			ACGL_free(entry->name);
+		}
+	}
+	ACGL_MUTEX_DESTROY(cache->mutex);
+	ACGL_free(cache->entries);
+	ACGL_free(cache);
+}
+
+void* ACGL_asset_acquire(ACGL_asset_cache_t* cache, const char* name) {
+	REQUIRES(cache != NULL);
+	REQUIRES(name != NULL);
+
+	if (ACGL_MUTEX_LOCK(cache->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_asset_acquire. SDL_Error: %s\n", SDL_GetError());
+		return NULL;
+	}
+	Uint32 hash = __acgl_asset_hash(name);
+	ACGL_asset_entry_t* entry = __acgl_asset_find(cache->entries, cache->capacity, name, hash);
+	if (entry->name == NULL) {
+		if ((cache->size + 1) * 2 > cache->capacity) {
+			if (!__acgl_asset_rehash(cache, cache->capacity * 2, false)) {
+				fprintf(stderr, "Error! could not grow cache in ACGL_asset_acquire\n");
+				ACGL_MUTEX_UNLOCK(cache->mutex);
+				return NULL;
+			}
+			entry = __acgl_asset_find(cache->entries, cache->capacity, name, hash);
+		}
+		size_t length = strlen(name);
+		char* copy = (char*)ACGL_malloc(ACGL_ALLOC_GUI, length + 1);
+		if (copy == NULL) {
+			fprintf(stderr, "Error! could not malloc name in ACGL_asset_acquire\n");
+			ACGL_MUTEX_UNLOCK(cache->mutex);
+			return NULL;
+		}
+		void* value = (*cache->load)(name, cache->context);
+		if (value == NULL) {
+			fprintf(stderr, "Error! could not load asset \"%s\" in ACGL_asset_acquire\n", name);
+			ACGL_free(copy);
+			ACGL_MUTEX_UNLOCK(cache->mutex);
+			return NULL;
+		}
+		memcpy(copy, name, length + 1);
+		entry->name = copy;
+		entry->hash = hash;
+		entry->value = value;
+		entry->refs = 0;
+		++cache->size;
+	}
+	++entry->refs;
+	void* value = entry->value;
+	ACGL_MUTEX_UNLOCK(cache->mutex);
+	return value;
+}
+
+void ACGL_asset_release(ACGL_asset_cache_t* cache, const char* name) {
+	REQUIRES(cache != NULL);
+	REQUIRES(name != NULL);
+
+	if (ACGL_MUTEX_LOCK(cache->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_asset_release. SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+	ACGL_asset_entry_t* entry = __acgl_asset_find(cache->entries, cache->capacity, name, __acgl_asset_hash(name));
+	if (entry->name == NULL || entry->refs == 0) {
+		fprintf(stderr, "Error! asset \"%s\" is not held in ACGL_asset_release\n", name);
+	} else {
+		--entry->refs;
+	}
+	ACGL_MUTEX_UNLOCK(cache->mutex);
+}
+
+size_t ACGL_asset_cache_trim(ACGL_asset_cache_t* cache) {
+	REQUIRES(cache != NULL);
+
+	if (ACGL_MUTEX_LOCK(cache->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_asset_cache_trim. SDL_Error: %s\n", SDL_GetError());
+		return 0;
+	}
+	// emptying slots in place would break probe chains, so the survivors
+	// move to a fresh table
+	Uint32 size = cache->size;
+	if (!__acgl_asset_rehash(cache, cache->capacity, true)) {
+		fprintf(stderr, "Error! could not rebuild cache in ACGL_asset_cache_trim\n");
+	}
+	size_t unloaded = size - cache->size;
+	ACGL_MUTEX_UNLOCK(cache->mutex);
+	return unloaded;
+}
@@ -0,0 +1,269 @@
+#include "channel.h"
+#include "alloc.h"
+#include "clock.h"
+
+// Copies count items into the ring starting at position pos, wrapping around the end
+static void __acgl_channel_write(ACGL_channel_t* channel, Uint32 pos, const Uint8* items, Uint32 count) {
+	Uint32 start = pos & channel->mask;
+	Uint32 first = SDL_min(count, channel->capacity - start);
+	memcpy(channel->slots + (size_t)start * channel->elem_size, items, (size_t)first * channel->elem_size);
+	memcpy(channel->slots, items + (size_t)first * channel->elem_size, (size_t)(count - first) * channel->elem_size);
+}
+
+static void __acgl_channel_read(ACGL_channel_t* channel, Uint32 pos, Uint8* items, Uint32 count) {
+	Uint32 start = pos & channel->mask;
+	Uint32 first = SDL_min(count, channel->capacity - start);
+	memcpy(items, channel->slots + (size_t)start * channel->elem_size, (size_t)first * channel->elem_size);
+	memcpy(items + (size_t)first * channel->elem_size, channel->slots, (size_t)(count - first) * channel->elem_size);
+}
+
+// Wakes anyone who could make progress now that count items were sent
+static void __acgl_channel_sent(ACGL_channel_t* channel) {
+	if (SDL_AtomicGet(&channel->recv_waiting) && SDL_AtomicCAS(&channel->recv_waiting, 1, 0)) {
+		SDL_SemPost(channel->readable);
+	}
+	if (channel->wake_event != 0 && SDL_AtomicCAS(&channel->notified, 0, 1)) {
+		SDL_Event event;
+		SDL_zero(event);
+		event.type = channel->wake_event;
+		event.user.data1 = channel;
+		SDL_PushEvent(&event);
+	}
+}
+
+static void __acgl_channel_received(ACGL_channel_t* channel) {
+	int senders = SDL_AtomicGet(&channel->send_waiting);
+	for (int i=0; i<senders; ++i) {
+		SDL_SemPost(channel->writable);
+	}
+	if (channel->wake_event != 0 && ACGL_channel_is_empty(channel)) {
+		// re-arm, then make sure nothing slipped in between the check and the reset
+		SDL_AtomicSet(&channel->notified, 0);
+		if (!ACGL_channel_is_empty(channel)) {
+			__acgl_channel_sent(channel);
+		}
+	}
+}
+
+ACGL_channel_t* ACGL_channel_create(int kind, size_t elem_size, Uint32 capacity) {
+	if (kind != ACGL_CHANNEL_SPSC && kind != ACGL_CHANNEL_MPSC) {
+		fprintf(stderr, "Error! unknown channel kind %d in ACGL_channel_create\n", kind);
+		return NULL;
+	}
+	if (elem_size == 0 || capacity == 0 || capacity > (1u << 30)) {
+		fprintf(stderr, "Error! invalid element size or capacity in ACGL_channel_create\n");
+		return NULL;
+	}
+
+	ACGL_channel_t* channel = (ACGL_channel_t*)ACGL_malloc(ACGL_ALLOC_CHANNEL, sizeof(ACGL_channel_t));
+	if (channel == NULL) {
+		fprintf(stderr, "Error! could not malloc channel in ACGL_channel_create\n");
+		return NULL;
+	}
+
+	Uint32 rounded = 1;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	channel->kind = kind;
+	channel->elem_size = elem_size;
+	channel->capacity = rounded;
+	channel->mask = rounded - 1;
+	channel->wake_event = 0;
+	SDL_AtomicSet(&channel->tail, 0);
+	SDL_AtomicSet(&channel->send_waiting, 0);
+	SDL_AtomicSet(&channel->head, 0);
+	SDL_AtomicSet(&channel->recv_waiting, 0);
+	SDL_AtomicSet(&channel->notified, 0);
+
+	channel->slots = (Uint8*)ACGL_malloc(ACGL_ALLOC_CHANNEL, (size_t)rounded * elem_size);
+	channel->published = NULL;
+	if (kind == ACGL_CHANNEL_MPSC) {
+		channel->published = (SDL_atomic_t*)ACGL_malloc(ACGL_ALLOC_CHANNEL, (size_t)rounded * sizeof(SDL_atomic_t));
+	}
+	channel->readable = SDL_CreateSemaphore(0);
+	channel->writable = SDL_CreateSemaphore(0);
+	if (
+		channel->slots == NULL ||
+		(kind == ACGL_CHANNEL_MPSC && channel->published == NULL) ||
+		channel->readable == NULL ||
+		channel->writable == NULL
+		) {
+		fprintf(stderr, "Error! could not allocate channel storage in ACGL_channel_create\n");
+		ACGL_channel_destroy(channel);
+		return NULL;
+	}
+	if (channel->published != NULL) {
+		for (Uint32 i=0; i<rounded; ++i) {
+			// nothing published yet, position i would need the value i + 1
+			SDL_AtomicSet(&channel->published[i], (int)i);
+		}
+	}
+
+	return channel;
+}
+
+void ACGL_channel_destroy(ACGL_channel_t* channel) {
+	if (channel == NULL) {
+		fprintf(stderr, "Error! cannot destroy NULL channel in ACGL_channel_destroy\n");
+		return;
+	}
+	ACGL_free(channel->slots);
+	channel->slots = NULL;
+	ACGL_free(channel->published);
+	channel->published = NULL;
+	if (channel->readable != NULL) {
+		SDL_DestroySemaphore(channel->readable);
+		channel->readable = NULL;
+	}
+	if (channel->writable != NULL) {
+		SDL_DestroySemaphore(channel->writable);
+		channel->writable = NULL;
+	}
+	ACGL_free(channel);
+}
+
+size_t ACGL_channel_send(ACGL_channel_t* channel, const void* items, size_t count) {
+	REQUIRES(channel != NULL);
+	REQUIRES(items != NULL || count == 0);
+
+	Uint32 pos, n;
+	if (channel->kind == ACGL_CHANNEL_SPSC) {
+		// we are the only writer of tail
+		pos = (Uint32)SDL_AtomicGet(&channel->tail);
+		Uint32 space = channel->capacity - (pos - (Uint32)SDL_AtomicGet(&channel->head));
+		n = (Uint32)SDL_min((size_t)space, count);
+		if (n == 0) {
+			return 0;
+		}
+		__acgl_channel_write(channel, pos, (const Uint8*)items, n);
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&channel->tail, (int)(pos + n));
+	} else {
+		// claim n slots at once. head only moves after the receiver is done
+		// with a slot, so anything below head + capacity is free to overwrite
+		do {
+			pos = (Uint32)SDL_AtomicGet(&channel->tail);
+			Uint32 space = channel->capacity - (pos - (Uint32)SDL_AtomicGet(&channel->head));
+			if ((Sint32)space <= 0) {
+				return 0;
+			}
+			n = (Uint32)SDL_min((size_t)space, count);
+			if (n == 0) {
+				return 0;
+			}
+		} while (!SDL_AtomicCAS(&channel->tail, (int)pos, (int)(pos + n)));
+
+		__acgl_channel_write(channel, pos, (const Uint8*)items, n);
+		SDL_MemoryBarrierRelease();
+		// other senders may finish out of order, so every slot is published on its own
+		for (Uint32 i=0; i<n; ++i) {
+			SDL_AtomicSet(&channel->published[(pos + i) & channel->mask], (int)(pos + i + 1));
+		}
+	}
+
+	__acgl_channel_sent(channel);
+	return n;
+}
+
+size_t ACGL_channel_recv(ACGL_channel_t* channel, void* items, size_t max) {
+	REQUIRES(channel != NULL);
+	REQUIRES(items != NULL || max == 0);
+
+	// we are the only writer of head
+	Uint32 pos = (Uint32)SDL_AtomicGet(&channel->head);
+	Uint32 available = (Uint32)SDL_AtomicGet(&channel->tail) - pos;
+	Uint32 n = (Uint32)SDL_min((size_t)available, max);
+	if (channel->kind == ACGL_CHANNEL_MPSC) {
+		// tail counts claimed slots, stop at the first one not written yet
+		for (Uint32 i=0; i<n; ++i) {
+			if ((Uint32)SDL_AtomicGet(&channel->published[(pos + i) & channel->mask]) != pos + i + 1) {
+				n = i;
+				break;
+			}
+		}
+	}
+	if (n == 0) {
+		return 0;
+	}
+
+	SDL_MemoryBarrierAcquire();
+	__acgl_channel_read(channel, pos, (Uint8*)items, n);
+	SDL_AtomicSet(&channel->head, (int)(pos + n));
+
+	__acgl_channel_received(channel);
+	return n;
+}
+
+size_t ACGL_channel_send_wait(ACGL_channel_t* channel, const void* items, size_t count, Uint32 timeout_ms) {
+	REQUIRES(channel != NULL);
+
+	Uint64 deadline = ACGL_clock_now() + (Uint64)timeout_ms * ACGL_CLOCK_NS_PER_MS;
+	size_t sent = ACGL_channel_send(channel, items, count);
+	while (sent < count) {
+		// announce ourselves before the last check, so a receiver that empties
+		// the channel after it is guaranteed to see us and post
+		SDL_AtomicAdd(&channel->send_waiting, 1);
+		size_t more = ACGL_channel_send(channel, (const Uint8*)items + sent * channel->elem_size, count - sent);
+		if (more == 0) {
+			Uint32 wait = SDL_MUTEX_MAXWAIT;
+			if (timeout_ms != SDL_MUTEX_MAXWAIT) {
+				Uint64 now = ACGL_clock_now();
+				wait = now >= deadline ? 0 : (Uint32)((deadline - now + ACGL_CLOCK_NS_PER_MS - 1) / ACGL_CLOCK_NS_PER_MS);
+			}
+			if (wait == 0 || SDL_SemWaitTimeout(channel->writable, wait) != 0) {
+				SDL_AtomicAdd(&channel->send_waiting, -1);
+				break;
+			}
+		}
+		SDL_AtomicAdd(&channel->send_waiting, -1);
+		sent += more;
+	}
+	return sent;
+}
+
+size_t ACGL_channel_recv_wait(ACGL_channel_t* channel, void* items, size_t max, Uint32 timeout_ms) {
+	REQUIRES(channel != NULL);
+
+	Uint64 deadline = ACGL_clock_now() + (Uint64)timeout_ms * ACGL_CLOCK_NS_PER_MS;
+	size_t received = ACGL_channel_recv(channel, items, max);
+	while (received == 0 && max > 0) {
+		SDL_AtomicSet(&channel->recv_waiting, 1);
+		received = ACGL_channel_recv(channel, items, max);
+		if (received != 0) {
+			SDL_AtomicSet(&channel->recv_waiting, 0);
+			break;
+		}
+		Uint32 wait = SDL_MUTEX_MAXWAIT;
+		if (timeout_ms != SDL_MUTEX_MAXWAIT) {
+			Uint64 now = ACGL_clock_now();
+			wait = now >= deadline ? 0 : (Uint32)((deadline - now + ACGL_CLOCK_NS_PER_MS - 1) / ACGL_CLOCK_NS_PER_MS);
+		}
+		if (wait == 0 || SDL_SemWaitTimeout(channel->readable, wait) != 0) {
+			SDL_AtomicSet(&channel->recv_waiting, 0);
+			received = ACGL_channel_recv(channel, items, max);
+			break;
+		}
+		received = ACGL_channel_recv(channel, items, max);
+	}
+	return received;
+}
+
+Uint32 ACGL_channel_size(ACGL_channel_t* channel) {
+	REQUIRES(channel != NULL);
+	Uint32 head = (Uint32)SDL_AtomicGet(&channel->head);
+	return (Uint32)SDL_AtomicGet(&channel->tail) - head;
+}
+
+bool ACGL_channel_is_empty(ACGL_channel_t* channel) {
+	return ACGL_channel_size(channel) == 0;
+}
+
+void ACGL_channel_set_wake_event(ACGL_channel_t* channel, Uint32 event_type) {
+	REQUIRES(channel != NULL);
+	channel->wake_event = event_type;
+	SDL_AtomicSet(&channel->notified, 0);
+	if (event_type != 0 && !ACGL_channel_is_empty(channel)) {
+		__acgl_channel_sent(channel);
+	}
+}
@@ -0,0 +1,27 @@
+#include "clock.h"
+
+Uint64 ACGL_clock_from_counter(Uint64 counter) {
+	// Not cached: it's a constant lookup in SDL and caching it in a global
+	// would be a data race between threads
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	// Split up the multiplication so counter * 10^9 can't overflow
+	Uint64 seconds = counter / frequency;
+	Uint64 rest = counter % frequency;
+	return seconds * ACGL_CLOCK_NS_PER_S + rest * ACGL_CLOCK_NS_PER_S / frequency;
+}
+
+Uint64 ACGL_clock_now(void) {
+	return ACGL_clock_from_counter(SDL_GetPerformanceCounter());
+}
+
+void ACGL_clock_sleep_until(Uint64 deadline, Uint64 spin) {
+	Uint64 now = ACGL_clock_now();
+	while (now < deadline) {
+		Uint64 remaining = deadline - now;
+		if (remaining > spin + ACGL_CLOCK_NS_PER_MS) {
+			// SDL_Delay may oversleep, so only ask for the part outside the spin window
+			SDL_Delay((Uint32)((remaining - spin) / ACGL_CLOCK_NS_PER_MS));
+		}
+		now = ACGL_clock_now();
+	}
+}
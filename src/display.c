@@ -0,0 +1,219 @@
+#include "display.h"
+#include "alloc.h"
+#include "contracts.h"
+#include <string.h>
+
+ACGL_display_t* ACGL_display_create(SDL_GLContext context, ACGL_ih_keybinds_t* keybinds, ACGL_asset_cache_t* assets) {
+	ACGL_display_t* display = (ACGL_display_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_display_t));
+	if (display == NULL) {
+		fprintf(stderr, "Error! could not malloc display in ACGL_display_create\n");
+		return NULL;
+	}
+	display->context = context;
+	display->windows = NULL;
+	display->windows_size = 0;
+	display->windows_capacity = 0;
+	display->current = NULL;
+	display->vsync = 1;
+	display->swap_interval = -1;
+	display->keybinds = keybinds;
+	display->assets = assets;
+	return display;
+}
+
+void ACGL_display_destroy(ACGL_display_t* display) {
+	if (display == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < display->windows_size; ++i) {
+		ACGL_gui_destroy(display->windows[i].gui);
+	}
+	ACGL_free(display->windows);
+	ACGL_asset_cache_destroy(display->assets);
+	ACGL_free(display);
+}
+
+static ACGL_display_window_t* __acgl_display_find(ACGL_display_t* display, Uint32 window_id) {
+	// a handful of monitors, a scan beats hashing
+	for (size_t i = 0; i < display->windows_size; ++i) {
+		if (display->windows[i].id == window_id) {
+			return &display->windows[i];
+		}
+	}
+	return NULL;
+}
+
+ACGL_gui_t* ACGL_display_add_window(ACGL_display_t* display, SDL_Window* window, ACGL_ih_eventdata_t* medata) {
+	REQUIRES(display != NULL);
+	REQUIRES(window != NULL);
+
+	Uint32 id = SDL_GetWindowID(window);
+	if (__acgl_display_find(display, id) != NULL) {
+		fprintf(stderr, "Error! window %u was already added in ACGL_display_add_window\n", id);
+		return NULL;
+	}
+	if (display->windows_size == display->windows_capacity) {
+		size_t capacity = display->windows_capacity > 0 ? display->windows_capacity * 2 : 4;
+		ACGL_display_window_t* windows = (ACGL_display_window_t*)ACGL_realloc(ACGL_ALLOC_GUI, display->windows, capacity * sizeof(ACGL_display_window_t));
+		if (windows == NULL) {
+			fprintf(stderr, "Error! could not grow windows in ACGL_display_add_window\n");
+			return NULL;
+		}
+		display->windows = windows;
+		display->windows_capacity = capacity;
+	}
+	ACGL_gui_t* gui = ACGL_gui_init(window);
+	if (gui == NULL) {
+		return NULL;
+	}
+
+	ACGL_display_window_t* entry = &display->windows[display->windows_size++];
+	entry->window = window;
+	entry->id = id;
+	entry->gui = gui;
+	entry->medata = medata;
+	entry->visible = !(SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED));
+	entry->present = false;
+	return gui;
+}
+
+void ACGL_display_remove_window(ACGL_display_t* display, SDL_Window* window) {
+	REQUIRES(display != NULL);
+
+	ACGL_display_window_t* entry = __acgl_display_find(display, SDL_GetWindowID(window));
+	if (entry == NULL) {
+		fprintf(stderr, "Error! window was never added in ACGL_display_remove_window\n");
+		return;
+	}
+	ACGL_gui_destroy(entry->gui);
+	if (display->current == window) {
+		display->current = NULL;
+	}
+	size_t index = (size_t)(entry - display->windows);
+	memmove(entry, entry + 1, (display->windows_size - index - 1) * sizeof(ACGL_display_window_t));
+	--display->windows_size;
+}
+
+ACGL_gui_t* ACGL_display_find(ACGL_display_t* display, Uint32 window_id) {
+	REQUIRES(display != NULL);
+	ACGL_display_window_t* entry = __acgl_display_find(display, window_id);
+	return entry != NULL ? entry->gui : NULL;
+}
+
+bool ACGL_display_handle_event(ACGL_display_t* display, const SDL_Event* event) {
+	REQUIRES(display != NULL);
+	REQUIRES(event != NULL);
+
+	ACGL_display_window_t* entry;
+	switch (event->type) {
+	case SDL_WINDOWEVENT:
+		entry = __acgl_display_find(display, event->window.windowID);
+		if (entry == NULL) {
+			return false;
+		}
+		switch (event->window.event) {
+		case SDL_WINDOWEVENT_HIDDEN:
+		case SDL_WINDOWEVENT_MINIMIZED:
+			entry->visible = false;
+			break;
+		case SDL_WINDOWEVENT_SHOWN:
+		case SDL_WINDOWEVENT_RESTORED:
+		case SDL_WINDOWEVENT_MAXIMIZED:
+			entry->visible = true;
+			// what's on screen is gone
+			/* fallthrough */
+		case SDL_WINDOWEVENT_EXPOSED:
+		case SDL_WINDOWEVENT_SIZE_CHANGED:
+			ACGL_gui_force_update(entry->gui);
+			break;
+		}
+		if (entry->medata != NULL) {
+			ACGL_ih_handle_windowevent(event, entry->medata);
+		}
+		return true;
+
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		entry = __acgl_display_find(display, event->key.windowID);
+		if (entry == NULL) {
+			return false;
+		}
+		if (entry->medata != NULL && display->keybinds != NULL) {
+			ACGL_ih_handle_keyevent(event, display->keybinds, entry->medata);
+		}
+		return true;
+	}
+	return false;
+}
+
+static int __acgl_display_on_event(const SDL_Event* event, void* data) {
+	return ACGL_display_handle_event((ACGL_display_t*)data, event) ? 1 : 0;
+}
+
+int ACGL_display_attach_pump(ACGL_display_t* display, ACGL_ih_pump_t* pump) {
+	REQUIRES(display != NULL);
+	REQUIRES(pump != NULL);
+
+	static const Uint32 types[] = { SDL_WINDOWEVENT, SDL_KEYDOWN, SDL_KEYUP };
+	for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+		if (ACGL_ih_pump_set_handler(pump, types[i], __acgl_display_on_event, display) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void __acgl_display_make_current(ACGL_display_t* display, SDL_Window* window) {
+	if (display->context == NULL || display->current == window) {
+		return;
+	}
+	if (SDL_GL_MakeCurrent(window, display->context) != 0) {
+		fprintf(stderr, "Error! could not make context current in ACGL_display_render. SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+	display->current = window;
+}
+
+static void __acgl_display_set_swap_interval(ACGL_display_t* display, int interval) {
+	if (display->swap_interval == interval) {
+		return;
+	}
+	if (SDL_GL_SetSwapInterval(interval) != 0) {
+		// e.g. adaptive vsync isn't supported; try again next frame
+		display->swap_interval = -1;
+		return;
+	}
+	display->swap_interval = interval;
+}
+
+int ACGL_display_render(ACGL_display_t* display) {
+	REQUIRES(display != NULL);
+
+	// requests of hidden windows stay pending until they are shown
+	size_t last = 0;
+	int presented = 0;
+	for (size_t i = 0; i < display->windows_size; ++i) {
+		ACGL_display_window_t* entry = &display->windows[i];
+		if (!entry->visible || !ACGL_gui_take_render_request(entry->gui)) {
+			continue;
+		}
+		__acgl_display_make_current(display, entry->window);
+		if (ACGL_gui_render(entry->gui)) {
+			entry->present = true;
+			last = i;
+			++presented;
+		}
+	}
+
+	for (size_t i = 0; presented > 0 && i <= last; ++i) {
+		ACGL_display_window_t* entry = &display->windows[i];
+		if (!entry->present) {
+			continue;
+		}
+		__acgl_display_make_current(display, entry->window);
+		__acgl_display_set_swap_interval(display, i == last ? display->vsync : 0);
+		SDL_GL_SwapWindow(entry->window);
+		entry->present = false;
+	}
+	return presented;
+}
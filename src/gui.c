@@ -15,86 +15,69 @@
      _a > _b ? _a : _b; })
 #endif
 
-bool ACGL_gui_force_update(ACGL_gui_t* gui) {
-    REQUIRES(__ACGL_is_gui_t(gui));
-   
-    bool old_update = gui->root->needs_update;
-    gui->root->needs_update = true;
-    ENSURES(__ACGL_is_gui_t(gui));
-    return !old_update;
-}
-
-bool ACGL_gui_render(ACGL_gui_t* gui) {
-  REQUIRES(__ACGL_is_gui_t(gui));
-
-  int w, h;
-  // Initialize memory just in case
-  w = 0;
-  h = 0;
-  SDL_GL_GetDrawableSize(gui->window, &w, &h);
-  SDL_Rect location = {0, 0, w, h};
-
-  bool output = ACGL_gui_node_render(gui, gui->root, location);
-  ENSURES(__ACGL_is_gui_t(gui));
-  return output;
-}
-
-ACGL_gui_t* ACGL_gui_init(SDL_Window* window) {
-  assert(window != NULL);
-
-  ACGL_gui_t* gui = (ACGL_gui_t*)malloc(sizeof(ACGL_gui_t));
-  if (gui == NULL) {
-    fprintf(stderr, "Error! Could not malloc gui in ACGL_gui_init\n");
-    return NULL;
+// the gui drawing into a window, for ACGL_gui_clip_rect
+#define ACGL_GUI_WINDOW_DATA "ACGL_gui"
+
+// Every node of every ACGL_gui_t comes out of this pool, so creating many at
+// once takes the lock only once. It is dropped when the last node goes
+static ACGL_pool_t* __acgl_gui_node_pool = NULL;
+static SDL_SpinLock __acgl_gui_node_pool_lock = 0;
+
+// Returns: false if out of memory, with nothing allocated
+static bool __acgl_gui_node_alloc(ACGL_gui_object_t** nodes, size_t count) {
+  SDL_AtomicLock(&__acgl_gui_node_pool_lock);
+  if (__acgl_gui_node_pool == NULL) {
+    __acgl_gui_node_pool = ACGL_pool_create(sizeof(ACGL_gui_object_t), 0);
+    if (__acgl_gui_node_pool == NULL) {
+      SDL_AtomicUnlock(&__acgl_gui_node_pool_lock);
+      return false;
+    }
+    __acgl_gui_node_pool->subsystem = ACGL_ALLOC_GUI;
   }
-  gui->window = window;
-
-  gui->root = NULL;
-  gui->root = ACGL_gui_node_init(gui, NULL, NULL, NULL);
-  if (gui->root == NULL) {
-    fprintf(stderr, "Error! could not create gui root node in ACGL_gui_init\n");
-    free(gui);
-    return NULL;
+  for (size_t i = 0; i < count; ++i) {
+    nodes[i] = (ACGL_gui_object_t*)ACGL_pool_alloc(__acgl_gui_node_pool);
+    if (nodes[i] == NULL) {
+      while (i > 0) {
+        ACGL_pool_free(__acgl_gui_node_pool, nodes[--i]);
+      }
+      SDL_AtomicUnlock(&__acgl_gui_node_pool_lock);
+      return false;
+    }
   }
-
-  ENSURES(__ACGL_is_gui_t(gui));
-  return gui;
+  SDL_AtomicUnlock(&__acgl_gui_node_pool_lock);
+  return true;
 }
 
-void ACGL_gui_destroy(ACGL_gui_t* gui) {
-  REQUIRES(__ACGL_is_gui_t(gui));
-
-  if (gui->root != NULL) {
-    ACGL_gui_node_destroy(gui->root);
+static void __acgl_gui_node_free(ACGL_gui_object_t** nodes, size_t count) {
+  SDL_AtomicLock(&__acgl_gui_node_pool_lock);
+  for (size_t i = 0; i < count; ++i) {
+    ACGL_pool_free(__acgl_gui_node_pool, nodes[i]);
   }
-  gui->root = NULL;
-
-  // don't destroy window, could just be switching away from ACGL
-  gui->window = NULL;
-
-  free(gui);
-}
-
-ACGL_gui_object_t* ACGL_gui_node_init(ACGL_gui_t* gui, ACGL_render_callback_t render, ACGL_destroy_callback_t destroy, void* data) {
-  REQUIRES(__ACGL_is_gui_t(gui));
-
-  ACGL_gui_object_t* node = (ACGL_gui_object_t*)malloc(sizeof(ACGL_gui_object_t));
-  if (node == NULL) {
-    fprintf(stderr, "Error! could not malloc node in ACGL_gui_node_init\n");
-    return NULL;
+  if (__acgl_gui_node_pool->blocks_used == 0) {
+    ACGL_pool_destroy(__acgl_gui_node_pool);
+    __acgl_gui_node_pool = NULL;
   }
+  SDL_AtomicUnlock(&__acgl_gui_node_pool_lock);
+}
 
-  node->mutex = SDL_CreateMutex();
-  if (node->mutex == NULL) {
-    fprintf(stderr, "Could not create mutex in ACGL_gui_node_init! SDL Error: %s\n", SDL_GetError());
-    free(node);
-    return NULL;
+// Gives a freshly allocated node its defaults. Returns: false if the mutex could not be created
+static bool __acgl_gui_node_setup(ACGL_gui_object_t* node, ACGL_gui_t* gui, ACGL_render_callback_t render, ACGL_destroy_callback_t destroy, void* data) {
+  if (!ACGL_MUTEX_CREATE(node->mutex)) {
+    return false;
   }
 
+  node->gui = gui;
   node->render_callback = render;
   node->destroy_callback = destroy;
   node->callback_data = data;
   node->needs_update = true;
+  node->needs_layout = false;
+  node->rect = (SDL_Rect){0, 0, 0, 0};
+  node->key = 0;
+  node->opaque = false;
+  node->clip_children = false;
+  node->culled = false;
+  node->shown_frame = 0;
 
   // these defaults make the node fill up all available space in its parent
   node->node_type = ACGL_GUI_NODE_FILL_H + ACGL_GUI_NODE_FILL_W + ACGL_GUI_NODE_NO_PRESERVE_ASPECT;
@@ -118,23 +101,11 @@ ACGL_gui_object_t* ACGL_gui_node_init(ACGL_gui_t* gui, ACGL_render_callback_t re
   node->next_sibling = NULL;
   node->first_child = NULL;
   node->last_child = NULL;
-
-  ENSURES(__ACGL_is_gui_object_t(node));
-  return node;
+  return true;
 }
 
-bool ACGL_gui_node_render(ACGL_gui_t* gui, ACGL_gui_object_t* node, SDL_Rect location) {
-  REQUIRES(__ACGL_is_gui_t(gui));
-  REQUIRES(__ACGL_is_gui_object_t(node));
-  
-  if (SDL_LockMutex(node->mutex) != 0) {
-    fprintf(stderr, "Could not lock mutex in ACGL_gui_node_render. SDL_Error: %s\n", SDL_GetError());
-    return false;
-  }
-
-  bool return_val = false;
-
-  // compute rectangle that we are supposed to draw in
+// Computes the rectangle the node is supposed to draw in, inside location
+static SDL_Rect __acgl_gui_node_place(const ACGL_gui_object_t* node, SDL_Rect location) {
   SDL_Rect sublocation = location;
   ACGL_gui_pos_t sblw, sblh;
   sblw = (ACGL_gui_pos_t)sublocation.w;
@@ -304,38 +275,438 @@ __ACGL_gui_node_render_set_constant_size:
     sublocation.y += (location.h - sublocation.h) / 2;
   }
 
-  if (node->needs_update && node->render_callback != NULL) {
-    return_val |= (*node->render_callback)(gui->window, sublocation, node->callback_data);
+  return sublocation;
+}
+
+// ACGL_gui_request_render for changes made to node's tree. Skips checking the
+// gui, which may be in the middle of being destroyed
+static void __acgl_gui_node_request_render(const ACGL_gui_object_t* node) {
+  SDL_AtomicSet(&node->gui->render_requested, 1);
+}
+
+// Stores where the node goes this frame. A pure geometry change only costs a
+// redraw if it moved the node by a whole pixel
+static void __acgl_gui_node_set_rect(ACGL_gui_object_t* node, SDL_Rect rect) {
+  if (node->needs_layout) {
+    if (!SDL_RectEquals(&rect, &node->rect)) {
+      node->needs_update = true;
+    }
+    node->needs_layout = false;
+  }
+  node->rect = rect;
+}
+
+// The biggest opaque rects drawn after the node being looked at. A node only
+// counts as hidden when one of them covers it entirely, which is what modal
+// dialogs and stacked pages do, and needs no region math
+typedef struct {
+  SDL_Rect rects[ACGL_GUI_MAX_OCCLUDERS];
+  int count;
+} __acgl_gui_occluders_t;
+
+static bool __acgl_gui_occluded(const __acgl_gui_occluders_t* occluders, SDL_Rect rect) {
+  for (int i = 0; i < occluders->count; ++i) {
+    const SDL_Rect* o = &occluders->rects[i];
+    if (rect.x >= o->x && rect.y >= o->y && rect.x + rect.w <= o->x + o->w && rect.y + rect.h <= o->y + o->h) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void __acgl_gui_add_occluder(__acgl_gui_occluders_t* occluders, SDL_Rect rect) {
+  if (rect.w <= 0 || rect.h <= 0 || __acgl_gui_occluded(occluders, rect)) {
+    return;
+  }
+  if (occluders->count < ACGL_GUI_MAX_OCCLUDERS) {
+    occluders->rects[occluders->count++] = rect;
+    return;
+  }
+  // full, so keep the bigger ones
+  int smallest = 0;
+  for (int i = 1; i < occluders->count; ++i) {
+    if ((Sint64)occluders->rects[i].w * occluders->rects[i].h < (Sint64)occluders->rects[smallest].w * occluders->rects[smallest].h) {
+      smallest = i;
+    }
+  }
+  if ((Sint64)rect.w * rect.h > (Sint64)occluders->rects[smallest].w * occluders->rects[smallest].h) {
+    occluders->rects[smallest] = rect;
+  }
+}
+
+// Returns: whether node lies entirely outside what its ancestors clip to.
+// Empty nodes draw nothing either way and keep their callbacks
+static bool __acgl_gui_clipped(const ACGL_gui_object_t* node, SDL_Rect clip) {
+  return !SDL_RectEmpty(&node->rect) && !SDL_HasIntersection(&node->rect, &clip);
+}
+
+static SDL_Rect __acgl_gui_child_clip(const ACGL_gui_object_t* node, SDL_Rect clip) {
+  SDL_Rect child_clip = clip;
+  if (node->clip_children && !SDL_IntersectRect(&clip, &node->rect, &child_clip)) {
+    child_clip = (SDL_Rect){0, 0, 0, 0};
+  }
+  return child_clip;
+}
+
+// Front-to-back pass ahead of __acgl_gui_node_draw: lays the subtree out and
+// marks the nodes that opaque nodes drawn after them hide. Children are drawn
+// after their parent and first_child last, so this visits them the other way
+static void __acgl_gui_node_cull(ACGL_gui_t* gui, ACGL_gui_object_t* node, SDL_Rect location, SDL_Rect clip, __acgl_gui_occluders_t* occluders) {
+  if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+    fprintf(stderr, "Could not lock mutex in __acgl_gui_node_cull. SDL_Error: %s\n", SDL_GetError());
+    return;
   }
 
+  __acgl_gui_node_set_rect(node, __acgl_gui_node_place(node, location));
+  SDL_Rect child_clip = __acgl_gui_child_clip(node, clip);
+  for (ACGL_gui_object_t* child = node->first_child; child != NULL; child = child->next_sibling) {
+    __acgl_gui_node_cull(gui, child, node->rect, child_clip, occluders);
+  }
+
+  bool culled = __acgl_gui_clipped(node, clip) || __acgl_gui_occluded(occluders, node->rect);
+  if (node->culled && !culled) {
+    // it missed whatever happened while it was hidden
+    node->needs_update = true;
+  }
+  node->culled = culled;
+  if (!culled && !SDL_RectEmpty(&node->rect)) {
+    node->shown_frame = gui->frame;
+  }
+  // a clipped opaque node only paints over what is inside the clip
+  SDL_Rect visible;
+  if (node->opaque && !culled && SDL_IntersectRect(&node->rect, &clip, &visible)) {
+    ++gui->opaque_nodes;
+    __acgl_gui_add_occluder(occluders, visible);
+  }
+
+  ACGL_MUTEX_UNLOCK(node->mutex);
+}
+
+// Back-to-front pass drawing into the rects __acgl_gui_node_cull stored.
+// force is set when the parent redrew, which the node has to draw over
+static bool __acgl_gui_node_draw(ACGL_gui_t* gui, ACGL_gui_object_t* node, SDL_Rect clip, bool force) {
+  if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+    fprintf(stderr, "Could not lock mutex in __acgl_gui_node_draw. SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  bool return_val = false;
+  if (force) {
+    node->needs_update = true;
+  }
+  if (node->needs_update && !node->culled && node->render_callback != NULL) {
+    gui->clip = clip;
+    return_val |= (*node->render_callback)(gui->window, node->rect, node->callback_data);
+  }
+
+  SDL_Rect child_clip = __acgl_gui_child_clip(node, clip);
   ACGL_gui_object_t* child = node->last_child;
   while (child != NULL) {
-    if (node->needs_update) {
-      child->needs_update = true;
+    return_val |= __acgl_gui_node_draw(gui, child, child_clip, node->needs_update);
+    child = child->prev_sibling;
+  }
+
+  node->needs_update = false;
+  ACGL_MUTEX_UNLOCK(node->mutex);
+  return return_val;
+}
+
+bool ACGL_gui_force_update(ACGL_gui_t* gui) {
+    REQUIRES(__ACGL_is_gui_t(gui));
+   
+    if (ACGL_MUTEX_LOCK(gui->root->mutex) != 0) {
+      fprintf(stderr, "Could not lock mutex in ACGL_gui_force_update. SDL_Error: %s\n", SDL_GetError());
+      return false;
+    }
+    bool old_update = gui->root->needs_update;
+    gui->root->needs_update = true;
+    ACGL_MUTEX_UNLOCK(gui->root->mutex);
+    ACGL_gui_request_render(gui);
+    ENSURES(__ACGL_is_gui_t(gui));
+    return !old_update;
+}
+
+void ACGL_gui_request_render(ACGL_gui_t* gui) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+  SDL_AtomicSet(&gui->render_requested, 1);
+}
+
+bool ACGL_gui_take_render_request(ACGL_gui_t* gui) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+  return SDL_AtomicSet(&gui->render_requested, 0) != 0;
+}
+
+bool ACGL_gui_render(ACGL_gui_t* gui) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+
+  int w, h;
+  // Initialize memory just in case
+  w = 0;
+  h = 0;
+  SDL_GL_GetDrawableSize(gui->window, &w, &h);
+  SDL_Rect location = {0, 0, w, h};
+
+  // held for the whole frame, so whoever takes it sees a frame count that
+  // matches every node's shown_frame
+  if (ACGL_MUTEX_LOCK(gui->root->mutex) != 0) {
+    fprintf(stderr, "Could not lock mutex in ACGL_gui_render. SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+  ++gui->frame;
+
+  // culling walks the tree twice, so it only runs while there are opaque
+  // nodes. One that just turned opaque starts hiding things a frame later
+  bool cull = gui->opaque_nodes > 0;
+  gui->opaque_nodes = 0;
+  bool output;
+  if (cull) {
+    __acgl_gui_occluders_t occluders;
+    occluders.count = 0;
+    __acgl_gui_node_cull(gui, gui->root, location, location, &occluders);
+    output = __acgl_gui_node_draw(gui, gui->root, location, false);
+  } else {
+    output = ACGL_gui_node_render(gui, gui->root, location);
+  }
+  gui->clip = location;
+  ACGL_MUTEX_UNLOCK(gui->root->mutex);
+  // nothing allocated during the frame outlives it
+  ACGL_arena_reset(gui->scratch);
+  ENSURES(__ACGL_is_gui_t(gui));
+  return output;
+}
+
+SDL_Rect ACGL_gui_clip_rect(SDL_Window* window) {
+  REQUIRES(window != NULL);
+  ACGL_gui_t* gui = (ACGL_gui_t*)SDL_GetWindowData(window, ACGL_GUI_WINDOW_DATA);
+  if (gui != NULL) {
+    return gui->clip;
+  }
+  SDL_Rect whole = {0, 0, 0, 0};
+  SDL_GL_GetDrawableSize(window, &whole.w, &whole.h);
+  return whole;
+}
+
+void* ACGL_gui_scratch_alloc(ACGL_gui_t* gui, size_t size) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+  return ACGL_arena_alloc(gui->scratch, size);
+}
+
+ACGL_gui_t* ACGL_gui_init(SDL_Window* window) {
+  assert(window != NULL);
+
+  ACGL_gui_t* gui = (ACGL_gui_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_gui_t));
+  if (gui == NULL) {
+    fprintf(stderr, "Error! Could not malloc gui in ACGL_gui_init\n");
+    return NULL;
+  }
+  gui->window = window;
+  gui->opaque_nodes = 0;
+  gui->frame = 0;
+  gui->clip = (SDL_Rect){0, 0, 0, 0};
+  SDL_GL_GetDrawableSize(window, &gui->clip.w, &gui->clip.h);
+  gui->lazy_nodes = NULL;
+  // nothing has been drawn yet
+  SDL_AtomicSet(&gui->render_requested, 1);
+
+  if (!ACGL_MUTEX_CREATE(gui->lazy_mutex)) {
+    fprintf(stderr, "Could not create lazy mutex in ACGL_gui_init! SDL Error: %s\n", SDL_GetError());
+    ACGL_free(gui);
+    return NULL;
+  }
+
+  gui->scratch = ACGL_arena_create(ACGL_GUI_SCRATCH_CHUNK, 0);
+  if (gui->scratch == NULL) {
+    fprintf(stderr, "Error! could not create scratch arena in ACGL_gui_init\n");
+    ACGL_MUTEX_DESTROY(gui->lazy_mutex);
+    ACGL_free(gui);
+    return NULL;
+  }
+
+  gui->root = NULL;
+  gui->root = ACGL_gui_node_init(gui, NULL, NULL, NULL);
+  if (gui->root == NULL) {
+    fprintf(stderr, "Error! could not create gui root node in ACGL_gui_init\n");
+    ACGL_arena_destroy(gui->scratch);
+    ACGL_MUTEX_DESTROY(gui->lazy_mutex);
+    ACGL_free(gui);
+    return NULL;
+  }
+  SDL_SetWindowData(window, ACGL_GUI_WINDOW_DATA, gui);
+
+  ENSURES(__ACGL_is_gui_t(gui));
+  return gui;
+}
+
+void ACGL_gui_destroy(ACGL_gui_t* gui) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+
+  if (gui->root != NULL) {
+    ACGL_gui_node_destroy(gui->root);
+  }
+  gui->root = NULL;
+  if (SDL_GetWindowData(gui->window, ACGL_GUI_WINDOW_DATA) == gui) {
+    SDL_SetWindowData(gui->window, ACGL_GUI_WINDOW_DATA, NULL);
+  }
+  // only now, lazy nodes in the tree unregister themselves when destroyed
+  ACGL_MUTEX_DESTROY(gui->lazy_mutex);
+
+  // don't destroy window, could just be switching away from ACGL
+  gui->window = NULL;
+
+  ACGL_arena_destroy(gui->scratch);
+  gui->scratch = NULL;
+
+  ACGL_free(gui);
+}
+
+ACGL_gui_object_t* ACGL_gui_node_init(ACGL_gui_t* gui, ACGL_render_callback_t render, ACGL_destroy_callback_t destroy, void* data) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+
+  ACGL_gui_object_t* node;
+  if (!__acgl_gui_node_alloc(&node, 1)) {
+    fprintf(stderr, "Error! could not malloc node in ACGL_gui_node_init\n");
+    return NULL;
+  }
+
+  if (!__acgl_gui_node_setup(node, gui, render, destroy, data)) {
+    fprintf(stderr, "Could not create mutex in ACGL_gui_node_init! SDL Error: %s\n", SDL_GetError());
+    __acgl_gui_node_free(&node, 1);
+    return NULL;
+  }
+
+  ENSURES(__ACGL_is_gui_object_t(node));
+  return node;
+}
+
+bool ACGL_gui_node_init_many(ACGL_gui_t* gui, ACGL_gui_object_t** nodes, size_t count) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+  REQUIRES(nodes != NULL || count == 0);
+
+  if (!__acgl_gui_node_alloc(nodes, count)) {
+    fprintf(stderr, "Error! could not malloc %zu nodes in ACGL_gui_node_init_many\n", count);
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (!__acgl_gui_node_setup(nodes[i], gui, NULL, NULL, NULL)) {
+      fprintf(stderr, "Could not create mutex in ACGL_gui_node_init_many! SDL Error: %s\n", SDL_GetError());
+      for (size_t j = 0; j < i; ++j) {
+        ACGL_MUTEX_DESTROY(nodes[j]->mutex);
+      }
+      __acgl_gui_node_free(nodes, count);
+      return false;
     }
-    return_val |= ACGL_gui_node_render(gui, child, sublocation);
+  }
+  return true;
+}
+
+// force is set when the parent redrew. Children are told that way instead of
+// through their needs_update, which only their own lock guards
+static bool __acgl_gui_node_render(ACGL_gui_t* gui, ACGL_gui_object_t* node, SDL_Rect location, SDL_Rect clip, bool force) {
+  if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+    fprintf(stderr, "Could not lock mutex in ACGL_gui_node_render. SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  bool return_val = false;
+
+  if (force) {
+    node->needs_update = true;
+  }
+  __acgl_gui_node_set_rect(node, __acgl_gui_node_place(node, location));
+  // nothing hides behind opaque nodes on this path, only clipping culls
+  bool culled = __acgl_gui_clipped(node, clip);
+  if (node->culled && !culled) {
+    // whatever happened while it was hidden has to catch up
+    node->needs_update = true;
+  }
+  node->culled = culled;
+  if (!culled && !SDL_RectEmpty(&node->rect)) {
+    node->shown_frame = gui->frame;
+  }
+  if (node->opaque && !culled) {
+    ++gui->opaque_nodes;
+  }
+
+  if (node->needs_update && !culled && node->render_callback != NULL) {
+    gui->clip = clip;
+    return_val |= (*node->render_callback)(gui->window, node->rect, node->callback_data);
+  }
+
+  SDL_Rect child_clip = __acgl_gui_child_clip(node, clip);
+  ACGL_gui_object_t* child = node->last_child;
+  while (child != NULL) {
+    return_val |= __acgl_gui_node_render(gui, child, node->rect, child_clip, node->needs_update);
     child = child->prev_sibling;
   }
 
   node->needs_update = false;
-  SDL_UnlockMutex(node->mutex);
+  ACGL_MUTEX_UNLOCK(node->mutex);
+  return return_val;
+}
+
+SDL_Rect ACGL_gui_node_place(const ACGL_gui_object_t* node, SDL_Rect location) {
+  REQUIRES(node != NULL);
+  return __acgl_gui_node_place(node, location);
+}
+
+bool ACGL_gui_node_render(ACGL_gui_t* gui, ACGL_gui_object_t* node, SDL_Rect location) {
+  REQUIRES(__ACGL_is_gui_t(gui));
+  REQUIRES(__ACGL_is_gui_object_t(node));
+
+  SDL_Rect clip = gui->clip;
+  bool return_val = __acgl_gui_node_render(gui, node, location, location, false);
+  gui->clip = clip;
 
   ENSURES(__ACGL_is_gui_object_t(node));
   ENSURES(__ACGL_is_gui_t(gui));
   return return_val;
 }
 
+void ACGL_gui_node_mark_dirty(ACGL_gui_object_t* node) {
+  REQUIRES(__ACGL_is_gui_object_t(node));
+
+  if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+    fprintf(stderr, "Could not lock mutex in ACGL_gui_node_mark_dirty. SDL_Error: %s\n", SDL_GetError());
+    return;
+  }
+  node->needs_layout = true;
+  ACGL_MUTEX_UNLOCK(node->mutex);
+  __acgl_gui_node_request_render(node);
+}
+
+int ACGL_gui_node_lock(ACGL_gui_object_t* node) {
+  REQUIRES(__ACGL_is_gui_object_t(node));
+#if !ACGL_THREADING
+  (void)node; // the lock below compiles away
+#endif
+
+  if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+    fprintf(stderr, "Could not lock mutex in ACGL_gui_node_lock. SDL_Error: %s\n", SDL_GetError());
+    return -1;
+  }
+  return 0;
+}
+
+void ACGL_gui_node_unlock(ACGL_gui_object_t* node) {
+  REQUIRES(__ACGL_is_gui_object_t(node));
+#if !ACGL_THREADING
+  (void)node;
+#endif
+  ACGL_MUTEX_UNLOCK(node->mutex);
+}
+
 void ACGL_gui_node_add_child_front(ACGL_gui_object_t* parent, ACGL_gui_object_t* child) {
   REQUIRES(__ACGL_is_gui_object_t(parent));
   REQUIRES(__ACGL_is_gui_object_t(child));
 
-  if (SDL_LockMutex(parent->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(parent->mutex) != 0) {
     fprintf(stderr, "Could not lock parent mutex in ACGL_gui_node_add_child_front! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
     return;
   }
 
-  if (SDL_LockMutex(child->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(child->mutex) != 0) {
     fprintf(stderr, "Could not lock child mutex in ACGL_gui_node_add_child_front! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
+    ACGL_MUTEX_UNLOCK(parent->mutex);
     return;
   }
 
@@ -350,21 +721,22 @@ void ACGL_gui_node_add_child_front(ACGL_gui_object_t* parent, ACGL_gui_object_t*
   } else {
     // we should be inserting at an actual front
     assert(first_child->prev_sibling == NULL);
-    if (SDL_LockMutex(first_child->mutex) != 0) {
-      fprintf(stderr, "Could not lock first_child mutex in ACGL_gui_node_add_child_front! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
-      return;
-    }
+    // sibling links belong to the parent's lock, so first_child isn't locked.
+    // locking siblings one after another would order their locks by list
+    // position, which changes, and two threads could lock a pair both ways
     first_child->prev_sibling = child;
     child->next_sibling = first_child;
     child->prev_sibling = NULL;
 
     parent->first_child = child;
     child->parent = parent;
-    SDL_UnlockMutex(first_child->mutex);
   }
+  // it may have been drawn somewhere else before
+  child->needs_update = true;
 
-  SDL_UnlockMutex(child->mutex);
-  SDL_UnlockMutex(parent->mutex);
+  ACGL_MUTEX_UNLOCK(child->mutex);
+  ACGL_MUTEX_UNLOCK(parent->mutex);
+  __acgl_gui_node_request_render(parent);
   ENSURES(__ACGL_is_gui_object_t(parent));
   ENSURES(__ACGL_is_gui_object_t(child));
 }
@@ -373,13 +745,14 @@ void ACGL_gui_node_add_child_back(ACGL_gui_object_t* parent, ACGL_gui_object_t*
   REQUIRES(__ACGL_is_gui_object_t(parent));
   REQUIRES(__ACGL_is_gui_object_t(child));
 
-  if (SDL_LockMutex(parent->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(parent->mutex) != 0) {
     fprintf(stderr, "Could not lock parent mutex in ACGL_gui_node_add_child_back! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
     return;
   }
 
-  if (SDL_LockMutex(child->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(child->mutex) != 0) {
     fprintf(stderr, "Could not lock child mutex in ACGL_gui_node_add_child_back! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
+    ACGL_MUTEX_UNLOCK(parent->mutex);
     return;
   }
 
@@ -394,21 +767,19 @@ void ACGL_gui_node_add_child_back(ACGL_gui_object_t* parent, ACGL_gui_object_t*
   } else {
     // we should be at an actual last child
     assert(last_child->next_sibling == NULL);
-    if (SDL_LockMutex(last_child->mutex) != 0) {
-      fprintf(stderr, "Could not lock last_child mutex in ACGL_gui_node_add_child_back! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
-      return;
-    }
+    // the parent's lock covers last_child's links, see add_child_front
     last_child->next_sibling = child;
     child->prev_sibling = last_child;
     child->next_sibling = NULL;
 
     parent->last_child = child;
     child->parent = parent;
-    SDL_UnlockMutex(last_child->mutex);
   }
+  child->needs_update = true;
 
-  SDL_UnlockMutex(child->mutex);
-  SDL_UnlockMutex(parent->mutex);
+  ACGL_MUTEX_UNLOCK(child->mutex);
+  ACGL_MUTEX_UNLOCK(parent->mutex);
+  __acgl_gui_node_request_render(parent);
   
   ENSURES(__ACGL_is_gui_object_t(parent));
   ENSURES(__ACGL_is_gui_object_t(child));
@@ -418,13 +789,14 @@ void ACGL_gui_node_remove_child(ACGL_gui_object_t* parent, ACGL_gui_object_t* ch
   REQUIRES(__ACGL_is_gui_object_t(parent));
   REQUIRES(__ACGL_is_gui_object_t(child));
 
-  if (SDL_LockMutex(parent->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(parent->mutex) != 0) {
     fprintf(stderr, "Could not lock parent mutex in ACGL_gui_node_remove_child! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
     return;
   }
 
-  if (SDL_LockMutex(child->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(child->mutex) != 0) {
     fprintf(stderr, "Could not lock child mutex in ACGL_gui_node_remove_child! Things will definitely look wrong. SDL_Error %s\n", SDL_GetError());
+    ACGL_MUTEX_UNLOCK(parent->mutex);
     return;
   }
 
@@ -439,10 +811,13 @@ void ACGL_gui_node_remove_child(ACGL_gui_object_t* parent, ACGL_gui_object_t* ch
         child->next_sibling = NULL;
         if (node == parent->last_child) {
           parent->last_child = NULL;
+        } else {
+          parent->first_child->prev_sibling = NULL;
         }
       } else if (node == parent->last_child) {
         assert(child->next_sibling == NULL);
         parent->last_child = parent->last_child->prev_sibling;
+        parent->last_child->next_sibling = NULL;
         child->prev_sibling = NULL;
         // don't have to check for case of single node, already covered in previous statement
       } else {
@@ -454,6 +829,8 @@ void ACGL_gui_node_remove_child(ACGL_gui_object_t* parent, ACGL_gui_object_t* ch
         child->next_sibling = NULL;
       }
 
+      // what it covered has to be drawn again
+      parent->needs_update = true;
       // if the node has been added more than once, we have bigger problems
       break;
     }
@@ -463,15 +840,16 @@ void ACGL_gui_node_remove_child(ACGL_gui_object_t* parent, ACGL_gui_object_t* ch
 
   child->parent = NULL;
 
-  SDL_UnlockMutex(child->mutex);
-  SDL_UnlockMutex(parent->mutex);
+  ACGL_MUTEX_UNLOCK(child->mutex);
+  ACGL_MUTEX_UNLOCK(parent->mutex);
+  __acgl_gui_node_request_render(parent);
   ENSURES(__ACGL_is_gui_object_t(parent));
 }
 
 void ACGL_gui_node_remove_all_children(ACGL_gui_object_t* parent) {
   REQUIRES(__ACGL_is_gui_object_t(parent));
 
-  if (SDL_LockMutex(parent->mutex) != 0) {
+  if (ACGL_MUTEX_LOCK(parent->mutex) != 0) {
     fprintf(stderr, "Could not lock parent mutex in ACGL_gui_node_remove_all_children! SDL_Error %s\n", SDL_GetError());
     return;
   }
@@ -482,28 +860,32 @@ void ACGL_gui_node_remove_all_children(ACGL_gui_object_t* parent) {
   while (next_child != NULL) {
     ASSERT(__ACGL_is_gui_object_t(child));
     next_child = child->next_sibling;
-    if (SDL_LockMutex(child->mutex) != 0) {
+    if (ACGL_MUTEX_LOCK(child->mutex) != 0) {
       fprintf(stderr, "Could not lock child mutex in ACGL_gui_node_remove_all_children! SDL_Error %s\n", SDL_GetError());
       break;
     }
     child->parent = NULL;
-    SDL_UnlockMutex(child->mutex);
+    ACGL_MUTEX_UNLOCK(child->mutex);
     child = next_child;
   }
 
+  if (parent->first_child != NULL) {
+    parent->needs_update = true;
+  }
   parent->first_child = NULL;
   parent->last_child = NULL;
 
-  SDL_UnlockMutex(parent->mutex);
+  ACGL_MUTEX_UNLOCK(parent->mutex);
+  __acgl_gui_node_request_render(parent);
   ENSURES(__ACGL_is_gui_object_t(parent));
 }
 
-void ACGL_gui_node_destroy_all_children(ACGL_gui_object_t* parent) {
-  REQUIRES(__ACGL_is_gui_object_t(parent));
-
-  if (SDL_LockMutex(parent->mutex) != 0) {
+// Returns: whether there were any children. Doesn't request a render, so
+// nodes outliving their gui can still be destroyed
+static bool __acgl_gui_node_destroy_children(ACGL_gui_object_t* parent) {
+  if (ACGL_MUTEX_LOCK(parent->mutex) != 0) {
     fprintf(stderr, "Could not lock parent mutex in ACGL_gui_node_remove_all_children! SDL_Error %s\n", SDL_GetError());
-    return;
+    return false;
   }
 
   ACGL_gui_object_t* child = parent->first_child;
@@ -516,10 +898,23 @@ void ACGL_gui_node_destroy_all_children(ACGL_gui_object_t* parent) {
     child = next_child;
   }
 
+  bool had_children = parent->first_child != NULL;
+  if (had_children) {
+    parent->needs_update = true;
+  }
   parent->first_child = NULL;
   parent->last_child = NULL;
 
-  SDL_UnlockMutex(parent->mutex);
+  ACGL_MUTEX_UNLOCK(parent->mutex);
+  return had_children;
+}
+
+void ACGL_gui_node_destroy_all_children(ACGL_gui_object_t* parent) {
+  REQUIRES(__ACGL_is_gui_object_t(parent));
+
+  if (__acgl_gui_node_destroy_children(parent)) {
+    __acgl_gui_node_request_render(parent);
+  }
   ENSURES(__ACGL_is_gui_object_t(parent));
 }
 
@@ -530,13 +925,10 @@ void ACGL_gui_node_destroy(ACGL_gui_object_t* node) {
   // Then, recursively free all children. This is safe because
   // we do this before destroying our own node, so all child calls
   // will still have a proper parent to remove themselves from
-  ACGL_gui_node_destroy_all_children(node);
+  __acgl_gui_node_destroy_children(node);
   
   // Then free data related to the node
-  if (node->mutex != NULL) {
-    SDL_DestroyMutex(node->mutex);
-    node->mutex = NULL;
-  }
+  ACGL_MUTEX_DESTROY(node->mutex);
   if (node->callback_data != NULL) {
     if (node->destroy_callback != NULL) {
       (*node->destroy_callback)(node->callback_data);
@@ -544,6 +936,6 @@ void ACGL_gui_node_destroy(ACGL_gui_object_t* node) {
     node->callback_data = NULL;
   }
   // node->renderer is shared, don't free it
-  free(node);
+  __acgl_gui_node_free(&node, 1);
   // make sure to set to NULL on the outside, don't want any dangling refrences
 }
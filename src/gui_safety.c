@@ -16,6 +16,11 @@ bool __ACGL_is_gui_t(ACGL_gui_t* gui) {
         return false;
     }
 
+    if (gui->scratch == NULL) {
+        fprintf(stderr, "Error! NULL ACGL_gui_t->scratch\n");
+        return false;
+    }
+
     return true;
 }
 
@@ -68,6 +73,7 @@ bool __ACGL_is_acyclic_list(ACGL_gui_object_t *object) {
         if (tort->parent != object) {
             return false;
         }
+        tort = tort->next_sibling;
     }
 
     return object->last_child == NULL || object->last_child->parent == object;
@@ -119,10 +125,12 @@ bool __ACGL_is_gui_object_t(ACGL_gui_object_t* object) {
         return false;
     }
 
+#if ACGL_THREADING
     if (object->mutex == NULL) {
         fprintf(stderr, "Error! NULL ACGL_gui_object_t->mutex\n");
         return false;
     }
+#endif
     
     if (!__ACGL_is_acyclic_tree(object)) {
         fprintf(stderr, "Error! ACGL_gui_object_t contains a cycle!\n");
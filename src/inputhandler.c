@@ -1,34 +1,146 @@
 #include "inputhandler.h"
+#include "alloc.h"
+#include "inputrecord.h"
+#include "inputstate.h"
+#include "threads.h"
+#include "clock.h"
+
+#define ACGL_IH_NIL 0xFFFFFFFFu
+
+enum ACGL_IH_REGISTRATION_STATE {
+	ACGL_IH_FREE,
+	ACGL_IH_REGISTERED,
+	ACGL_IH_ADDING,    // registered during dispatch, not in its list yet
+	ACGL_IH_REMOVING,  // deregistered during dispatch, still in its list
+	ACGL_IH_CANCELLED, // registered and deregistered during the same dispatch
+};
+
+// Builds the lookup table for binds with a counting sort on scancode.
+// Returns: NULL if out of memory
+static ACGL_ih_keymap_t* __acgl_ih_compile_keymap(const ACGL_ih_keybind_t* binds, size_t binds_size) {
+	ACGL_ih_keymap_t* keymap = (ACGL_ih_keymap_t*)ACGL_calloc(ACGL_ALLOC_INPUT, 1, sizeof(ACGL_ih_keymap_t));
+	if (keymap == NULL) {
+		return NULL;
+	}
+	keymap->actions = (Uint16*)ACGL_malloc(ACGL_ALLOC_INPUT, (binds_size > 0 ? binds_size : 1) * sizeof(Uint16));
+	if (keymap->actions == NULL) {
+		ACGL_free(keymap);
+		return NULL;
+	}
+
+	for (size_t i=0; i<binds_size; ++i) {
+		++keymap->offsets[binds[i].scancode + 1];
+	}
+	for (size_t s=0; s<SDL_NUM_SCANCODES; ++s) {
+		keymap->offsets[s + 1] += keymap->offsets[s];
+	}
+	// fill each scancode's range back to front so the bind order is kept
+	for (size_t i=binds_size; i>0; --i) {
+		const ACGL_ih_keybind_t* bind = &binds[i - 1];
+		keymap->actions[--keymap->offsets[bind->scancode + 1]] = bind->action;
+	}
+	// offsets[s + 1] now holds the start of scancode s, shift them into place
+	for (size_t s=0; s<SDL_NUM_SCANCODES; ++s) {
+		keymap->offsets[s] = keymap->offsets[s + 1];
+	}
+	keymap->offsets[SDL_NUM_SCANCODES] = (Uint32)binds_size;
+
+	keymap->next_retired = NULL;
+	return keymap;
+}
+
+static void __acgl_ih_free_keymaps(ACGL_ih_keymap_t* keymap) {
+	while (keymap != NULL) {
+		ACGL_ih_keymap_t* next = keymap->next_retired;
+		ACGL_free(keymap->actions);
+		ACGL_free(keymap);
+		keymap = next;
+	}
+}
+
+// Compiles keybinds->binds and swaps the result in. Call with keybinds->mutex held
+static int __acgl_ih_publish_keymap(ACGL_ih_keybinds_t* keybinds) {
+	ACGL_ih_keymap_t* keymap = __acgl_ih_compile_keymap(keybinds->binds, keybinds->binds_size);
+	if (keymap == NULL) {
+		fprintf(stderr, "Error! could not malloc keymap in __acgl_ih_publish_keymap\n");
+		return -1;
+	}
+
+	ACGL_ih_keymap_t* old = (ACGL_ih_keymap_t*)SDL_AtomicSetPtr((void**)&keybinds->keymap, keymap);
+	if (old != NULL) {
+		old->next_retired = keybinds->retired;
+		keybinds->retired = old;
+	}
+	// handlers count themselves in before loading the keymap, so with nobody
+	// counted in right after the swap, nobody can still hold an old one
+	if (SDL_AtomicGet(&keybinds->readers) == 0) {
+		__acgl_ih_free_keymaps(keybinds->retired);
+		keybinds->retired = NULL;
+	}
+	return 0;
+}
+
+static bool __acgl_ih_reserve_binds(ACGL_ih_keybinds_t* keybinds, size_t binds_size) {
+	if (binds_size <= keybinds->binds_capacity) {
+		return true;
+	}
+	size_t capacity = keybinds->binds_capacity > 0 ? keybinds->binds_capacity : 16;
+	while (capacity < binds_size) {
+		capacity *= 2;
+	}
+	ACGL_ih_keybind_t* binds = (ACGL_ih_keybind_t*)ACGL_realloc(ACGL_ALLOC_INPUT, keybinds->binds, capacity * sizeof(ACGL_ih_keybind_t));
+	if (binds == NULL) {
+		return false;
+	}
+	keybinds->binds = binds;
+	keybinds->binds_capacity = capacity;
+	return true;
+}
 
 ACGL_ih_keybinds_t* ACGL_ih_init_keybinds(const SDL_Scancode keycodes[], const size_t keycodes_size) {
-	ACGL_ih_keybinds_t* keybinds = (ACGL_ih_keybinds_t*)malloc(sizeof(ACGL_ih_keybinds_t));
+	ACGL_ih_keybinds_t* keybinds = (ACGL_ih_keybinds_t*)ACGL_calloc(ACGL_ALLOC_INPUT, 1, sizeof(ACGL_ih_keybinds_t));
 	if (keybinds == NULL) {
 		fprintf(stderr, "Error! could not malloc keybinds in ACGL_ih__init_keybinds\n");
 		return NULL;
 	}
 
-	keybinds->keycodes = (SDL_Scancode*)malloc(keycodes_size * sizeof(SDL_Scancode));
+	if (!ACGL_MUTEX_CREATE(keybinds->mutex) || !__acgl_ih_reserve_binds(keybinds, keycodes_size)) {
+		fprintf(stderr, "Error! could not create keybinds in ACGL_ih__init_keybinds\n");
+		ACGL_ih_deinit_keybinds(keybinds);
+		return NULL;
+	}
 	for (size_t i=0; i<keycodes_size; ++i) {
-		keybinds->keycodes[i] = keycodes[i];
+		keybinds->binds[i].scancode = keycodes[i];
+		keybinds->binds[i].action = (Uint16)i;
+	}
+	keybinds->binds_size = keycodes_size;
+	SDL_AtomicSet(&keybinds->readers, 0);
+
+	if (__acgl_ih_publish_keymap(keybinds) != 0) {
+		ACGL_ih_deinit_keybinds(keybinds);
+		return NULL;
 	}
-	keybinds->keycodes_size = keycodes_size;
 
 	return keybinds;
 }
 
 ACGL_ih_eventdata_t* ACGL_ih_init_eventdata(const size_t keycodes_size) {
-	ACGL_ih_eventdata_t* medata = (ACGL_ih_eventdata_t*)malloc(sizeof(ACGL_ih_eventdata_t));
+	ACGL_ih_eventdata_t* medata = (ACGL_ih_eventdata_t*)ACGL_calloc(ACGL_ALLOC_INPUT, 1, sizeof(ACGL_ih_eventdata_t));
 	if (medata == NULL) {
 		fprintf(stderr, "Error! could not malloc eventdata in ACGL_ih__init_eventdata\n");
 		return NULL;
 	}
 
-	medata->keyCallbacks = (ACGL_ih_callback_node_t**)malloc(sizeof(ACGL_ih_callback_node_t*)*keycodes_size);
-	for (size_t i=0; i<keycodes_size; ++i) {
-		medata->keyCallbacks[i] = NULL;
+	// calloc leaves every list empty
+	medata->keyCallbacks = (ACGL_ih_callback_list_t*)ACGL_calloc(ACGL_ALLOC_INPUT, keycodes_size > 0 ? keycodes_size : 1, sizeof(ACGL_ih_callback_list_t));
+	if (medata->keyCallbacks == NULL) {
+		fprintf(stderr, "Error! could not malloc keyCallbacks in ACGL_ih__init_eventdata\n");
+		ACGL_free(medata);
+		return NULL;
 	}
 	medata->keyCallbacks_size = keycodes_size;
-	medata->windowCallbacks = NULL;
+	medata->free_list = ACGL_IH_NIL;
+	medata->dispatching = 0;
 
 	return medata;
 }
@@ -39,12 +151,140 @@ void ACGL_ih_deinit_keybinds(ACGL_ih_keybinds_t* keybinds) {
 		return;
 	}
 
-	if (keybinds->keycodes != NULL) {
-		free(keybinds->keycodes);
-		keybinds->keycodes = NULL;
+	if (keybinds->binds != NULL) {
+		ACGL_free(keybinds->binds);
+		keybinds->binds = NULL;
+	}
+	__acgl_ih_free_keymaps(keybinds->keymap);
+	keybinds->keymap = NULL;
+	__acgl_ih_free_keymaps(keybinds->retired);
+	keybinds->retired = NULL;
+	ACGL_MUTEX_DESTROY(keybinds->mutex);
+
+	ACGL_free(keybinds);
+}
+
+static bool __acgl_ih_lock_keybinds(ACGL_ih_keybinds_t* keybinds, const char* caller) {
+	if (keybinds == NULL) {
+		fprintf(stderr, "Error! NULL keybinds in %s\n", caller);
+		return false;
+	}
+	if (ACGL_MUTEX_LOCK(keybinds->mutex) != 0) {
+		fprintf(stderr, "Error locking mutex in %s. SDL_Error: %s\n", caller, SDL_GetError());
+		return false;
+	}
+	return true;
+}
+
+static bool __acgl_ih_is_scancode(SDL_Scancode scancode, const char* caller) {
+	if ((unsigned)scancode >= SDL_NUM_SCANCODES) {
+		fprintf(stderr, "Error! scancode %d is out-of-bounds in %s\n", (int)scancode, caller);
+		return false;
+	}
+	return true;
+}
+
+int ACGL_ih_bind_key(ACGL_ih_keybinds_t* keybinds, SDL_Scancode scancode, Uint16 action) {
+	if (!__acgl_ih_is_scancode(scancode, "ACGL_ih_bind_key") || !__acgl_ih_lock_keybinds(keybinds, "ACGL_ih_bind_key")) {
+		return -1;
 	}
 
-	free(keybinds);
+	int result = -1;
+	if (__acgl_ih_reserve_binds(keybinds, keybinds->binds_size + 1)) {
+		keybinds->binds[keybinds->binds_size].scancode = scancode;
+		keybinds->binds[keybinds->binds_size].action = action;
+		++keybinds->binds_size;
+		result = __acgl_ih_publish_keymap(keybinds);
+		if (result != 0) {
+			--keybinds->binds_size;
+		}
+	} else {
+		fprintf(stderr, "Error! could not grow keybinds in ACGL_ih_bind_key\n");
+	}
+
+	ACGL_MUTEX_UNLOCK(keybinds->mutex);
+	return result;
+}
+
+int ACGL_ih_unbind_key(ACGL_ih_keybinds_t* keybinds, SDL_Scancode scancode, Uint16 action) {
+	if (!__acgl_ih_lock_keybinds(keybinds, "ACGL_ih_unbind_key")) {
+		return -1;
+	}
+
+	size_t kept = 0;
+	for (size_t i=0; i<keybinds->binds_size; ++i) {
+		if (keybinds->binds[i].scancode != scancode || keybinds->binds[i].action != action) {
+			keybinds->binds[kept++] = keybinds->binds[i];
+		}
+	}
+	int result = 0;
+	if (kept != keybinds->binds_size) {
+		keybinds->binds_size = kept;
+		result = __acgl_ih_publish_keymap(keybinds);
+	}
+
+	ACGL_MUTEX_UNLOCK(keybinds->mutex);
+	return result;
+}
+
+int ACGL_ih_rebind_action(ACGL_ih_keybinds_t* keybinds, Uint16 action, SDL_Scancode scancode) {
+	if (!__acgl_ih_is_scancode(scancode, "ACGL_ih_rebind_action") || !__acgl_ih_lock_keybinds(keybinds, "ACGL_ih_rebind_action")) {
+		return -1;
+	}
+
+	// reuse the first binding of action, drop the rest
+	size_t kept = 0;
+	bool placed = false;
+	for (size_t i=0; i<keybinds->binds_size; ++i) {
+		if (keybinds->binds[i].action != action) {
+			keybinds->binds[kept++] = keybinds->binds[i];
+		} else if (!placed) {
+			keybinds->binds[kept].scancode = scancode;
+			keybinds->binds[kept++].action = action;
+			placed = true;
+		}
+	}
+	keybinds->binds_size = kept;
+
+	int result = -1;
+	if (placed || __acgl_ih_reserve_binds(keybinds, kept + 1)) {
+		if (!placed) {
+			keybinds->binds[keybinds->binds_size].scancode = scancode;
+			keybinds->binds[keybinds->binds_size].action = action;
+			++keybinds->binds_size;
+		}
+		result = __acgl_ih_publish_keymap(keybinds);
+	} else {
+		fprintf(stderr, "Error! could not grow keybinds in ACGL_ih_rebind_action\n");
+	}
+
+	ACGL_MUTEX_UNLOCK(keybinds->mutex);
+	return result;
+}
+
+int ACGL_ih_set_keybinds(ACGL_ih_keybinds_t* keybinds, const ACGL_ih_keybind_t binds[], size_t binds_size) {
+	for (size_t i=0; i<binds_size; ++i) {
+		if (!__acgl_ih_is_scancode(binds[i].scancode, "ACGL_ih_set_keybinds")) {
+			return -1;
+		}
+	}
+	if (!__acgl_ih_lock_keybinds(keybinds, "ACGL_ih_set_keybinds")) {
+		return -1;
+	}
+
+	int result = -1;
+	if (__acgl_ih_reserve_binds(keybinds, binds_size)) {
+		for (size_t i=0; i<binds_size; ++i) {
+			keybinds->binds[i] = binds[i];
+		}
+		keybinds->binds_size = binds_size;
+		result = __acgl_ih_publish_keymap(keybinds);
+	} else {
+		fprintf(stderr, "Error! could not grow keybinds in ACGL_ih_set_keybinds\n");
+	}
+
+	ACGL_MUTEX_UNLOCK(keybinds->mutex);
+	return result;
 }
 
 void ACGL_ih_deinit_eventdata(ACGL_ih_eventdata_t* medata) {
@@ -52,158 +292,518 @@ void ACGL_ih_deinit_eventdata(ACGL_ih_eventdata_t* medata) {
 		fprintf(stderr, "Error! cannot deinit NULL pointer in ACGL_ih_deinit_eventdata\n");
 		return;
 	}
-	ACGL_ih_callback_node_t* ptr;
-	ACGL_ih_callback_node_t* next_ptr;
 
 	if (medata->keyCallbacks != NULL) {
-		for (Uint16 i=0; i<medata->keyCallbacks_size; ++i) {
-			ptr = medata->keyCallbacks[i];
-			medata->keyCallbacks[i] = NULL;
-
-			while (ptr != NULL) {
-				next_ptr = ptr->next;
-				ptr->next = NULL;
-				free(ptr);
-				ptr = next_ptr;
+		for (size_t i=0; i<medata->keyCallbacks_size; ++i) {
+			ACGL_free(medata->keyCallbacks[i].entries);
+		}
+		ACGL_free(medata->keyCallbacks);
+		medata->keyCallbacks = NULL;
+	}
+	ACGL_free(medata->windowCallbacks.entries);
+	ACGL_free(medata->registrations);
+	ACGL_free(medata->pending);
+
+	ACGL_free(medata);
+}
+
+static ACGL_ih_handle_t __acgl_ih_make_handle(ACGL_ih_eventdata_t* medata, Uint32 index) {
+	return ((Uint64)medata->registrations[index].generation << 32) | (Uint64)(index + 1);
+}
+
+// Returns: the index of the live registration the handle refers to, ACGL_IH_NIL if there is none
+static Uint32 __acgl_ih_lookup(ACGL_ih_eventdata_t* medata, ACGL_ih_handle_t handle) {
+	Uint32 index = (Uint32)(handle & 0xFFFFFFFFu) - 1;
+	if (handle == 0 || index >= medata->registrations_size) {
+		return ACGL_IH_NIL;
+	}
+	ACGL_ih_registration_t* registration = &medata->registrations[index];
+	if (registration->generation != (Uint32)(handle >> 32)) {
+		return ACGL_IH_NIL;
+	}
+	if (registration->state != ACGL_IH_REGISTERED && registration->state != ACGL_IH_ADDING) {
+		return ACGL_IH_NIL;
+	}
+	return index;
+}
+
+static ACGL_ih_callback_list_t* __acgl_ih_list(ACGL_ih_eventdata_t* medata, Uint32 list) {
+	return list < medata->keyCallbacks_size ? &medata->keyCallbacks[list] : &medata->windowCallbacks;
+}
+
+static void __acgl_ih_release(ACGL_ih_eventdata_t* medata, Uint32 index) {
+	ACGL_ih_registration_t* registration = &medata->registrations[index];
+	registration->state = ACGL_IH_FREE;
+	// invalidates every handle given out for this slot
+	++registration->generation;
+	registration->next_free = medata->free_list;
+	medata->free_list = index;
+}
+
+static bool __acgl_ih_insert(ACGL_ih_eventdata_t* medata, Uint32 index) {
+	ACGL_ih_registration_t* registration = &medata->registrations[index];
+	ACGL_ih_callback_list_t* list = __acgl_ih_list(medata, registration->list);
+	if (list->size == list->capacity) {
+		Uint32 capacity = list->capacity > 0 ? list->capacity * 2 : 4;
+		ACGL_ih_callback_entry_t* entries = (ACGL_ih_callback_entry_t*)ACGL_realloc(ACGL_ALLOC_INPUT, list->entries, capacity * sizeof(ACGL_ih_callback_entry_t));
+		if (entries == NULL) {
+			return false;
+		}
+		list->entries = entries;
+		list->capacity = capacity;
+	}
+	registration->position = list->size;
+	registration->state = ACGL_IH_REGISTERED;
+	ACGL_ih_callback_entry_t* entry = &list->entries[list->size++];
+	entry->callback = registration->callback;
+	entry->data = registration->data;
+	entry->target = registration->target;
+	entry->registration = index;
+	return true;
+}
+
+static void __acgl_ih_remove(ACGL_ih_eventdata_t* medata, Uint32 index) {
+	ACGL_ih_registration_t* registration = &medata->registrations[index];
+	ACGL_ih_callback_list_t* list = __acgl_ih_list(medata, registration->list);
+	// swap the last entry into the hole
+	Uint32 last = --list->size;
+	if (registration->position != last) {
+		list->entries[registration->position] = list->entries[last];
+		medata->registrations[list->entries[last].registration].position = registration->position;
+	}
+	__acgl_ih_release(medata, index);
+}
+
+static bool __acgl_ih_defer(ACGL_ih_eventdata_t* medata, Uint32 index) {
+	if (medata->pending_size == medata->pending_capacity) {
+		Uint32 capacity = medata->pending_capacity > 0 ? medata->pending_capacity * 2 : 8;
+		Uint32* pending = (Uint32*)ACGL_realloc(ACGL_ALLOC_INPUT, medata->pending, capacity * sizeof(Uint32));
+		if (pending == NULL) {
+			return false;
+		}
+		medata->pending = pending;
+		medata->pending_capacity = capacity;
+	}
+	medata->pending[medata->pending_size++] = index;
+	return true;
+}
+
+// Applies everything deferred while dispatching
+static void __acgl_ih_apply_pending(ACGL_ih_eventdata_t* medata) {
+	for (Uint32 i=0; i<medata->pending_size; ++i) {
+		Uint32 index = medata->pending[i];
+		switch (medata->registrations[index].state) {
+		case ACGL_IH_ADDING:
+			if (!__acgl_ih_insert(medata, index)) {
+				fprintf(stderr, "Error! could not grow callbacks, dropping a registration in __acgl_ih_apply_pending\n");
+				__acgl_ih_release(medata, index);
 			}
+			break;
+		case ACGL_IH_REMOVING:
+			__acgl_ih_remove(medata, index);
+			break;
+		case ACGL_IH_CANCELLED:
+			__acgl_ih_release(medata, index);
+			break;
 		}
-		free(medata->keyCallbacks);
 	}
+	medata->pending_size = 0;
+}
 
-	ptr = medata->windowCallbacks;
-	medata->windowCallbacks = NULL;
-	while (ptr != NULL) {
-		next_ptr = ptr->next;
-		ptr->next = NULL;
-		free(ptr);
-		ptr = next_ptr;
+static ACGL_ih_handle_t __acgl_ih_register(ACGL_ih_eventdata_t* medata, Uint32 list, ACGL_thread_t* target, ACGL_ih_callback_t callback, void* data) {
+	if (medata->free_list == ACGL_IH_NIL) {
+		Uint32 capacity = medata->registrations_capacity > 0 ? medata->registrations_capacity * 2 : 16;
+		ACGL_ih_registration_t* registrations = (ACGL_ih_registration_t*)ACGL_realloc(ACGL_ALLOC_INPUT, medata->registrations, capacity * sizeof(ACGL_ih_registration_t));
+		if (registrations == NULL) {
+			fprintf(stderr, "Error! could not grow registrations in __acgl_ih_register\n");
+			return 0;
+		}
+		medata->registrations = registrations;
+		medata->registrations_capacity = capacity;
+		for (Uint32 i=capacity; i>medata->registrations_size; --i) {
+			registrations[i-1].generation = 0;
+			registrations[i-1].state = ACGL_IH_FREE;
+			registrations[i-1].next_free = medata->free_list;
+			medata->free_list = i-1;
+		}
+		medata->registrations_size = capacity;
 	}
 
-	free(medata);
+	Uint32 index = medata->free_list;
+	ACGL_ih_registration_t* registration = &medata->registrations[index];
+	medata->free_list = registration->next_free;
+	registration->callback = callback;
+	registration->data = data;
+	registration->target = target;
+	registration->list = list;
+
+	if (medata->dispatching > 0) {
+		registration->state = ACGL_IH_ADDING;
+		if (!__acgl_ih_defer(medata, index)) {
+			fprintf(stderr, "Error! could not defer registration in __acgl_ih_register\n");
+			__acgl_ih_release(medata, index);
+			return 0;
+		}
+	} else if (!__acgl_ih_insert(medata, index)) {
+		fprintf(stderr, "Error! could not grow callbacks in __acgl_ih_register\n");
+		__acgl_ih_release(medata, index);
+		return 0;
+	}
+	return __acgl_ih_make_handle(medata, index);
 }
 
-void ACGL_ih_register_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback, void* data) {
+ACGL_ih_handle_t ACGL_ih_register_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback, void* data) {
 	if (keytype >= medata->keyCallbacks_size) {
 		// unsigned, no need to check for below zero
-		fprintf(stderr, "Error! keytype %d is out-of-bounds for length %llu keyCallbacks in ACGL_ih_register_keyevent\n", keytype, medata->keyCallbacks_size);
-		return;
+		fprintf(stderr, "Error! keytype %d is out-of-bounds for length %zu keyCallbacks in ACGL_ih_register_keyevent\n", keytype, medata->keyCallbacks_size);
+		return 0;
 	}
+	return __acgl_ih_register(medata, keytype, NULL, callback, data);
+}
 
-	ACGL_ih_callback_node_t* new_node = malloc(sizeof(ACGL_ih_callback_node_t));
-	new_node->callback = callback;
-	new_node->data = data;
-	// appends to front of list, is the fastest
-	// + order shouldn't matter anyway
-	new_node->next = medata->keyCallbacks[keytype];
-	medata->keyCallbacks[keytype] = new_node;
+ACGL_ih_handle_t ACGL_ih_register_windowevent(ACGL_ih_eventdata_t* medata, ACGL_ih_callback_t callback, void* data) {
+	return __acgl_ih_register(medata, (Uint32)medata->keyCallbacks_size, NULL, callback, data);
 }
 
-void ACGL_ih_register_windowevent(ACGL_ih_eventdata_t* medata, ACGL_ih_callback_t callback, void* data) {
-	ACGL_ih_callback_node_t* new_node = malloc(sizeof(ACGL_ih_callback_node_t));
-	new_node->callback = callback;
-	new_node->data = data;
-	// appends to front of list, is the fastest
-	// + order shouldn't matter anyway
-	new_node->next = medata->windowCallbacks;
-	medata->windowCallbacks = new_node;
+static bool __acgl_ih_has_inbox(ACGL_thread_t* thread, const char* caller) {
+	if (thread == NULL || thread->data == NULL || thread->data->inbox == NULL) {
+		fprintf(stderr, "Error! target thread has no inbox in %s\n", caller);
+		return false;
+	}
+	return true;
 }
 
-void ACGL_ih_deregister_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback) {
+ACGL_ih_handle_t ACGL_ih_register_keyevent_on(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_thread_t* thread, ACGL_ih_callback_t callback, void* data) {
 	if (keytype >= medata->keyCallbacks_size) {
 		// unsigned, no need to check for below zero
-		fprintf(stderr, "Error! keytype %d is out-of-bounds for length %llu keyCallbacks in ACGL_ih_deregister_keyevent\n", keytype, medata->keyCallbacks_size);
-		return;
+		fprintf(stderr, "Error! keytype %d is out-of-bounds for length %zu keyCallbacks in ACGL_ih_register_keyevent_on\n", keytype, medata->keyCallbacks_size);
+		return 0;
+	}
+	if (!__acgl_ih_has_inbox(thread, "ACGL_ih_register_keyevent_on")) {
+		return 0;
 	}
+	return __acgl_ih_register(medata, keytype, thread, callback, data);
+}
 
-	ACGL_ih_callback_node_t* ptr = medata->keyCallbacks[keytype];
-	ACGL_ih_callback_node_t* prev = NULL;
-
-	while (ptr != NULL) {
-		if (ptr->callback == callback) {
-			// remove the node
-			if (prev == NULL) {
-				// we at the front of the list
-				ptr = medata->keyCallbacks[keytype];
-				medata->keyCallbacks[keytype] = ptr->next;
-				ptr->next = NULL;
-				free(ptr);
-				// keep going just in case function was registered twice
-				ptr = medata->keyCallbacks[keytype]->next;
-				continue;
-			} else {
-				prev->next = ptr->next;
-				ptr->next = NULL;
-				free(ptr);
-				// keep going just in case function was registered twice
-				ptr = prev->next;
+ACGL_ih_handle_t ACGL_ih_register_windowevent_on(ACGL_ih_eventdata_t* medata, ACGL_thread_t* thread, ACGL_ih_callback_t callback, void* data) {
+	if (!__acgl_ih_has_inbox(thread, "ACGL_ih_register_windowevent_on")) {
+		return 0;
+	}
+	return __acgl_ih_register(medata, (Uint32)medata->keyCallbacks_size, thread, callback, data);
+}
+
+static void __acgl_ih_deregister(ACGL_ih_eventdata_t* medata, Uint32 index) {
+	ACGL_ih_registration_t* registration = &medata->registrations[index];
+	if (registration->state == ACGL_IH_ADDING) {
+		// never made it into a list
+		registration->state = ACGL_IH_CANCELLED;
+	} else if (medata->dispatching > 0) {
+		// keep the list as-is for the walk in progress, but don't call it again
+		ACGL_ih_callback_list_t* list = __acgl_ih_list(medata, registration->list);
+		list->entries[registration->position].callback = NULL;
+		registration->state = ACGL_IH_REMOVING;
+		if (!__acgl_ih_defer(medata, index)) {
+			// leave a dead entry behind rather than corrupt the walk
+			fprintf(stderr, "Error! could not defer deregistration in __acgl_ih_deregister\n");
+		}
+	} else {
+		__acgl_ih_remove(medata, index);
+	}
+}
+
+bool ACGL_ih_deregister(ACGL_ih_eventdata_t* medata, ACGL_ih_handle_t handle) {
+	Uint32 index = __acgl_ih_lookup(medata, handle);
+	if (index == ACGL_IH_NIL) {
+		return false;
+	}
+	__acgl_ih_deregister(medata, index);
+	return true;
+}
+
+// Deregisters every registration of callback in list
+static void __acgl_ih_deregister_callback(ACGL_ih_eventdata_t* medata, Uint32 list, ACGL_ih_callback_t callback) {
+	ACGL_ih_callback_list_t* callbacks = __acgl_ih_list(medata, list);
+	Uint32 i = 0;
+	while (i < callbacks->size) {
+		ACGL_ih_callback_entry_t* entry = &callbacks->entries[i];
+		if (entry->callback == callback && callback != NULL) {
+			Uint32 size = callbacks->size;
+			__acgl_ih_deregister(medata, entry->registration);
+			if (callbacks->size != size) {
+				// removed right away, something else was swapped into i
 				continue;
 			}
 		}
+		++i;
+	}
+	// ones registered during this dispatch haven't reached the list yet
+	for (Uint32 p=0; p<medata->pending_size; ++p) {
+		ACGL_ih_registration_t* registration = &medata->registrations[medata->pending[p]];
+		if (registration->state == ACGL_IH_ADDING && registration->list == list && registration->callback == callback) {
+			registration->state = ACGL_IH_CANCELLED;
+		}
+	}
+}
 
-		prev = ptr;
-		ptr = ptr->next;
+void ACGL_ih_deregister_keyevent(ACGL_ih_eventdata_t* medata, Uint16 keytype, ACGL_ih_callback_t callback) {
+	if (keytype >= medata->keyCallbacks_size) {
+		// unsigned, no need to check for below zero
+		fprintf(stderr, "Error! keytype %d is out-of-bounds for length %zu keyCallbacks in ACGL_ih_deregister_keyevent\n", keytype, medata->keyCallbacks_size);
+		return;
 	}
+	__acgl_ih_deregister_callback(medata, keytype, callback);
 }
 
 void ACGL_ih_deregister_windowevent(ACGL_ih_eventdata_t* medata, ACGL_ih_callback_t callback) {
-	ACGL_ih_callback_node_t* ptr = medata->windowCallbacks;
-	ACGL_ih_callback_node_t* prev = NULL;
-
-	while (ptr != NULL) {
-		if (ptr->callback == callback) {
-			// remove the node
-			if (prev == NULL) {
-				// we at the front of the list
-				ptr = medata->windowCallbacks;
-				medata->windowCallbacks = ptr->next;
-				ptr->next = NULL;
-				free(ptr);
-				// keep going just in case function was registered twice
-				ptr = medata->windowCallbacks->next;
-				continue;
-			} else {
-				prev->next = ptr->next;
-				ptr->next = NULL;
-				free(ptr);
-				// keep going just in case function was registered twice
-				ptr = prev->next;
-				continue;
-			}
+	__acgl_ih_deregister_callback(medata, (Uint32)medata->keyCallbacks_size, callback);
+}
+
+// Calls every live callback in list. Returns: whether any were called
+static bool __acgl_ih_dispatch(ACGL_ih_callback_list_t* list, const SDL_Event* event) {
+	bool calledSomething = false;
+	// size can't change until dispatch finishes, so this is a plain walk
+	for (Uint32 i=0; i<list->size; ++i) {
+		ACGL_ih_callback_entry_t* entry = &list->entries[i];
+		if (entry->callback == NULL) {
+			continue;
 		}
+		if (entry->target != NULL) {
+			// a full inbox drops the event, ACGL_thread_post counts it
+			ACGL_thread_post(entry->target, entry->callback, entry->data, event);
+		} else {
+			(*entry->callback)(event, entry->data);
+		}
+		calledSomething = true;
+	}
+	return calledSomething;
+}
 
-		prev = ptr;
-		ptr = ptr->next;
+static void __acgl_ih_end_dispatch(ACGL_ih_eventdata_t* medata) {
+	if (--medata->dispatching == 0 && medata->pending_size > 0) {
+		__acgl_ih_apply_pending(medata);
 	}
 }
 
-bool ACGL_ih_handle_keyevent(SDL_Event event, ACGL_ih_keybinds_t* keybinds, ACGL_ih_eventdata_t* medata) {
+bool ACGL_ih_handle_keyevent(const SDL_Event* event, ACGL_ih_keybinds_t* keybinds, ACGL_ih_eventdata_t* medata) {
 	bool calledSomething = false;
 
-	assert(keybinds->keycodes_size == medata->keyCallbacks_size);
+	SDL_Scancode scancode = event->key.keysym.scancode;
+	if ((unsigned)scancode >= SDL_NUM_SCANCODES) {
+		return false;
+	}
 
-	for (Uint16 i=0; i<medata->keyCallbacks_size; ++i) {
-		if (event.key.keysym.scancode == keybinds->keycodes[i]) {
-			ACGL_ih_callback_node_t* ptr = medata->keyCallbacks[i];
+	// count in before loading, see __acgl_ih_publish_keymap
+	SDL_AtomicAdd(&keybinds->readers, 1);
+	ACGL_ih_keymap_t* keymap = (ACGL_ih_keymap_t*)SDL_AtomicGetPtr((void**)&keybinds->keymap);
+	++medata->dispatching;
 
-			while (ptr != NULL) {
-				(*ptr->callback)(event, ptr->data);
-				ptr = ptr->next;
-				calledSomething = true;
-			}
+	for (Uint32 i=keymap->offsets[scancode]; i<keymap->offsets[scancode + 1]; ++i) {
+		Uint16 action = keymap->actions[i];
+		if (action >= medata->keyCallbacks_size) {
+			// bound, but nothing can ever be registered for it
+			continue;
 		}
+		calledSomething |= __acgl_ih_dispatch(&medata->keyCallbacks[action], event);
 	}
 
+	__acgl_ih_end_dispatch(medata);
+	SDL_AtomicAdd(&keybinds->readers, -1);
 	return calledSomething;
 }
-bool ACGL_ih_handle_windowevent(SDL_Event event, ACGL_ih_eventdata_t* medata) {
-	bool calledSomething = false;
+bool ACGL_ih_handle_windowevent(const SDL_Event* event, ACGL_ih_eventdata_t* medata) {
+	++medata->dispatching;
+	bool calledSomething = __acgl_ih_dispatch(&medata->windowCallbacks, event);
+	__acgl_ih_end_dispatch(medata);
 
-	ACGL_ih_callback_node_t* ptr = medata->windowCallbacks;
-	while (ptr != NULL) {
-		(*ptr->callback)(event, ptr->data);
-		ptr = ptr->next;
-		calledSomething = true;
+	return calledSomething;
+}
+
+ACGL_ih_pump_t* ACGL_ih_pump_create(ACGL_ih_keybinds_t* keybinds, ACGL_ih_eventdata_t* medata) {
+	ACGL_ih_pump_t* pump = (ACGL_ih_pump_t*)ACGL_malloc(ACGL_ALLOC_INPUT, sizeof(ACGL_ih_pump_t));
+	if (pump == NULL) {
+		fprintf(stderr, "Error! could not malloc pump in ACGL_ih_pump_create\n");
+		return NULL;
 	}
+	pump->keybinds = keybinds;
+	pump->medata = medata;
+	for (size_t i=0; i<256; ++i) {
+		pump->handlers[i] = NULL;
+	}
+	pump->coalesce_motion = true;
+	pump->coalesce_resize = true;
+	pump->quit_requested = false;
+	pump->recorder = NULL;
+	pump->actions = NULL;
+	return pump;
+}
 
-	return calledSomething;
+void ACGL_ih_pump_destroy(ACGL_ih_pump_t* pump) {
+	if (pump == NULL) {
+		fprintf(stderr, "Error! cannot destroy NULL pointer in ACGL_ih_pump_destroy\n");
+		return;
+	}
+	for (size_t i=0; i<256; ++i) {
+		ACGL_free(pump->handlers[i]);
+		pump->handlers[i] = NULL;
+	}
+	ACGL_free(pump);
+}
+
+int ACGL_ih_pump_set_handler(ACGL_ih_pump_t* pump, Uint32 type, ACGL_ih_callback_t callback, void* data) {
+	if (type > SDL_LASTEVENT) {
+		fprintf(stderr, "Error! event type %u is out-of-bounds in ACGL_ih_pump_set_handler\n", (unsigned)type);
+		return -1;
+	}
+	ACGL_ih_event_handler_t* page = pump->handlers[type >> 8];
+	if (page == NULL) {
+		if (callback == NULL) {
+			return 0;
+		}
+		page = (ACGL_ih_event_handler_t*)ACGL_calloc(ACGL_ALLOC_INPUT, 256, sizeof(ACGL_ih_event_handler_t));
+		if (page == NULL) {
+			fprintf(stderr, "Error! could not malloc handlers in ACGL_ih_pump_set_handler\n");
+			return -1;
+		}
+		pump->handlers[type >> 8] = page;
+	}
+	page[type & 0xFF].callback = callback;
+	page[type & 0xFF].data = data;
+	return 0;
+}
+
+// Per-window bookkeeping for coalescing one batch
+typedef struct {
+	Uint32 window;
+	int last_motion; // index of the newest motion event still live, -1 for none
+	// index of the newest SDL_WINDOWEVENT_RESIZED and _SIZE_CHANGED, -1 for
+	// none. SDL sends both for one resize, each is only superseded by its own kind
+	int last_resize[2];
+} __acgl_ih_pump_window_t;
+
+static __acgl_ih_pump_window_t* __acgl_ih_pump_window(__acgl_ih_pump_window_t* windows, int* windows_size, Uint32 window) {
+	for (int i=0; i<*windows_size; ++i) {
+		if (windows[i].window == window) {
+			return &windows[i];
+		}
+	}
+	if (*windows_size == ACGL_IH_PUMP_WINDOWS) {
+		// too many windows in one batch, just don't coalesce this one
+		return NULL;
+	}
+	__acgl_ih_pump_window_t* added = &windows[(*windows_size)++];
+	added->window = window;
+	added->last_motion = -1;
+	added->last_resize[0] = -1;
+	added->last_resize[1] = -1;
+	return added;
+}
+
+// Marks superseded events in the batch as SDL_FIRSTEVENT so dispatch skips them
+static void __acgl_ih_pump_coalesce(ACGL_ih_pump_t* pump, SDL_Event* batch, int size) {
+	__acgl_ih_pump_window_t windows[ACGL_IH_PUMP_WINDOWS];
+	int windows_size = 0;
+
+	for (int i=0; i<size; ++i) {
+		SDL_Event* event = &batch[i];
+		__acgl_ih_pump_window_t* window;
+
+		if (event->type != SDL_MOUSEMOTION) {
+			// motion on either side of a click, key press or anything else
+			// has to stay apart, or it would be seen at the wrong time
+			for (int w=0; w<windows_size; ++w) {
+				windows[w].last_motion = -1;
+			}
+		}
+
+		switch (event->type) {
+		case SDL_MOUSEMOTION:
+			if (!pump->coalesce_motion || (window = __acgl_ih_pump_window(windows, &windows_size, event->motion.windowID)) == NULL) {
+				break;
+			}
+			if (window->last_motion >= 0) {
+				// fold the older motion into this one so relative movement isn't lost
+				SDL_Event* older = &batch[window->last_motion];
+				event->motion.xrel += older->motion.xrel;
+				event->motion.yrel += older->motion.yrel;
+				older->type = SDL_FIRSTEVENT;
+			}
+			window->last_motion = i;
+			break;
+		case SDL_WINDOWEVENT:
+			if (!pump->coalesce_resize || (event->window.event != SDL_WINDOWEVENT_RESIZED && event->window.event != SDL_WINDOWEVENT_SIZE_CHANGED)) {
+				break;
+			}
+			if ((window = __acgl_ih_pump_window(windows, &windows_size, event->window.windowID)) == NULL) {
+				break;
+			}
+			int* last = &window->last_resize[event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED];
+			if (*last >= 0) {
+				batch[*last].type = SDL_FIRSTEVENT;
+			}
+			*last = i;
+			break;
+		}
+	}
+}
+
+void ACGL_ih_pump_dispatch(ACGL_ih_pump_t* pump, const SDL_Event* event) {
+	if (event->type == SDL_QUIT) {
+		pump->quit_requested = true;
+	}
+	if (pump->actions != NULL && (event->type == SDL_KEYDOWN || event->type == SDL_KEYUP)) {
+		ACGL_ih_actions_handle_event(pump->actions, event);
+	}
+
+	ACGL_ih_event_handler_t* page = pump->handlers[(event->type >> 8) & 0xFF];
+	if (page != NULL && page[event->type & 0xFF].callback != NULL) {
+		(*page[event->type & 0xFF].callback)(event, page[event->type & 0xFF].data);
+		return;
+	}
+	switch (event->type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		if (pump->keybinds != NULL && pump->medata != NULL) {
+			ACGL_ih_handle_keyevent(event, pump->keybinds, pump->medata);
+		}
+		break;
+	case SDL_WINDOWEVENT:
+		if (pump->medata != NULL) {
+			ACGL_ih_handle_windowevent(event, pump->medata);
+		}
+		break;
+	}
+}
+
+int ACGL_ih_pump(ACGL_ih_pump_t* pump) {
+	int dispatched = 0;
+	int size;
+
+	if (pump->recorder != NULL) {
+		ACGL_ih_recorder_frame(pump->recorder, ACGL_clock_now());
+	}
+
+	SDL_PumpEvents();
+	do {
+		size = SDL_PeepEvents(pump->batch, ACGL_IH_PUMP_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+		if (size < 0) {
+			fprintf(stderr, "Error! could not get events in ACGL_ih_pump. SDL_Error: %s\n", SDL_GetError());
+			break;
+		}
+		__acgl_ih_pump_coalesce(pump, pump->batch, size);
+
+		for (int i=0; i<size; ++i) {
+			const SDL_Event* event = &pump->batch[i];
+			if (event->type == SDL_FIRSTEVENT) {
+				// coalesced away
+				continue;
+			}
+			++dispatched;
+			if (pump->recorder != NULL) {
+				ACGL_ih_recorder_write(pump->recorder, event);
+			}
+			ACGL_ih_pump_dispatch(pump, event);
+		}
+	} while (size == ACGL_IH_PUMP_BATCH);
+
+	return dispatched;
 }
@@ -0,0 +1,445 @@
+#include "inputrecord.h"
+#include "inputstate.h"
+#include "alloc.h"
+#include "clock.h"
+#include <string.h>
+
+// Every record starts with the event type; type 0 (SDL_FIRSTEVENT, which SDL
+// never sends) marks the start of a frame and is followed by the time since
+// the previous frame in microseconds
+#define ACGL_IH_RECORD_FRAME SDL_FIRSTEVENT
+// Longest encoded record, flushed ahead of so a record never straddles a flush
+#define ACGL_IH_RECORD_MAX (16 * 5 + sizeof(SDL_Event))
+// Longest dropped file name or text kept, which is also written in pieces
+#define ACGL_IH_RECORD_MAX_DROP (1 << 24)
+
+static void __acgl_ih_put_varint(ACGL_ih_recorder_t* recorder, Uint64 value) {
+	while (value >= 0x80) {
+		recorder->buffer[recorder->buffer_size++] = (Uint8)(value | 0x80);
+		value >>= 7;
+	}
+	recorder->buffer[recorder->buffer_size++] = (Uint8)value;
+}
+
+// zigzag so small negative numbers stay small
+static void __acgl_ih_put_signed(ACGL_ih_recorder_t* recorder, Sint32 value) {
+	__acgl_ih_put_varint(recorder, (Uint32)((Uint32)value << 1) ^ (Uint32)(value >> 31));
+}
+
+int ACGL_ih_recorder_flush(ACGL_ih_recorder_t* recorder) {
+	if (recorder->failed) {
+		return -1;
+	}
+	if (recorder->buffer_size > 0 && SDL_RWwrite(recorder->out, recorder->buffer, recorder->buffer_size, 1) != 1) {
+		fprintf(stderr, "Error! could not write input log in ACGL_ih_recorder_flush. SDL_Error: %s\n", SDL_GetError());
+		recorder->failed = true;
+		return -1;
+	}
+	recorder->buffer_size = 0;
+	return 0;
+}
+
+// For strings longer than a record, flushes as often as it takes.
+// Returns: false if the log couldn't be written
+static bool __acgl_ih_put_bytes(ACGL_ih_recorder_t* recorder, const char* bytes, size_t length) {
+	while (length > 0) {
+		if (recorder->buffer_size == ACGL_IH_RECORD_BUFFER && ACGL_ih_recorder_flush(recorder) != 0) {
+			return false;
+		}
+		size_t part = SDL_min(length, ACGL_IH_RECORD_BUFFER - recorder->buffer_size);
+		memcpy(&recorder->buffer[recorder->buffer_size], bytes, part);
+		recorder->buffer_size += part;
+		bytes += part;
+		length -= part;
+	}
+	return true;
+}
+
+// Makes room for one record. Returns: false if nothing can be recorded
+static bool __acgl_ih_recorder_reserve(ACGL_ih_recorder_t* recorder) {
+	if (recorder->buffer_size + ACGL_IH_RECORD_MAX > ACGL_IH_RECORD_BUFFER) {
+		return ACGL_ih_recorder_flush(recorder) == 0;
+	}
+	return !recorder->failed;
+}
+
+ACGL_ih_recorder_t* ACGL_ih_recorder_create(SDL_RWops* out) {
+	if (out == NULL) {
+		fprintf(stderr, "Error! NULL SDL_RWops in ACGL_ih_recorder_create\n");
+		return NULL;
+	}
+	ACGL_ih_recorder_t* recorder = (ACGL_ih_recorder_t*)ACGL_malloc(ACGL_ALLOC_INPUT, sizeof(ACGL_ih_recorder_t));
+	if (recorder == NULL) {
+		fprintf(stderr, "Error! could not malloc recorder in ACGL_ih_recorder_create\n");
+		return NULL;
+	}
+	recorder->out = out;
+	recorder->last_frame = 0;
+	recorder->failed = false;
+	recorder->frames = 0;
+	recorder->events = 0;
+	recorder->buffer_size = 0;
+
+	memcpy(recorder->buffer, ACGL_IH_RECORD_MAGIC, sizeof(ACGL_IH_RECORD_MAGIC) - 1);
+	recorder->buffer_size = sizeof(ACGL_IH_RECORD_MAGIC) - 1;
+	recorder->buffer[recorder->buffer_size++] = ACGL_IH_RECORD_VERSION;
+	if (ACGL_ih_recorder_flush(recorder) != 0) {
+		ACGL_free(recorder);
+		return NULL;
+	}
+	return recorder;
+}
+
+void ACGL_ih_recorder_destroy(ACGL_ih_recorder_t* recorder) {
+	if (recorder == NULL) {
+		fprintf(stderr, "Error! cannot destroy NULL pointer in ACGL_ih_recorder_destroy\n");
+		return;
+	}
+	ACGL_ih_recorder_flush(recorder);
+	ACGL_free(recorder);
+}
+
+int ACGL_ih_recorder_frame(ACGL_ih_recorder_t* recorder, Uint64 now) {
+	if (!__acgl_ih_recorder_reserve(recorder)) {
+		return -1;
+	}
+	Uint64 elapsed = recorder->last_frame != 0 && now > recorder->last_frame ? now - recorder->last_frame : 0;
+	recorder->last_frame = now;
+	__acgl_ih_put_varint(recorder, ACGL_IH_RECORD_FRAME);
+	__acgl_ih_put_varint(recorder, elapsed / ACGL_CLOCK_NS_PER_US);
+	++recorder->frames;
+	return 0;
+}
+
+int ACGL_ih_recorder_write(ACGL_ih_recorder_t* recorder, const SDL_Event* event) {
+	if (event->type == ACGL_IH_RECORD_FRAME) {
+		// can't be told apart from a frame marker, and SDL never sends it anyway
+		return 0;
+	}
+	if (!__acgl_ih_recorder_reserve(recorder)) {
+		return -1;
+	}
+
+	__acgl_ih_put_varint(recorder, event->type);
+	__acgl_ih_put_varint(recorder, event->common.timestamp);
+	switch (event->type) {
+	case SDL_QUIT:
+		break;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		__acgl_ih_put_varint(recorder, event->key.windowID);
+		__acgl_ih_put_varint(recorder, event->key.state);
+		__acgl_ih_put_varint(recorder, event->key.repeat);
+		__acgl_ih_put_varint(recorder, (Uint32)event->key.keysym.scancode);
+		__acgl_ih_put_varint(recorder, (Uint32)event->key.keysym.sym);
+		__acgl_ih_put_varint(recorder, event->key.keysym.mod);
+		break;
+	case SDL_MOUSEMOTION:
+		__acgl_ih_put_varint(recorder, event->motion.windowID);
+		__acgl_ih_put_varint(recorder, event->motion.which);
+		__acgl_ih_put_varint(recorder, event->motion.state);
+		__acgl_ih_put_signed(recorder, event->motion.x);
+		__acgl_ih_put_signed(recorder, event->motion.y);
+		__acgl_ih_put_signed(recorder, event->motion.xrel);
+		__acgl_ih_put_signed(recorder, event->motion.yrel);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		__acgl_ih_put_varint(recorder, event->button.windowID);
+		__acgl_ih_put_varint(recorder, event->button.which);
+		__acgl_ih_put_varint(recorder, event->button.button);
+		__acgl_ih_put_varint(recorder, event->button.state);
+		__acgl_ih_put_varint(recorder, event->button.clicks);
+		__acgl_ih_put_signed(recorder, event->button.x);
+		__acgl_ih_put_signed(recorder, event->button.y);
+		break;
+	case SDL_MOUSEWHEEL:
+		__acgl_ih_put_varint(recorder, event->wheel.windowID);
+		__acgl_ih_put_varint(recorder, event->wheel.which);
+		__acgl_ih_put_signed(recorder, event->wheel.x);
+		__acgl_ih_put_signed(recorder, event->wheel.y);
+		__acgl_ih_put_varint(recorder, event->wheel.direction);
+		break;
+	case SDL_WINDOWEVENT:
+		__acgl_ih_put_varint(recorder, event->window.windowID);
+		__acgl_ih_put_varint(recorder, event->window.event);
+		__acgl_ih_put_signed(recorder, event->window.data1);
+		__acgl_ih_put_signed(recorder, event->window.data2);
+		break;
+	case SDL_TEXTINPUT: {
+		__acgl_ih_put_varint(recorder, event->text.windowID);
+		size_t length = strnlen(event->text.text, sizeof(event->text.text));
+		__acgl_ih_put_varint(recorder, length);
+		memcpy(&recorder->buffer[recorder->buffer_size], event->text.text, length);
+		recorder->buffer_size += length;
+		break;
+	}
+	case SDL_DROPFILE:
+	case SDL_DROPTEXT:
+	case SDL_DROPBEGIN:
+	case SDL_DROPCOMPLETE: {
+		// the handler frees file, so replay needs a copy of its own. The
+		// length is stored plus one, 0 meaning there is no file
+		__acgl_ih_put_varint(recorder, event->drop.windowID);
+		size_t length = event->drop.file != NULL ? SDL_min(strlen(event->drop.file), ACGL_IH_RECORD_MAX_DROP) : 0;
+		__acgl_ih_put_varint(recorder, event->drop.file != NULL ? length + 1 : 0);
+		if (!__acgl_ih_put_bytes(recorder, event->drop.file, length)) {
+			return -1;
+		}
+		break;
+	}
+	default:
+		if (event->type >= SDL_USEREVENT) {
+			// data1 and data2 point into this session, only the code is kept
+			__acgl_ih_put_varint(recorder, event->user.windowID);
+			__acgl_ih_put_signed(recorder, event->user.code);
+			break;
+		}
+		// anything else is kept whole
+		__acgl_ih_put_varint(recorder, sizeof(SDL_Event));
+		memcpy(&recorder->buffer[recorder->buffer_size], event, sizeof(SDL_Event));
+		recorder->buffer_size += sizeof(SDL_Event);
+		break;
+	}
+	++recorder->events;
+	return 0;
+}
+
+ACGL_ih_replayer_t* ACGL_ih_replayer_create(SDL_RWops* in, int mode) {
+	if (in == NULL) {
+		fprintf(stderr, "Error! NULL SDL_RWops in ACGL_ih_replayer_create\n");
+		return NULL;
+	}
+	ACGL_ih_replayer_t* replayer = (ACGL_ih_replayer_t*)ACGL_malloc(ACGL_ALLOC_INPUT, sizeof(ACGL_ih_replayer_t));
+	if (replayer == NULL) {
+		fprintf(stderr, "Error! could not malloc replayer in ACGL_ih_replayer_create\n");
+		return NULL;
+	}
+	replayer->in = in;
+	replayer->mode = mode;
+	replayer->start = 0;
+	replayer->frame_time = 0;
+	replayer->started = false;
+	replayer->finished = false;
+	replayer->frames = 0;
+	replayer->events = 0;
+	replayer->buffer_pos = 0;
+	replayer->buffer_size = 0;
+
+	Uint8 header[sizeof(ACGL_IH_RECORD_MAGIC)];
+	if (SDL_RWread(in, header, sizeof(header), 1) != 1
+	    || memcmp(header, ACGL_IH_RECORD_MAGIC, sizeof(ACGL_IH_RECORD_MAGIC) - 1) != 0) {
+		fprintf(stderr, "Error! not an input log in ACGL_ih_replayer_create\n");
+		ACGL_free(replayer);
+		return NULL;
+	}
+	if (header[sizeof(ACGL_IH_RECORD_MAGIC) - 1] != ACGL_IH_RECORD_VERSION) {
+		fprintf(stderr, "Error! input log version %d is not supported in ACGL_ih_replayer_create\n", header[sizeof(ACGL_IH_RECORD_MAGIC) - 1]);
+		ACGL_free(replayer);
+		return NULL;
+	}
+	return replayer;
+}
+
+void ACGL_ih_replayer_destroy(ACGL_ih_replayer_t* replayer) {
+	if (replayer == NULL) {
+		fprintf(stderr, "Error! cannot destroy NULL pointer in ACGL_ih_replayer_destroy\n");
+		return;
+	}
+	ACGL_free(replayer);
+}
+
+// Returns: false at the end of the log
+static bool __acgl_ih_get_byte(ACGL_ih_replayer_t* replayer, Uint8* byte) {
+	if (replayer->buffer_pos == replayer->buffer_size) {
+		replayer->buffer_pos = 0;
+		replayer->buffer_size = SDL_RWread(replayer->in, replayer->buffer, 1, ACGL_IH_RECORD_BUFFER);
+		if (replayer->buffer_size == 0) {
+			return false;
+		}
+	}
+	*byte = replayer->buffer[replayer->buffer_pos++];
+	return true;
+}
+
+static bool __acgl_ih_get_varint(ACGL_ih_replayer_t* replayer, Uint64* value) {
+	*value = 0;
+	for (int shift=0; shift<64; shift+=7) {
+		Uint8 byte;
+		if (!__acgl_ih_get_byte(replayer, &byte)) {
+			return false;
+		}
+		*value |= (Uint64)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool __acgl_ih_get_bytes(ACGL_ih_replayer_t* replayer, void* out, size_t length) {
+	Uint8* bytes = (Uint8*)out;
+	for (size_t i=0; i<length; ++i) {
+		if (!__acgl_ih_get_byte(replayer, &bytes[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Reads the fields of an event whose type was already read
+static bool __acgl_ih_get_event(ACGL_ih_replayer_t* replayer, Uint32 type, SDL_Event* event) {
+	// a failed read leaves a field at zero, which is caught by returning false below
+	Uint64 v[7] = {0};
+	#define __ACGL_GET(n) __acgl_ih_get_varint(replayer, &v[n])
+	#define __ACGL_SIGNED(n) ((Sint32)((Uint32)(v[n] >> 1) ^ (Uint32)-(Sint32)(v[n] & 1)))
+
+	memset(event, 0, sizeof(SDL_Event));
+	event->type = type;
+	bool ok = __ACGL_GET(0);
+	event->common.timestamp = (Uint32)v[0];
+
+	switch (type) {
+	case SDL_QUIT:
+		break;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && __ACGL_GET(2) && __ACGL_GET(3) && __ACGL_GET(4) && __ACGL_GET(5);
+		event->key.windowID = (Uint32)v[0];
+		event->key.state = (Uint8)v[1];
+		event->key.repeat = (Uint8)v[2];
+		event->key.keysym.scancode = (SDL_Scancode)v[3];
+		event->key.keysym.sym = (SDL_Keycode)v[4];
+		event->key.keysym.mod = (Uint16)v[5];
+		break;
+	case SDL_MOUSEMOTION:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && __ACGL_GET(2) && __ACGL_GET(3) && __ACGL_GET(4) && __ACGL_GET(5) && __ACGL_GET(6);
+		event->motion.windowID = (Uint32)v[0];
+		event->motion.which = (Uint32)v[1];
+		event->motion.state = (Uint32)v[2];
+		event->motion.x = __ACGL_SIGNED(3);
+		event->motion.y = __ACGL_SIGNED(4);
+		event->motion.xrel = __ACGL_SIGNED(5);
+		event->motion.yrel = __ACGL_SIGNED(6);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && __ACGL_GET(2) && __ACGL_GET(3) && __ACGL_GET(4) && __ACGL_GET(5) && __ACGL_GET(6);
+		event->button.windowID = (Uint32)v[0];
+		event->button.which = (Uint32)v[1];
+		event->button.button = (Uint8)v[2];
+		event->button.state = (Uint8)v[3];
+		event->button.clicks = (Uint8)v[4];
+		event->button.x = __ACGL_SIGNED(5);
+		event->button.y = __ACGL_SIGNED(6);
+		break;
+	case SDL_MOUSEWHEEL:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && __ACGL_GET(2) && __ACGL_GET(3) && __ACGL_GET(4);
+		event->wheel.windowID = (Uint32)v[0];
+		event->wheel.which = (Uint32)v[1];
+		event->wheel.x = __ACGL_SIGNED(2);
+		event->wheel.y = __ACGL_SIGNED(3);
+		event->wheel.direction = (Uint32)v[4];
+		break;
+	case SDL_WINDOWEVENT:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && __ACGL_GET(2) && __ACGL_GET(3);
+		event->window.windowID = (Uint32)v[0];
+		event->window.event = (Uint8)v[1];
+		event->window.data1 = __ACGL_SIGNED(2);
+		event->window.data2 = __ACGL_SIGNED(3);
+		break;
+	case SDL_TEXTINPUT:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && v[1] < sizeof(event->text.text);
+		event->text.windowID = (Uint32)v[0];
+		ok = ok && __acgl_ih_get_bytes(replayer, event->text.text, (size_t)v[1]);
+		break;
+	case SDL_DROPFILE:
+	case SDL_DROPTEXT:
+	case SDL_DROPBEGIN:
+	case SDL_DROPCOMPLETE:
+		ok = ok && __ACGL_GET(0) && __ACGL_GET(1) && v[1] <= ACGL_IH_RECORD_MAX_DROP + 1;
+		event->drop.windowID = (Uint32)v[0];
+		if (ok && v[1] > 0) {
+			// freed by whoever handles the event, like SDL's own
+			char* file = (char*)SDL_malloc((size_t)v[1]);
+			ok = file != NULL && __acgl_ih_get_bytes(replayer, file, (size_t)v[1] - 1);
+			if (!ok) {
+				SDL_free(file);
+				break;
+			}
+			file[v[1] - 1] = '\0';
+			event->drop.file = file;
+		}
+		break;
+	default:
+		if (type >= SDL_USEREVENT) {
+			ok = ok && __ACGL_GET(0) && __ACGL_GET(1);
+			event->user.windowID = (Uint32)v[0];
+			event->user.code = __ACGL_SIGNED(1);
+			break;
+		}
+		ok = ok && __ACGL_GET(1) && v[1] == sizeof(SDL_Event) && __acgl_ih_get_bytes(replayer, event, sizeof(SDL_Event));
+		if (type == SDL_SYSWMEVENT) {
+			// points into the recording session
+			event->syswm.msg = NULL;
+		}
+		break;
+	}
+
+	#undef __ACGL_GET
+	#undef __ACGL_SIGNED
+	return ok;
+}
+
+int ACGL_ih_replay_frame(ACGL_ih_replayer_t* replayer, ACGL_ih_pump_t* pump) {
+	if (replayer->finished) {
+		return -1;
+	}
+
+	Uint64 now = ACGL_clock_now();
+	Uint64 value;
+	if (!replayer->started) {
+		// the log starts with a frame marker, which carries no time
+		if (!__acgl_ih_get_varint(replayer, &value) || value != ACGL_IH_RECORD_FRAME || !__acgl_ih_get_varint(replayer, &value)) {
+			replayer->finished = true;
+			return -1;
+		}
+		replayer->started = true;
+		replayer->start = now;
+		if (pump->actions != NULL) {
+			// the keyboard isn't what is being replayed, nothing is held yet
+			memset(pump->actions->keys, 0, sizeof(pump->actions->keys));
+			pump->actions->keys_from_events = true;
+		}
+	}
+	if (replayer->mode == ACGL_IH_REPLAY_REALTIME && now - replayer->start < replayer->frame_time) {
+		// not due yet
+		return 0;
+	}
+
+	// dispatch until the next frame marker, which we hold on to
+	int dispatched = 0;
+	SDL_Event event;
+	while (__acgl_ih_get_varint(replayer, &value)) {
+		if (value == ACGL_IH_RECORD_FRAME) {
+			if (!__acgl_ih_get_varint(replayer, &value)) {
+				break;
+			}
+			replayer->frame_time += value * ACGL_CLOCK_NS_PER_US;
+			++replayer->frames;
+			return dispatched;
+		}
+		if (!__acgl_ih_get_event(replayer, (Uint32)value, &event)) {
+			fprintf(stderr, "Error! corrupt input log in ACGL_ih_replay_frame\n");
+			break;
+		}
+		ACGL_ih_pump_dispatch(pump, &event);
+		++replayer->events;
+		++dispatched;
+	}
+
+	// ran out of log, this frame is still real
+	replayer->finished = true;
+	++replayer->frames;
+	return dispatched;
+}
@@ -0,0 +1,221 @@
+#include "inputstate.h"
+#include "alloc.h"
+#include <string.h>
+
+ACGL_ih_actions_t* ACGL_ih_actions_create(ACGL_ih_keybinds_t* keybinds) {
+	if (keybinds == NULL) {
+		fprintf(stderr, "Error! NULL keybinds in ACGL_ih_actions_create\n");
+		return NULL;
+	}
+	ACGL_ih_actions_t* actions = (ACGL_ih_actions_t*)ACGL_calloc(ACGL_ALLOC_INPUT, 1, sizeof(ACGL_ih_actions_t));
+	if (actions == NULL) {
+		fprintf(stderr, "Error! could not malloc actions in ACGL_ih_actions_create\n");
+		return NULL;
+	}
+	actions->keybinds = keybinds;
+	return actions;
+}
+
+void ACGL_ih_actions_destroy(ACGL_ih_actions_t* actions) {
+	if (actions == NULL) {
+		fprintf(stderr, "Error! cannot destroy NULL pointer in ACGL_ih_actions_destroy\n");
+		return;
+	}
+	for (int i=0; i<actions->subscribers_size; ++i) {
+		ACGL_snapshot_destroy(actions->subscribers[i]);
+		actions->subscribers[i] = NULL;
+	}
+	ACGL_free(actions);
+}
+
+static ACGL_ih_combo_t* __acgl_ih_add_combo(ACGL_ih_actions_t* actions, const Uint16 steps[], int length, const char* caller) {
+	if (actions->combos_size == ACGL_IH_MAX_COMBOS) {
+		fprintf(stderr, "Error! no more than %d combos in %s\n", ACGL_IH_MAX_COMBOS, caller);
+		return NULL;
+	}
+	if (length < 1 || length > ACGL_IH_MAX_COMBO_LENGTH) {
+		fprintf(stderr, "Error! combo length %d is out-of-bounds in %s\n", length, caller);
+		return NULL;
+	}
+	for (int i=0; i<length; ++i) {
+		if (steps[i] >= ACGL_IH_MAX_ACTIONS) {
+			fprintf(stderr, "Error! action %d is out-of-bounds in %s\n", steps[i], caller);
+			return NULL;
+		}
+	}
+
+	ACGL_ih_combo_t* combo = &actions->combos[actions->combos_size++];
+	memset(combo, 0, sizeof(ACGL_ih_combo_t));
+	combo->length = (Uint8)length;
+	for (int i=0; i<length; ++i) {
+		combo->actions[i] = steps[i];
+		combo->mask[steps[i] >> 6] |= (Uint64)1 << (steps[i] & 63);
+	}
+	return combo;
+}
+
+int ACGL_ih_actions_add_chord(ACGL_ih_actions_t* actions, const Uint16 chord[], int length) {
+	ACGL_ih_combo_t* combo = __acgl_ih_add_combo(actions, chord, length, "ACGL_ih_actions_add_chord");
+	if (combo == NULL) {
+		return -1;
+	}
+	combo->kind = ACGL_IH_COMBO_CHORD;
+	return actions->combos_size - 1;
+}
+
+int ACGL_ih_actions_add_sequence(ACGL_ih_actions_t* actions, const Uint16 sequence[], int length, Uint64 timeout_ns) {
+	ACGL_ih_combo_t* combo = __acgl_ih_add_combo(actions, sequence, length, "ACGL_ih_actions_add_sequence");
+	if (combo == NULL) {
+		return -1;
+	}
+	combo->kind = ACGL_IH_COMBO_SEQUENCE;
+	combo->timeout = timeout_ns;
+	return actions->combos_size - 1;
+}
+
+// Sets the bits of every action bound to scancode. Call while counted in as a keymap reader
+static void __acgl_ih_actions_mark(const ACGL_ih_keymap_t* keymap, SDL_Scancode scancode, Uint64 bits[]) {
+	for (Uint32 i=keymap->offsets[scancode]; i<keymap->offsets[scancode + 1]; ++i) {
+		Uint16 action = keymap->actions[i];
+		if (action < ACGL_IH_MAX_ACTIONS) {
+			bits[action >> 6] |= (Uint64)1 << (action & 63);
+		}
+	}
+}
+
+void ACGL_ih_actions_handle_event(ACGL_ih_actions_t* actions, const SDL_Event* event) {
+	if ((event->type != SDL_KEYDOWN && event->type != SDL_KEYUP) || (unsigned)event->key.keysym.scancode >= SDL_NUM_SCANCODES) {
+		return;
+	}
+	actions->keys[event->key.keysym.scancode] = event->type == SDL_KEYDOWN;
+	if (event->type != SDL_KEYDOWN || event->key.repeat) {
+		return;
+	}
+	ACGL_ih_keybinds_t* keybinds = actions->keybinds;
+	SDL_AtomicAdd(&keybinds->readers, 1);
+	const ACGL_ih_keymap_t* keymap = (const ACGL_ih_keymap_t*)SDL_AtomicGetPtr((void**)&keybinds->keymap);
+	__acgl_ih_actions_mark(keymap, event->key.keysym.scancode, actions->tapped);
+	SDL_AtomicAdd(&keybinds->readers, -1);
+}
+
+static bool __acgl_ih_bit(const Uint64 bits[], Uint16 action) {
+	return (bits[action >> 6] >> (action & 63)) & 1;
+}
+
+static void __acgl_ih_actions_combos(ACGL_ih_actions_t* actions, Uint64 now) {
+	ACGL_ih_action_state_t* state = &actions->state;
+	bool any_pressed = false;
+	for (int w=0; w<ACGL_IH_ACTION_WORDS; ++w) {
+		any_pressed |= state->pressed[w] != 0;
+	}
+
+	Uint64 held = 0;
+	Uint64 fired = 0;
+	for (int c=0; c<actions->combos_size; ++c) {
+		ACGL_ih_combo_t* combo = &actions->combos[c];
+		Uint64 bit = (Uint64)1 << c;
+
+		if (combo->kind == ACGL_IH_COMBO_CHORD) {
+			bool all = true;
+			for (int w=0; w<ACGL_IH_ACTION_WORDS; ++w) {
+				all &= (state->held[w] & combo->mask[w]) == combo->mask[w];
+			}
+			if (all) {
+				held |= bit;
+				if (!(state->combos_held & bit)) {
+					fired |= bit;
+				}
+			}
+			continue;
+		}
+
+		// sequences: advance on the expected press, start over on anything else
+		if (combo->progress > 0 && now - combo->last > combo->timeout) {
+			combo->progress = 0;
+		}
+		if (!any_pressed) {
+			continue;
+		}
+		if (__acgl_ih_bit(state->pressed, combo->actions[combo->progress])) {
+			++combo->progress;
+			combo->last = now;
+			if (combo->progress == combo->length) {
+				fired |= bit;
+				combo->progress = 0;
+			}
+		} else {
+			combo->progress = __acgl_ih_bit(state->pressed, combo->actions[0]) ? 1 : 0;
+			combo->last = now;
+		}
+	}
+
+	state->combos_held = held;
+	state->combos_fired = fired;
+	for (int c=0; c<actions->combos_size; ++c) {
+		if ((fired >> c) & 1) {
+			++state->combo_fires[c];
+		}
+	}
+}
+
+const ACGL_ih_action_state_t* ACGL_ih_actions_update(ACGL_ih_actions_t* actions, Uint64 now) {
+	ACGL_ih_action_state_t* state = &actions->state;
+
+	Uint64 held[ACGL_IH_ACTION_WORDS] = {0};
+	int keys_size = SDL_NUM_SCANCODES;
+	const Uint8* keys = actions->keys_from_events ? actions->keys : SDL_GetKeyboardState(&keys_size);
+	if (keys_size > SDL_NUM_SCANCODES) {
+		keys_size = SDL_NUM_SCANCODES;
+	}
+
+	ACGL_ih_keybinds_t* keybinds = actions->keybinds;
+	SDL_AtomicAdd(&keybinds->readers, 1);
+	const ACGL_ih_keymap_t* keymap = (const ACGL_ih_keymap_t*)SDL_AtomicGetPtr((void**)&keybinds->keymap);
+	for (int s=0; s<keys_size; ++s) {
+		if (keys[s]) {
+			__acgl_ih_actions_mark(keymap, (SDL_Scancode)s, held);
+		}
+	}
+	SDL_AtomicAdd(&keybinds->readers, -1);
+
+	for (int w=0; w<ACGL_IH_ACTION_WORDS; ++w) {
+		Uint64 before = state->held[w];
+		// a tap that came and went since the last update is pressed and released at once
+		Uint64 pressed = (held[w] | actions->tapped[w]) & ~before;
+		state->pressed[w] = pressed;
+		state->released[w] = (before & ~held[w]) | (pressed & ~held[w]);
+		state->held[w] = held[w];
+		actions->tapped[w] = 0;
+
+		while (pressed != 0) {
+			int bit = __builtin_ctzll(pressed);
+			++state->presses[w * 64 + bit];
+			pressed &= pressed - 1;
+		}
+	}
+	state->frame++;
+	state->time = now;
+	__acgl_ih_actions_combos(actions, now);
+
+	for (int i=0; i<actions->subscribers_size; ++i) {
+		memcpy(ACGL_snapshot_write_buffer(actions->subscribers[i]), state, sizeof(ACGL_ih_action_state_t));
+		ACGL_snapshot_publish(actions->subscribers[i]);
+	}
+	return state;
+}
+
+ACGL_snapshot_t* ACGL_ih_actions_subscribe(ACGL_ih_actions_t* actions) {
+	if (actions->subscribers_size == ACGL_IH_MAX_SUBSCRIBERS) {
+		fprintf(stderr, "Error! no more than %d subscribers in ACGL_ih_actions_subscribe\n", ACGL_IH_MAX_SUBSCRIBERS);
+		return NULL;
+	}
+	ACGL_snapshot_t* snapshot = ACGL_snapshot_create(sizeof(ACGL_ih_action_state_t));
+	if (snapshot == NULL) {
+		return NULL;
+	}
+	// start readers off with the current state instead of zeroes
+	memcpy(ACGL_snapshot_write_buffer(snapshot), &actions->state, sizeof(ACGL_ih_action_state_t));
+	ACGL_snapshot_publish(snapshot);
+	actions->subscribers[actions->subscribers_size++] = snapshot;
+	return snapshot;
+}
@@ -0,0 +1,405 @@
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define ACGL_LAYOUT_MMAP
+#endif
+
+#include "layout.h"
+#include "alloc.h"
+#include "contracts.h"
+#include <string.h>
+
+enum ACGL_LAYOUT_BACKING {
+	ACGL_LAYOUT_BACKING_USER, // caller's memory
+	ACGL_LAYOUT_BACKING_MAP,  // mapped file
+	ACGL_LAYOUT_BACKING_HEAP, // read into an ACGL_malloc buffer, where mapping isn't available
+};
+
+// FNV-1a
+static Uint32 __acgl_layout_hash(const char* name, size_t length) {
+	Uint32 hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ (Uint8)name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// Checks everything instantiate relies on, so it doesn't have to
+static bool __acgl_layout_check(ACGL_layout_t* layout) {
+	const Uint8* data = (const Uint8*)layout->data;
+	size_t size = layout->size;
+	if (((size_t)data & 3) != 0) {
+		fprintf(stderr, "Error! layout data is not 4-byte aligned in __acgl_layout_check\n");
+		return false;
+	}
+	if (size < sizeof(ACGL_layout_header_t)) {
+		fprintf(stderr, "Error! layout is too short in __acgl_layout_check\n");
+		return false;
+	}
+	const ACGL_layout_header_t* header = (const ACGL_layout_header_t*)data;
+	if (memcmp(header->magic, ACGL_LAYOUT_MAGIC, sizeof(header->magic)) != 0) {
+		fprintf(stderr, "Error! not a layout file in __acgl_layout_check\n");
+		return false;
+	}
+	if (header->version != ACGL_LAYOUT_VERSION) {
+		fprintf(stderr, "Error! unsupported layout version %d in __acgl_layout_check\n", header->version);
+		return false;
+	}
+#if SDL_BYTEORDER != SDL_LIL_ENDIAN
+	fprintf(stderr, "Error! layouts can only be read on little-endian machines in __acgl_layout_check\n");
+	return false;
+#endif
+	Uint64 expected = sizeof(ACGL_layout_header_t)
+		+ (Uint64)header->node_count * sizeof(ACGL_layout_node_t)
+		+ (Uint64)header->callback_count * sizeof(ACGL_layout_symbol_t)
+		+ header->strings_size;
+	if (header->node_count == 0 || expected > size) {
+		fprintf(stderr, "Error! layout is truncated in __acgl_layout_check\n");
+		return false;
+	}
+
+	layout->header = header;
+	layout->nodes = (const ACGL_layout_node_t*)(data + sizeof(ACGL_layout_header_t));
+	layout->callbacks = (const ACGL_layout_symbol_t*)(layout->nodes + header->node_count);
+	layout->strings = (const char*)(layout->callbacks + header->callback_count);
+
+	for (Uint32 i = 0; i < header->callback_count; ++i) {
+		const ACGL_layout_symbol_t* symbol = &layout->callbacks[i];
+		if ((Uint64)symbol->offset + symbol->length > header->strings_size) {
+			fprintf(stderr, "Error! callback name %u is out of bounds in __acgl_layout_check\n", i);
+			return false;
+		}
+	}
+	// the child counts have to describe exactly one tree of node_count nodes:
+	// each node fills one open child slot and opens child_count new ones
+	Uint64 open = 1;
+	for (Uint32 i = 0; i < header->node_count; ++i) {
+		const ACGL_layout_node_t* node = &layout->nodes[i];
+		if (open == 0) {
+			fprintf(stderr, "Error! layout has more than one root in __acgl_layout_check\n");
+			return false;
+		}
+		if (node->callback != ACGL_LAYOUT_NO_CALLBACK && node->callback >= header->callback_count) {
+			fprintf(stderr, "Error! node %u uses unknown callback %u in __acgl_layout_check\n", i, node->callback);
+			return false;
+		}
+		open += (Uint64)node->child_count - 1;
+	}
+	if (open != 0) {
+		fprintf(stderr, "Error! layout tree is missing nodes in __acgl_layout_check\n");
+		return false;
+	}
+	return true;
+}
+
+static void __acgl_layout_release(ACGL_layout_t* layout) {
+	switch (layout->backing) {
+	case ACGL_LAYOUT_BACKING_MAP:
+#if defined(_WIN32)
+		UnmapViewOfFile(layout->data);
+		CloseHandle((HANDLE)layout->handle);
+#elif defined(ACGL_LAYOUT_MMAP)
+		munmap((void*)layout->data, layout->size);
+#endif
+		break;
+	case ACGL_LAYOUT_BACKING_HEAP:
+		ACGL_free((void*)layout->data);
+		break;
+	}
+}
+
+static ACGL_layout_t* __acgl_layout_create(const void* data, size_t size, int backing, void* handle) {
+	ACGL_layout_t* layout = (ACGL_layout_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_layout_t));
+	if (layout == NULL) {
+		fprintf(stderr, "Error! could not malloc layout in __acgl_layout_create\n");
+		ACGL_layout_t unused = { .data = data, .size = size, .backing = backing, .handle = handle };
+		__acgl_layout_release(&unused);
+		return NULL;
+	}
+	layout->data = data;
+	layout->size = size;
+	layout->backing = backing;
+	layout->handle = handle;
+	if (!__acgl_layout_check(layout)) {
+		__acgl_layout_release(layout);
+		ACGL_free(layout);
+		return NULL;
+	}
+	return layout;
+}
+
+ACGL_layout_t* ACGL_layout_open_memory(const void* data, size_t size) {
+	if (data == NULL) {
+		fprintf(stderr, "Error! NULL data in ACGL_layout_open_memory\n");
+		return NULL;
+	}
+	return __acgl_layout_create(data, size, ACGL_LAYOUT_BACKING_USER, NULL);
+}
+
+ACGL_layout_t* ACGL_layout_open(const char* path) {
+	REQUIRES(path != NULL);
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Error! could not open %s in ACGL_layout_open\n", path);
+		return NULL;
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	// the mapping keeps the file open
+	CloseHandle(file);
+	const void* data = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (data == NULL) {
+		fprintf(stderr, "Error! could not map %s in ACGL_layout_open\n", path);
+		if (mapping != NULL) {
+			CloseHandle(mapping);
+		}
+		return NULL;
+	}
+	return __acgl_layout_create(data, (size_t)size.QuadPart, ACGL_LAYOUT_BACKING_MAP, mapping);
+#elif defined(ACGL_LAYOUT_MMAP)
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Error! could not open %s in ACGL_layout_open\n", path);
+		return NULL;
+	}
+	struct stat info;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// the mapping keeps the file open
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Error! could not map %s in ACGL_layout_open\n", path);
+		return NULL;
+	}
+	return __acgl_layout_create(data, (size_t)info.st_size, ACGL_LAYOUT_BACKING_MAP, NULL);
+#else
+	SDL_RWops* file = SDL_RWFromFile(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Error! could not open %s in ACGL_layout_open. SDL_Error: %s\n", path, SDL_GetError());
+		return NULL;
+	}
+	Sint64 size = SDL_RWsize(file);
+	void* data = size > 0 ? ACGL_malloc(ACGL_ALLOC_GUI, (size_t)size) : NULL;
+	if (data == NULL || SDL_RWread(file, data, (size_t)size, 1) != 1) {
+		fprintf(stderr, "Error! could not read %s in ACGL_layout_open\n", path);
+		ACGL_free(data);
+		SDL_RWclose(file);
+		return NULL;
+	}
+	SDL_RWclose(file);
+	return __acgl_layout_create(data, (size_t)size, ACGL_LAYOUT_BACKING_HEAP, NULL);
+#endif
+}
+
+void ACGL_layout_close(ACGL_layout_t* layout) {
+	if (layout == NULL) {
+		return;
+	}
+	__acgl_layout_release(layout);
+	ACGL_free(layout);
+}
+
+ACGL_layout_registry_t* ACGL_layout_registry_create(void) {
+	ACGL_layout_registry_t* registry = (ACGL_layout_registry_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_layout_registry_t));
+	if (registry == NULL) {
+		fprintf(stderr, "Error! could not malloc registry in ACGL_layout_registry_create\n");
+		return NULL;
+	}
+	registry->size = 0;
+	registry->capacity = 32;
+	registry->entries = (ACGL_layout_entry_t*)ACGL_calloc(ACGL_ALLOC_GUI, registry->capacity, sizeof(ACGL_layout_entry_t));
+	if (registry->entries == NULL) {
+		fprintf(stderr, "Error! could not malloc registry entries in ACGL_layout_registry_create\n");
+		ACGL_free(registry);
+		return NULL;
+	}
+	return registry;
+}
+
+void ACGL_layout_registry_destroy(ACGL_layout_registry_t* registry) {
+	if (registry == NULL) {
+		return;
+	}
+	for (Uint32 i = 0; i < registry->capacity; ++i) {
+		ACGL_free(registry->entries[i].name);
+	}
+	ACGL_free(registry->entries);
+	ACGL_free(registry);
+}
+
+// Returns: the entry for name, or the empty slot it would go in
+static ACGL_layout_entry_t* __acgl_layout_find(ACGL_layout_entry_t* entries, Uint32 capacity, const char* name, size_t length, Uint32 hash) {
+	Uint32 mask = capacity - 1;
+	for (Uint32 i = hash & mask;; i = (i + 1) & mask) {
+		ACGL_layout_entry_t* entry = &entries[i];
+		if (entry->name == NULL) {
+			return entry;
+		}
+		if (entry->hash == hash && entry->length == length && memcmp(entry->name, name, length) == 0) {
+			return entry;
+		}
+	}
+}
+
+static bool __acgl_layout_registry_grow(ACGL_layout_registry_t* registry) {
+	Uint32 capacity = registry->capacity * 2;
+	ACGL_layout_entry_t* entries = (ACGL_layout_entry_t*)ACGL_calloc(ACGL_ALLOC_GUI, capacity, sizeof(ACGL_layout_entry_t));
+	if (entries == NULL) {
+		return false;
+	}
+	for (Uint32 i = 0; i < registry->capacity; ++i) {
+		ACGL_layout_entry_t* entry = &registry->entries[i];
+		if (entry->name != NULL) {
+			*__acgl_layout_find(entries, capacity, entry->name, entry->length, entry->hash) = *entry;
+		}
+	}
+	ACGL_free(registry->entries);
+	registry->entries = entries;
+	registry->capacity = capacity;
+	return true;
+}
+
+int ACGL_layout_register(ACGL_layout_registry_t* registry, const char* name, ACGL_render_callback_t render, void* data) {
+	REQUIRES(registry != NULL);
+	REQUIRES(name != NULL);
+	// stay at most half full so probes stay short
+	if ((registry->size + 1) * 2 > registry->capacity && !__acgl_layout_registry_grow(registry)) {
+		fprintf(stderr, "Error! could not grow registry in ACGL_layout_register\n");
+		return -1;
+	}
+	size_t length = strlen(name);
+	Uint32 hash = __acgl_layout_hash(name, length);
+	ACGL_layout_entry_t* entry = __acgl_layout_find(registry->entries, registry->capacity, name, length, hash);
+	if (entry->name == NULL) {
+		entry->name = (char*)ACGL_malloc(ACGL_ALLOC_GUI, length + 1);
+		if (entry->name == NULL) {
+			fprintf(stderr, "Error! could not malloc name in ACGL_layout_register\n");
+			return -1;
+		}
+		memcpy(entry->name, name, length + 1);
+		entry->length = (Uint32)length;
+		entry->hash = hash;
+		++registry->size;
+	}
+	entry->render = render;
+	entry->data = data;
+	return 0;
+}
+
+ACGL_gui_object_t* ACGL_layout_instantiate(ACGL_gui_t* gui, const ACGL_layout_t* layout, const ACGL_layout_registry_t* registry, ACGL_gui_object_t** nodes) {
+	REQUIRES(layout != NULL);
+	const ACGL_layout_header_t* header = layout->header;
+
+	// names are looked up once per file, not once per node
+	ACGL_layout_entry_t** resolved = NULL;
+	if (header->callback_count > 0) {
+		if (registry == NULL) {
+			fprintf(stderr, "Error! layout uses callbacks but there is no registry in ACGL_layout_instantiate\n");
+			return NULL;
+		}
+		resolved = (ACGL_layout_entry_t**)ACGL_malloc(ACGL_ALLOC_GUI, header->callback_count * sizeof(ACGL_layout_entry_t*));
+		if (resolved == NULL) {
+			fprintf(stderr, "Error! could not malloc callbacks in ACGL_layout_instantiate\n");
+			return NULL;
+		}
+		for (Uint32 i = 0; i < header->callback_count; ++i) {
+			const char* name = layout->strings + layout->callbacks[i].offset;
+			size_t length = layout->callbacks[i].length;
+			ACGL_layout_entry_t* entry = __acgl_layout_find(registry->entries, registry->capacity, name, length, __acgl_layout_hash(name, length));
+			if (entry->name == NULL) {
+				fprintf(stderr, "Error! callback \"%.*s\" is not registered in ACGL_layout_instantiate\n", (int)length, name);
+				ACGL_free(resolved);
+				return NULL;
+			}
+			resolved[i] = entry;
+		}
+	}
+
+	// one allocation for the node list (unless the caller gave one) and the
+	// stack of open parents, which is never deeper than the tree has nodes
+	typedef struct {
+		Uint32 index;
+		Uint32 remaining; // children it has yet to get
+	} open_parent_t;
+	size_t nodes_size = nodes == NULL ? header->node_count * sizeof(ACGL_gui_object_t*) : 0;
+	void* scratch = ACGL_malloc(ACGL_ALLOC_GUI, nodes_size + header->node_count * sizeof(open_parent_t));
+	if (scratch == NULL) {
+		fprintf(stderr, "Error! could not malloc scratch space in ACGL_layout_instantiate\n");
+		ACGL_free(resolved);
+		return NULL;
+	}
+	if (nodes == NULL) {
+		nodes = (ACGL_gui_object_t**)scratch;
+	}
+	open_parent_t* stack = (open_parent_t*)((Uint8*)scratch + nodes_size);
+
+	if (!ACGL_gui_node_init_many(gui, nodes, header->node_count)) {
+		ACGL_free(scratch);
+		ACGL_free(resolved);
+		return NULL;
+	}
+
+	// nobody else can see these nodes yet, so no locking while linking them
+	Uint32 depth = 0;
+	for (Uint32 i = 0; i < header->node_count; ++i) {
+		const ACGL_layout_node_t* source = &layout->nodes[i];
+		ACGL_gui_object_t* node = nodes[i];
+		node->x = source->x;
+		node->y = source->y;
+		node->w = source->w;
+		node->h = source->h;
+		node->min_w = source->min_w;
+		node->min_h = source->min_h;
+		node->max_w = source->max_w;
+		node->max_h = source->max_h;
+		node->anchor = source->anchor;
+		node->node_type = source->node_type;
+		node->x_frac = (source->flags & ACGL_LAYOUT_X_FRAC) != 0;
+		node->y_frac = (source->flags & ACGL_LAYOUT_Y_FRAC) != 0;
+		node->w_frac = (source->flags & ACGL_LAYOUT_W_FRAC) != 0;
+		node->h_frac = (source->flags & ACGL_LAYOUT_H_FRAC) != 0;
+		node->opaque = (source->flags & ACGL_LAYOUT_OPAQUE) != 0;
+		if (source->callback != ACGL_LAYOUT_NO_CALLBACK) {
+			node->render_callback = resolved[source->callback]->render;
+			node->callback_data = resolved[source->callback]->data;
+		}
+
+		if (depth > 0) {
+			ACGL_gui_object_t* parent = nodes[stack[depth - 1].index];
+			node->parent = parent;
+			if (parent->last_child == NULL) {
+				parent->first_child = node;
+			} else {
+				parent->last_child->next_sibling = node;
+				node->prev_sibling = parent->last_child;
+			}
+			parent->last_child = node;
+			--stack[depth - 1].remaining;
+		}
+		if (source->child_count > 0) {
+			stack[depth].index = i;
+			stack[depth].remaining = source->child_count;
+			++depth;
+		}
+		// the open count check in __acgl_layout_check guarantees this ends with an empty stack
+		while (depth > 0 && stack[depth - 1].remaining == 0) {
+			--depth;
+		}
+	}
+
+	ACGL_gui_object_t* root = nodes[0];
+	ACGL_free(scratch);
+	ACGL_free(resolved);
+	return root;
+}
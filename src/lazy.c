@@ -0,0 +1,205 @@
+#include "lazy.h"
+#include "gui_safety.h"
+#include "clock.h"
+#include "alloc.h"
+#include "contracts.h"
+
+// REQUIRES: the node is locked
+static bool __acgl_lazy_build(ACGL_gui_lazy_t* lazy) {
+	if (!(*lazy->build)(lazy->gui, lazy->node, lazy->data)) {
+		fprintf(stderr, "Error! build callback failed in __acgl_lazy_build\n");
+		ACGL_gui_node_destroy_all_children(lazy->node);
+		return false;
+	}
+	lazy->built = true;
+	lazy->shown_at = ACGL_clock_now();
+	return true;
+}
+
+// Only called with the node locked, and never while it is culled
+static bool __acgl_lazy_render(SDL_Window* window, SDL_Rect rect, void* data) {
+	(void)window;
+	ACGL_gui_lazy_t* lazy = (ACGL_gui_lazy_t*)data;
+	if (lazy->built || SDL_RectEmpty(&rect) || !__acgl_lazy_build(lazy)) {
+		return false;
+	}
+	// the children are drawn right after this, but a culling frame already
+	// laid the tree out without them. They get their real rects next frame
+	for (ACGL_gui_object_t* child = lazy->node->first_child; child != NULL; child = child->next_sibling) {
+		if (ACGL_MUTEX_LOCK(child->mutex) != 0) {
+			fprintf(stderr, "Could not lock child mutex in __acgl_lazy_render. SDL_Error: %s\n", SDL_GetError());
+			continue;
+		}
+		child->needs_layout = true;
+		ACGL_MUTEX_UNLOCK(child->mutex);
+	}
+	ACGL_gui_request_render(lazy->gui);
+	return false;
+}
+
+// Runs after the children are gone
+static void __acgl_lazy_free(void* data) {
+	ACGL_gui_lazy_t* lazy = (ACGL_gui_lazy_t*)data;
+	if (lazy->destroy != NULL && lazy->data != NULL) {
+		(*lazy->destroy)(lazy->data);
+	}
+
+	if (ACGL_MUTEX_LOCK(lazy->gui->lazy_mutex) != 0) {
+		// leaking it beats leaving a dangling entry
+		fprintf(stderr, "Could not lock lazy mutex in __acgl_lazy_free. SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+	if (lazy->prev != NULL) {
+		lazy->prev->next = lazy->next;
+	} else {
+		lazy->gui->lazy_nodes = lazy->next;
+	}
+	if (lazy->next != NULL) {
+		lazy->next->prev = lazy->prev;
+	}
+	ACGL_MUTEX_UNLOCK(lazy->gui->lazy_mutex);
+	ACGL_free(lazy);
+}
+
+ACGL_gui_object_t* ACGL_gui_lazy_create(ACGL_gui_t* gui, ACGL_gui_lazy_build_t build, ACGL_destroy_callback_t destroy, void* data, Uint64 evict_after) {
+	REQUIRES(__ACGL_is_gui_t(gui));
+	REQUIRES(build != NULL);
+
+	ACGL_gui_lazy_t* lazy = (ACGL_gui_lazy_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_gui_lazy_t));
+	if (lazy == NULL) {
+		fprintf(stderr, "Error! could not malloc lazy node in ACGL_gui_lazy_create\n");
+		return NULL;
+	}
+	lazy->gui = gui;
+	lazy->build = build;
+	lazy->destroy = destroy;
+	lazy->data = data;
+	lazy->evict_after = evict_after;
+	lazy->built = false;
+	lazy->shown_at = 0;
+	lazy->prev = NULL;
+
+	if (ACGL_MUTEX_LOCK(gui->lazy_mutex) != 0) {
+		fprintf(stderr, "Could not lock lazy mutex in ACGL_gui_lazy_create. SDL_Error: %s\n", SDL_GetError());
+		ACGL_free(lazy);
+		return NULL;
+	}
+	lazy->node = ACGL_gui_node_init(gui, __acgl_lazy_render, __acgl_lazy_free, lazy);
+	if (lazy->node == NULL) {
+		ACGL_MUTEX_UNLOCK(gui->lazy_mutex);
+		ACGL_free(lazy);
+		return NULL;
+	}
+	lazy->next = gui->lazy_nodes;
+	if (lazy->next != NULL) {
+		lazy->next->prev = lazy;
+	}
+	gui->lazy_nodes = lazy;
+	ACGL_MUTEX_UNLOCK(gui->lazy_mutex);
+	return lazy->node;
+}
+
+void ACGL_gui_lazy_set_evict_after(ACGL_gui_object_t* node, Uint64 evict_after) {
+	REQUIRES(__ACGL_is_gui_object_t(node));
+	REQUIRES(node->render_callback == __acgl_lazy_render);
+
+	if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_gui_lazy_set_evict_after. SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+	((ACGL_gui_lazy_t*)node->callback_data)->evict_after = evict_after;
+	ACGL_MUTEX_UNLOCK(node->mutex);
+}
+
+bool ACGL_gui_lazy_is_built(ACGL_gui_object_t* node) {
+	REQUIRES(__ACGL_is_gui_object_t(node));
+	REQUIRES(node->render_callback == __acgl_lazy_render);
+
+	if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_gui_lazy_is_built. SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+	bool built = ((ACGL_gui_lazy_t*)node->callback_data)->built;
+	ACGL_MUTEX_UNLOCK(node->mutex);
+	return built;
+}
+
+void ACGL_gui_lazy_evict(ACGL_gui_object_t* node) {
+	REQUIRES(__ACGL_is_gui_object_t(node));
+	REQUIRES(node->render_callback == __acgl_lazy_render);
+
+	if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_gui_lazy_evict. SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+	ACGL_gui_lazy_t* lazy = (ACGL_gui_lazy_t*)node->callback_data;
+	if (lazy->built) {
+		ACGL_gui_node_destroy_all_children(node);
+		lazy->built = false;
+		// rebuilt by the redraw if it is still shown
+		node->needs_update = true;
+	}
+	ACGL_MUTEX_UNLOCK(node->mutex);
+	ACGL_gui_request_render(lazy->gui);
+}
+
+// Returns: the first of lazy and the ones after it whose node is free, now
+// locked, or NULL. Whoever holds the others may be waiting on lazy_mutex to
+// create or destroy a lazy node, so they are skipped rather than waited on.
+// REQUIRES: lazy_mutex is held
+static ACGL_gui_lazy_t* __acgl_lazy_trylock_from(ACGL_gui_lazy_t* lazy) {
+	while (lazy != NULL && ACGL_MUTEX_TRYLOCK(lazy->node->mutex) != 0) {
+		lazy = lazy->next;
+	}
+	return lazy;
+}
+
+size_t ACGL_gui_lazy_update(ACGL_gui_t* gui) {
+	REQUIRES(__ACGL_is_gui_t(gui));
+
+	// the root first, same as a render: with it held no frame is half done,
+	// so a node shown last frame has shown_frame == gui->frame
+	if (ACGL_MUTEX_LOCK(gui->root->mutex) != 0) {
+		fprintf(stderr, "Could not lock root mutex in ACGL_gui_lazy_update. SDL_Error: %s\n", SDL_GetError());
+		return 0;
+	}
+	if (ACGL_MUTEX_LOCK(gui->lazy_mutex) != 0) {
+		fprintf(stderr, "Could not lock lazy mutex in ACGL_gui_lazy_update. SDL_Error: %s\n", SDL_GetError());
+		ACGL_MUTEX_UNLOCK(gui->root->mutex);
+		return 0;
+	}
+	ACGL_gui_lazy_t* lazy = __acgl_lazy_trylock_from(gui->lazy_nodes);
+	ACGL_MUTEX_UNLOCK(gui->lazy_mutex);
+
+	Uint64 now = ACGL_clock_now();
+	size_t evicted = 0;
+	// hand over hand: building and destroying subtrees creates and destroys
+	// lazy nodes, so lazy_mutex can't be held meanwhile. The locked node
+	// can't be destroyed, so its next is only looked up afterwards
+	while (lazy != NULL) {
+		if (gui->frame > 0 && lazy->node->shown_frame == gui->frame) {
+			lazy->shown_at = now;
+			if (!lazy->built && __acgl_lazy_build(lazy)) {
+				lazy->node->needs_update = true;
+				ACGL_gui_request_render(gui);
+			}
+		} else if (lazy->built && lazy->evict_after > 0 && now - lazy->shown_at >= lazy->evict_after) {
+			ACGL_gui_node_destroy_all_children(lazy->node);
+			lazy->built = false;
+			++evicted;
+		}
+
+		ACGL_gui_lazy_t* next = NULL;
+		if (ACGL_MUTEX_LOCK(gui->lazy_mutex) != 0) {
+			fprintf(stderr, "Could not lock lazy mutex in ACGL_gui_lazy_update. SDL_Error: %s\n", SDL_GetError());
+		} else {
+			next = __acgl_lazy_trylock_from(lazy->next);
+			ACGL_MUTEX_UNLOCK(gui->lazy_mutex);
+		}
+		ACGL_MUTEX_UNLOCK(lazy->node->mutex);
+		lazy = next;
+	}
+
+	ACGL_MUTEX_UNLOCK(gui->root->mutex);
+	return evicted;
+}
@@ -0,0 +1,303 @@
+#include "reconcile.h"
+#include "gui_safety.h"
+#include "alloc.h"
+#include "contracts.h"
+#include <string.h>
+
+// a slot in the key table, which stays at most half full
+#define ACGL_RECONCILE_EMPTY 0xFFFFFFFFu
+
+void ACGL_gui_desc_buffer_init(ACGL_gui_desc_buffer_t* buffer) {
+	REQUIRES(buffer != NULL);
+	memset(buffer, 0, sizeof(ACGL_gui_desc_buffer_t));
+}
+
+void ACGL_gui_desc_buffer_free(ACGL_gui_desc_buffer_t* buffer) {
+	REQUIRES(buffer != NULL);
+	ACGL_free(buffer->items);
+	ACGL_free(buffer->open);
+	memset(buffer, 0, sizeof(ACGL_gui_desc_buffer_t));
+}
+
+void ACGL_gui_desc_buffer_clear(ACGL_gui_desc_buffer_t* buffer) {
+	REQUIRES(buffer != NULL);
+	buffer->size = 0;
+	buffer->depth = 0;
+}
+
+ACGL_gui_desc_t* ACGL_gui_desc_push(ACGL_gui_desc_buffer_t* buffer, Uint64 key, ACGL_render_callback_t render, void* data) {
+	REQUIRES(buffer != NULL);
+	if (buffer->size == buffer->capacity) {
+		size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2 : 64;
+		ACGL_gui_desc_t* items = (ACGL_gui_desc_t*)ACGL_realloc(ACGL_ALLOC_GUI, buffer->items, capacity * sizeof(ACGL_gui_desc_t));
+		if (items == NULL) {
+			fprintf(stderr, "Error! could not grow description buffer in ACGL_gui_desc_push\n");
+			return NULL;
+		}
+		buffer->items = items;
+		buffer->capacity = capacity;
+	}
+	if (buffer->depth > 0) {
+		++buffer->items[buffer->open[buffer->depth - 1]].child_count;
+	}
+
+	// same defaults as ACGL_gui_node_init
+	ACGL_gui_desc_t* desc = &buffer->items[buffer->size++];
+	memset(desc, 0, sizeof(ACGL_gui_desc_t));
+	desc->key = key;
+	desc->render = render;
+	desc->data = data;
+	desc->anchor = ACGL_GUI_ANCHOR_CENTER;
+	desc->node_type = ACGL_GUI_NODE_FILL_H + ACGL_GUI_NODE_FILL_W + ACGL_GUI_NODE_NO_PRESERVE_ASPECT;
+	desc->w = 1;
+	desc->h = 1;
+	desc->min_w = ACGL_GUI_DIM_NONE;
+	desc->min_h = ACGL_GUI_DIM_NONE;
+	desc->max_w = ACGL_GUI_DIM_NONE;
+	desc->max_h = ACGL_GUI_DIM_NONE;
+	return desc;
+}
+
+int ACGL_gui_desc_open(ACGL_gui_desc_buffer_t* buffer) {
+	REQUIRES(buffer != NULL);
+	REQUIRES(buffer->size > 0);
+	if (buffer->depth == buffer->open_capacity) {
+		size_t capacity = buffer->open_capacity > 0 ? buffer->open_capacity * 2 : 16;
+		size_t* open = (size_t*)ACGL_realloc(ACGL_ALLOC_GUI, buffer->open, capacity * sizeof(size_t));
+		if (open == NULL) {
+			fprintf(stderr, "Error! could not grow description buffer in ACGL_gui_desc_open\n");
+			return -1;
+		}
+		buffer->open = open;
+		buffer->open_capacity = capacity;
+	}
+	buffer->open[buffer->depth++] = buffer->size - 1;
+	return 0;
+}
+
+void ACGL_gui_desc_close(ACGL_gui_desc_buffer_t* buffer) {
+	REQUIRES(buffer != NULL);
+	REQUIRES(buffer->depth > 0);
+	--buffer->depth;
+}
+
+// Fills next[i] with the index just past the subtree starting at i.
+// Returns: false if a child_count runs past the end
+static bool __acgl_reconcile_measure(const ACGL_gui_desc_t* descs, size_t size, size_t* next) {
+	// walking backwards, each subtree's children have already been measured
+	for (size_t i = size; i > 0; --i) {
+		size_t end = i;
+		for (Uint32 c = 0; c < descs[i - 1].child_count; ++c) {
+			if (end >= size) {
+				return false;
+			}
+			end = next[end];
+		}
+		next[i - 1] = end;
+	}
+	return true;
+}
+
+static Uint32 __acgl_reconcile_hash(Uint64 key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	return (Uint32)key;
+}
+
+// Copies desc's fields into node, flagging what the change costs.
+// REQUIRES: node is locked. Returns: whether anything has to be redrawn
+static bool __acgl_reconcile_apply(ACGL_gui_object_t* node, const ACGL_gui_desc_t* desc) {
+	bool changed = false;
+	if (node->render_callback != desc->render || node->callback_data != desc->data) {
+		if (node->callback_data != desc->data && node->callback_data != NULL && node->destroy_callback != NULL) {
+			(*node->destroy_callback)(node->callback_data);
+		}
+		node->render_callback = desc->render;
+		node->callback_data = desc->data;
+		node->needs_update = true;
+		changed = true;
+	}
+	node->destroy_callback = desc->destroy;
+	// only decides what gets culled, the node itself looks the same
+	node->opaque = desc->opaque;
+
+	bool moved = node->anchor != desc->anchor || node->node_type != desc->node_type
+		|| node->x != desc->x || node->y != desc->y || node->w != desc->w || node->h != desc->h
+		|| node->min_w != desc->min_w || node->min_h != desc->min_h
+		|| node->max_w != desc->max_w || node->max_h != desc->max_h
+		|| node->x_frac != desc->x_frac || node->y_frac != desc->y_frac
+		|| node->w_frac != desc->w_frac || node->h_frac != desc->h_frac;
+	if (moved) {
+		node->anchor = desc->anchor;
+		node->node_type = desc->node_type;
+		node->x = desc->x;
+		node->y = desc->y;
+		node->w = desc->w;
+		node->h = desc->h;
+		node->min_w = desc->min_w;
+		node->min_h = desc->min_h;
+		node->max_w = desc->max_w;
+		node->max_h = desc->max_h;
+		node->x_frac = desc->x_frac;
+		node->y_frac = desc->y_frac;
+		node->w_frac = desc->w_frac;
+		node->h_frac = desc->h_frac;
+		node->needs_layout = true;
+		changed = true;
+	}
+	return changed;
+}
+
+// Reconciles parent's children with the subtrees in descs[begin, end), and
+// sets changed when something has to be redrawn
+static int __acgl_reconcile_level(ACGL_gui_t* gui, ACGL_gui_object_t* parent, const ACGL_gui_desc_t* descs, size_t begin, size_t end, const size_t* next, bool* changed) {
+	if (ACGL_MUTEX_LOCK(parent->mutex) != 0) {
+		fprintf(stderr, "Could not lock parent mutex in ACGL_gui_reconcile. SDL_Error: %s\n", SDL_GetError());
+		return -1;
+	}
+
+	size_t old_count = 0;
+	for (ACGL_gui_object_t* child = parent->first_child; child != NULL; child = child->next_sibling) {
+		++old_count;
+	}
+	size_t new_count = 0;
+	for (size_t i = begin; i < end; i = next[i]) {
+		++new_count;
+	}
+	Uint32 table_size = 8;
+	while (table_size < old_count * 2) {
+		table_size *= 2;
+	}
+
+	// the old children, the nodes each description ends up with, and a key
+	// table over the old children, in one allocation
+	size_t bytes = (old_count + new_count) * sizeof(ACGL_gui_object_t*) + table_size * sizeof(Uint32);
+	ACGL_gui_object_t** old_nodes = (ACGL_gui_object_t**)ACGL_malloc(ACGL_ALLOC_GUI, bytes);
+	if (old_nodes == NULL) {
+		fprintf(stderr, "Error! could not malloc scratch space in ACGL_gui_reconcile\n");
+		ACGL_MUTEX_UNLOCK(parent->mutex);
+		return -1;
+	}
+	ACGL_gui_object_t** new_nodes = old_nodes + old_count;
+	Uint32* table = (Uint32*)(new_nodes + new_count);
+	memset(table, 0xFF, table_size * sizeof(Uint32));
+
+	Uint32 mask = table_size - 1;
+	size_t k = 0;
+	for (ACGL_gui_object_t* child = parent->first_child; child != NULL; child = child->next_sibling, ++k) {
+		old_nodes[k] = child;
+		Uint32 slot = __acgl_reconcile_hash(child->key) & mask;
+		while (table[slot] != ACGL_RECONCILE_EMPTY) {
+			slot = (slot + 1) & mask;
+		}
+		table[slot] = (Uint32)k;
+	}
+
+	// claim old nodes by key, taking each out of the table so a repeated key
+	// can't claim it again, and create the rest
+	bool reordered = old_count != new_count;
+	k = 0;
+	for (size_t i = begin; i < end; i = next[i], ++k) {
+		const ACGL_gui_desc_t* desc = &descs[i];
+		new_nodes[k] = NULL;
+		for (Uint32 slot = __acgl_reconcile_hash(desc->key) & mask; table[slot] != ACGL_RECONCILE_EMPTY; slot = (slot + 1) & mask) {
+			ACGL_gui_object_t* candidate = old_nodes[table[slot]];
+			if (candidate != NULL && candidate->key == desc->key) {
+				new_nodes[k] = candidate;
+				old_nodes[table[slot]] = NULL;
+				reordered |= table[slot] != k;
+				break;
+			}
+		}
+		if (new_nodes[k] == NULL) {
+			ACGL_gui_object_t* node = ACGL_gui_node_init(gui, NULL, NULL, NULL);
+			if (node == NULL) {
+				// undo, the tree hasn't been touched yet
+				for (size_t j = 0; j < k; ++j) {
+					if (new_nodes[j]->parent == NULL) {
+						ACGL_gui_node_destroy(new_nodes[j]);
+					}
+				}
+				ACGL_free(old_nodes);
+				ACGL_MUTEX_UNLOCK(parent->mutex);
+				return -1;
+			}
+			node->key = desc->key;
+			new_nodes[k] = node;
+			reordered = true;
+		}
+	}
+
+	// what is left over wasn't wanted anymore
+	for (size_t i = 0; i < old_count; ++i) {
+		if (old_nodes[i] != NULL) {
+			old_nodes[i]->parent = NULL;
+			old_nodes[i]->prev_sibling = NULL;
+			old_nodes[i]->next_sibling = NULL;
+			ACGL_gui_node_destroy(old_nodes[i]);
+		}
+	}
+
+	// relink everything in the wanted order while updating fields
+	k = 0;
+	for (size_t i = begin; i < end; i = next[i], ++k) {
+		ACGL_gui_object_t* node = new_nodes[k];
+		// the links have to be set either way, or the list breaks
+		bool locked = ACGL_MUTEX_LOCK(node->mutex) == 0;
+		if (!locked) {
+			fprintf(stderr, "Could not lock child mutex in ACGL_gui_reconcile! Things will definitely look wrong. SDL_Error: %s\n", SDL_GetError());
+		}
+		*changed |= __acgl_reconcile_apply(node, &descs[i]);
+		node->parent = parent;
+		node->prev_sibling = k > 0 ? new_nodes[k - 1] : NULL;
+		node->next_sibling = k + 1 < new_count ? new_nodes[k + 1] : NULL;
+		if (locked) {
+			ACGL_MUTEX_UNLOCK(node->mutex);
+		}
+	}
+	parent->first_child = new_count > 0 ? new_nodes[0] : NULL;
+	parent->last_child = new_count > 0 ? new_nodes[new_count - 1] : NULL;
+	if (reordered) {
+		// whatever was behind the removed or moved nodes has to be painted again
+		parent->needs_update = true;
+		*changed = true;
+	}
+	ACGL_MUTEX_UNLOCK(parent->mutex);
+
+	int result = 0;
+	k = 0;
+	for (size_t i = begin; i < end && result == 0; i = next[i], ++k) {
+		if (!(descs[i].flags & ACGL_GUI_DESC_KEEP_CHILDREN)) {
+			result = __acgl_reconcile_level(gui, new_nodes[k], descs, i + 1, next[i], next, changed);
+		}
+	}
+	ACGL_free(old_nodes);
+	return result;
+}
+
+int ACGL_gui_reconcile(ACGL_gui_t* gui, ACGL_gui_object_t* parent, const ACGL_gui_desc_t* descs, size_t size) {
+	REQUIRES(__ACGL_is_gui_t(gui));
+	REQUIRES(__ACGL_is_gui_object_t(parent));
+	REQUIRES(descs != NULL || size == 0);
+
+	size_t* next = (size_t*)ACGL_malloc(ACGL_ALLOC_GUI, (size > 0 ? size : 1) * sizeof(size_t));
+	if (next == NULL) {
+		fprintf(stderr, "Error! could not malloc scratch space in ACGL_gui_reconcile\n");
+		return -1;
+	}
+	if (!__acgl_reconcile_measure(descs, size, next)) {
+		fprintf(stderr, "Error! child counts run past the end of the descriptions in ACGL_gui_reconcile\n");
+		ACGL_free(next);
+		return -1;
+	}
+	bool changed = false;
+	int result = __acgl_reconcile_level(gui, parent, descs, 0, size, next, &changed);
+	ACGL_free(next);
+	if (changed) {
+		ACGL_gui_request_render(gui);
+	}
+
+	ENSURES(__ACGL_is_gui_object_t(parent));
+	return result;
+}
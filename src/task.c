@@ -0,0 +1,230 @@
+#include "task.h"
+#include "alloc.h"
+#include "contracts.h"
+
+enum ACGL_TASK_STATE {
+	ACGL_TASK_FREE,
+	ACGL_TASK_ALIVE,
+	ACGL_TASK_DEAD, // finished or cancelled, still in the active list
+};
+
+#define ACGL_TASK_NIL 0xFFFFFFFFu
+
+static ACGL_task_t* __acgl_task_at(ACGL_task_scheduler_t* scheduler, Uint32 index) {
+	return &scheduler->chunks[index >> ACGL_TASK_CHUNK_BITS][index & (ACGL_TASK_CHUNK_SIZE - 1)];
+}
+
+// Returns: the live task the id refers to, NULL if there is none
+static ACGL_task_t* __acgl_task_lookup(ACGL_task_scheduler_t* scheduler, ACGL_task_id_t id) {
+	Uint32 index = (Uint32)(id & 0xFFFFFFFFu) - 1;
+	if (id == 0 || index >= scheduler->chunks_size * ACGL_TASK_CHUNK_SIZE) {
+		return NULL;
+	}
+	ACGL_task_t* task = __acgl_task_at(scheduler, index);
+	if (task->state != ACGL_TASK_ALIVE || task->generation != (Uint32)(id >> 32)) {
+		return NULL;
+	}
+	return task;
+}
+
+static bool __acgl_task_grow(ACGL_task_scheduler_t* scheduler) {
+	ACGL_task_t** chunks = (ACGL_task_t**)ACGL_realloc(ACGL_ALLOC_TASK, scheduler->chunks, (scheduler->chunks_size + 1) * sizeof(ACGL_task_t*));
+	if (chunks == NULL) {
+		return false;
+	}
+	scheduler->chunks = chunks;
+	ACGL_task_t* chunk = (ACGL_task_t*)ACGL_calloc(ACGL_ALLOC_TASK, ACGL_TASK_CHUNK_SIZE, sizeof(ACGL_task_t));
+	if (chunk == NULL) {
+		return false;
+	}
+	Uint32 base = scheduler->chunks_size * ACGL_TASK_CHUNK_SIZE;
+	scheduler->chunks[scheduler->chunks_size++] = chunk;
+	for (Uint32 i=ACGL_TASK_CHUNK_SIZE; i>0; --i) {
+		chunk[i-1].state = ACGL_TASK_FREE;
+		chunk[i-1].next_free = scheduler->free_list;
+		scheduler->free_list = base + i - 1;
+	}
+	return true;
+}
+
+static void __acgl_task_release(ACGL_task_scheduler_t* scheduler, Uint32 index) {
+	ACGL_task_t* task = __acgl_task_at(scheduler, index);
+	if (task->data_destroy != NULL && task->data != NULL) {
+		(*task->data_destroy)(task->data);
+	}
+	task->data = NULL;
+	task->state = ACGL_TASK_FREE;
+	// invalidates every id handed out for this slot
+	++task->generation;
+	task->next_free = scheduler->free_list;
+	scheduler->free_list = index;
+}
+
+void ACGL_task_signal_init(ACGL_task_signal_t* signal) {
+	REQUIRES(signal != NULL);
+	SDL_AtomicSet(&signal->count, 0);
+}
+
+void ACGL_task_signal_raise(ACGL_task_signal_t* signal) {
+	REQUIRES(signal != NULL);
+	SDL_AtomicAdd(&signal->count, 1);
+}
+
+ACGL_task_scheduler_t* ACGL_task_scheduler_create(void) {
+	ACGL_task_scheduler_t* scheduler = (ACGL_task_scheduler_t*)ACGL_malloc(ACGL_ALLOC_TASK, sizeof(ACGL_task_scheduler_t));
+	if (scheduler == NULL) {
+		fprintf(stderr, "Error: could not malloc scheduler in ACGL_task_scheduler_create!\n");
+		return NULL;
+	}
+	scheduler->chunks = NULL;
+	scheduler->chunks_size = 0;
+	scheduler->free_list = ACGL_TASK_NIL;
+	scheduler->active_capacity = ACGL_TASK_CHUNK_SIZE;
+	scheduler->active_size = 0;
+	scheduler->running = false;
+	scheduler->active = (Uint32*)ACGL_malloc(ACGL_ALLOC_TASK, scheduler->active_capacity * sizeof(Uint32));
+	if (scheduler->active == NULL || !__acgl_task_grow(scheduler)) {
+		fprintf(stderr, "Error: could not malloc tasks in ACGL_task_scheduler_create!\n");
+		ACGL_task_scheduler_destroy(scheduler);
+		return NULL;
+	}
+	return scheduler;
+}
+
+void ACGL_task_scheduler_destroy(ACGL_task_scheduler_t* scheduler) {
+	if (scheduler != NULL) {
+		REQUIRES(!scheduler->running);
+		for (Uint32 i=0; i<scheduler->active_size; ++i) {
+			__acgl_task_release(scheduler, scheduler->active[i]);
+		}
+		for (Uint32 i=0; i<scheduler->chunks_size; ++i) {
+			ACGL_free(scheduler->chunks[i]);
+		}
+		ACGL_free(scheduler->chunks);
+		ACGL_free(scheduler->active);
+		ACGL_free(scheduler);
+	}
+}
+
+ACGL_task_id_t ACGL_task_spawn(ACGL_task_scheduler_t* scheduler, ACGL_task_callback_t callback, void* data, ACGL_destroy_callback_t data_destroy) {
+	REQUIRES(scheduler != NULL);
+	REQUIRES(callback != NULL);
+
+	if (scheduler->active_size == scheduler->active_capacity) {
+		Uint32 capacity = scheduler->active_capacity * 2;
+		Uint32* active = (Uint32*)ACGL_realloc(ACGL_ALLOC_TASK, scheduler->active, capacity * sizeof(Uint32));
+		if (active == NULL) {
+			fprintf(stderr, "Error: could not grow active tasks in ACGL_task_spawn!\n");
+			return 0;
+		}
+		scheduler->active = active;
+		scheduler->active_capacity = capacity;
+	}
+	if (scheduler->free_list == ACGL_TASK_NIL && !__acgl_task_grow(scheduler)) {
+		fprintf(stderr, "Error: could not grow tasks in ACGL_task_spawn!\n");
+		return 0;
+	}
+
+	Uint32 index = scheduler->free_list;
+	ACGL_task_t* task = __acgl_task_at(scheduler, index);
+	scheduler->free_list = task->next_free;
+
+	task->resume = 0;
+	task->wait = ACGL_TASK_WAIT_NONE;
+	task->state = ACGL_TASK_ALIVE;
+	task->timed_out = false;
+	task->until = 0;
+	task->now = 0;
+	task->channel = NULL;
+	task->signal = NULL;
+	task->signal_seen = 0;
+	task->callback = callback;
+	task->data = data;
+	task->data_destroy = data_destroy;
+
+	scheduler->active[scheduler->active_size++] = index;
+	return ((Uint64)task->generation << 32) | (Uint64)(index + 1);
+}
+
+bool ACGL_task_cancel(ACGL_task_scheduler_t* scheduler, ACGL_task_id_t id) {
+	REQUIRES(scheduler != NULL);
+	ACGL_task_t* task = __acgl_task_lookup(scheduler, id);
+	if (task == NULL) {
+		return false;
+	}
+	// released by the next run, which also keeps a running task's pointer valid
+	task->state = ACGL_TASK_DEAD;
+	return true;
+}
+
+bool ACGL_task_is_alive(ACGL_task_scheduler_t* scheduler, ACGL_task_id_t id) {
+	REQUIRES(scheduler != NULL);
+	return __acgl_task_lookup(scheduler, id) != NULL;
+}
+
+Uint32 ACGL_task_scheduler_count(ACGL_task_scheduler_t* scheduler) {
+	REQUIRES(scheduler != NULL);
+	return scheduler->active_size;
+}
+
+// Returns: whether the task's wait is over at time now
+static bool __acgl_task_ready(ACGL_task_t* task, Uint64 now) {
+	switch (task->wait) {
+	case ACGL_TASK_WAIT_NONE:
+		return true;
+	case ACGL_TASK_WAIT_TIME:
+		return now >= task->until;
+	case ACGL_TASK_WAIT_CHANNEL:
+		if (!ACGL_channel_is_empty(task->channel)) {
+			task->timed_out = false;
+			return true;
+		}
+		break;
+	case ACGL_TASK_WAIT_SIGNAL:
+		if (SDL_AtomicGet(&task->signal->count) != task->signal_seen) {
+			task->timed_out = false;
+			return true;
+		}
+		break;
+	}
+	task->timed_out = task->until != 0 && now >= task->until;
+	return task->timed_out;
+}
+
+Uint32 ACGL_task_scheduler_run(ACGL_task_scheduler_t* scheduler, Uint64 now) {
+	REQUIRES(scheduler != NULL);
+	REQUIRES(!scheduler->running);
+	scheduler->running = true;
+
+	Uint32 resumed = 0;
+	// tasks spawned while running are appended past end and wait for the next run
+	Uint32 end = scheduler->active_size;
+	Uint32 i = 0;
+	while (i < end) {
+		Uint32 index = scheduler->active[i];
+		ACGL_task_t* task = __acgl_task_at(scheduler, index);
+
+		if (task->state == ACGL_TASK_ALIVE && __acgl_task_ready(task, now)) {
+			task->now = now;
+			++resumed;
+			if (!(*task->callback)(task, task->data)) {
+				task->state = ACGL_TASK_DEAD;
+			}
+		}
+
+		if (task->state == ACGL_TASK_DEAD) {
+			// fill the hole from the end of this run's range, and that one
+			// from the tail so newly spawned tasks aren't skipped
+			scheduler->active[i] = scheduler->active[end - 1];
+			scheduler->active[end - 1] = scheduler->active[scheduler->active_size - 1];
+			--end;
+			--scheduler->active_size;
+			__acgl_task_release(scheduler, index);
+		} else {
+			++i;
+		}
+	}
+
+	scheduler->running = false;
+	return resumed;
+}
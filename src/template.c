@@ -0,0 +1,180 @@
+#include "template.h"
+#include "gui_safety.h"
+#include "alloc.h"
+#include "contracts.h"
+#include <string.h>
+
+// what an instance node's callback_data points to
+typedef struct {
+	ACGL_gui_template_t* tmpl;
+	void* data;
+} __acgl_template_instance_t;
+
+static size_t __acgl_template_count(const ACGL_gui_object_t* node) {
+	size_t count = 1;
+	for (const ACGL_gui_object_t* child = node->first_child; child != NULL; child = child->next_sibling) {
+		count += __acgl_template_count(child);
+	}
+	return count;
+}
+
+// Parents draw before their children, and children from last to first,
+// same as ACGL_gui_render. Returns: the next free entry
+static size_t __acgl_template_flatten(ACGL_gui_template_entry_t* entries, size_t at, ACGL_gui_object_t* node, size_t parent) {
+	size_t self = at++;
+	entries[self].node = node;
+	entries[self].parent = parent;
+	entries[self].pass_data = false;
+	for (ACGL_gui_object_t* child = node->last_child; child != NULL; child = child->prev_sibling) {
+		at = __acgl_template_flatten(entries, at, child, self);
+	}
+	return at;
+}
+
+ACGL_gui_template_t* ACGL_gui_template_create(ACGL_gui_object_t* root) {
+	REQUIRES(__ACGL_is_gui_object_t(root));
+	REQUIRES(root->parent == NULL);
+
+	ACGL_gui_template_t* tmpl = (ACGL_gui_template_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(ACGL_gui_template_t));
+	if (tmpl == NULL) {
+		fprintf(stderr, "Error! could not malloc template in ACGL_gui_template_create\n");
+		return NULL;
+	}
+	tmpl->size = __acgl_template_count(root);
+	// the entries and every cached layout in one allocation
+	size_t bytes = tmpl->size * (sizeof(ACGL_gui_template_entry_t) + ACGL_GUI_TEMPLATE_CACHED_SIZES * sizeof(SDL_Rect));
+	tmpl->entries = (ACGL_gui_template_entry_t*)ACGL_malloc(ACGL_ALLOC_GUI, bytes);
+	if (tmpl->entries == NULL) {
+		fprintf(stderr, "Error! could not malloc entries in ACGL_gui_template_create\n");
+		ACGL_free(tmpl);
+		return NULL;
+	}
+	if (!ACGL_MUTEX_CREATE(tmpl->mutex)) {
+		fprintf(stderr, "Could not create mutex in ACGL_gui_template_create! SDL Error: %s\n", SDL_GetError());
+		ACGL_free(tmpl->entries);
+		ACGL_free(tmpl);
+		return NULL;
+	}
+	__acgl_template_flatten(tmpl->entries, 0, root, ACGL_GUI_TEMPLATE_ROOT);
+	SDL_Rect* rects = (SDL_Rect*)(tmpl->entries + tmpl->size);
+	for (int i = 0; i < ACGL_GUI_TEMPLATE_CACHED_SIZES; ++i) {
+		tmpl->layouts[i].w = -1;
+		tmpl->layouts[i].h = -1;
+		tmpl->layouts[i].rects = rects + (size_t)i * tmpl->size;
+	}
+	tmpl->next_layout = 0;
+	tmpl->root = root;
+	return tmpl;
+}
+
+void ACGL_gui_template_destroy(ACGL_gui_template_t* tmpl) {
+	if (tmpl == NULL) {
+		return;
+	}
+	ACGL_gui_node_destroy(tmpl->root);
+	ACGL_MUTEX_DESTROY(tmpl->mutex);
+	ACGL_free(tmpl->entries);
+	ACGL_free(tmpl);
+}
+
+bool ACGL_gui_template_pass_data(ACGL_gui_template_t* tmpl, ACGL_gui_object_t* node) {
+	REQUIRES(tmpl != NULL);
+	for (size_t i = 0; i < tmpl->size; ++i) {
+		if (tmpl->entries[i].node == node) {
+			tmpl->entries[i].pass_data = true;
+			return true;
+		}
+	}
+	fprintf(stderr, "Error! node is not part of the template in ACGL_gui_template_pass_data\n");
+	return false;
+}
+
+// Returns: the template laid out in a w by h instance, computing it if no
+// cached size matches. REQUIRES: the template is locked
+static const SDL_Rect* __acgl_template_layout(ACGL_gui_template_t* tmpl, int w, int h) {
+	for (int i = 0; i < ACGL_GUI_TEMPLATE_CACHED_SIZES; ++i) {
+		if (tmpl->layouts[i].w == w && tmpl->layouts[i].h == h) {
+			return tmpl->layouts[i].rects;
+		}
+	}
+	ACGL_gui_template_layout_t* layout = &tmpl->layouts[tmpl->next_layout];
+	tmpl->next_layout = (tmpl->next_layout + 1) % ACGL_GUI_TEMPLATE_CACHED_SIZES;
+	SDL_Rect instance = {0, 0, w, h};
+	for (size_t i = 0; i < tmpl->size; ++i) {
+		const ACGL_gui_template_entry_t* entry = &tmpl->entries[i];
+		SDL_Rect location = entry->parent == ACGL_GUI_TEMPLATE_ROOT ? instance : layout->rects[entry->parent];
+		layout->rects[i] = ACGL_gui_node_place(entry->node, location);
+	}
+	layout->w = w;
+	layout->h = h;
+	return layout->rects;
+}
+
+bool ACGL_gui_template_draw(ACGL_gui_template_t* tmpl, SDL_Window* window, SDL_Rect rect, void* data) {
+	REQUIRES(tmpl != NULL);
+
+	if (ACGL_MUTEX_LOCK(tmpl->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_gui_template_draw. SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+	// held while drawing, so no other size evicts these rects meanwhile
+	const SDL_Rect* rects = __acgl_template_layout(tmpl, rect.w, rect.h);
+	bool return_val = false;
+	for (size_t i = 0; i < tmpl->size; ++i) {
+		const ACGL_gui_template_entry_t* entry = &tmpl->entries[i];
+		if (entry->node->render_callback == NULL) {
+			continue;
+		}
+		SDL_Rect at = rects[i];
+		at.x += rect.x;
+		at.y += rect.y;
+		return_val |= (*entry->node->render_callback)(window, at, entry->pass_data ? data : entry->node->callback_data);
+	}
+	ACGL_MUTEX_UNLOCK(tmpl->mutex);
+	return return_val;
+}
+
+static bool __acgl_template_render(SDL_Window* window, SDL_Rect rect, void* data) {
+	__acgl_template_instance_t* instance = (__acgl_template_instance_t*)data;
+	return ACGL_gui_template_draw(instance->tmpl, window, rect, instance->data);
+}
+
+static void __acgl_template_free(void* data) {
+	ACGL_free(data);
+}
+
+ACGL_gui_object_t* ACGL_gui_template_instance(ACGL_gui_t* gui, ACGL_gui_template_t* tmpl, void* data) {
+	REQUIRES(__ACGL_is_gui_t(gui));
+	REQUIRES(tmpl != NULL);
+
+	__acgl_template_instance_t* instance = (__acgl_template_instance_t*)ACGL_malloc(ACGL_ALLOC_GUI, sizeof(__acgl_template_instance_t));
+	if (instance == NULL) {
+		fprintf(stderr, "Error! could not malloc instance in ACGL_gui_template_instance\n");
+		return NULL;
+	}
+	instance->tmpl = tmpl;
+	instance->data = data;
+	ACGL_gui_object_t* node = ACGL_gui_node_init(gui, __acgl_template_render, __acgl_template_free, instance);
+	if (node == NULL) {
+		ACGL_free(instance);
+		return NULL;
+	}
+	return node;
+}
+
+void ACGL_gui_template_instance_set_data(ACGL_gui_object_t* node, void* data) {
+	REQUIRES(__ACGL_is_gui_object_t(node));
+	REQUIRES(node->render_callback == __acgl_template_render);
+
+	if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_gui_template_instance_set_data. SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+	__acgl_template_instance_t* instance = (__acgl_template_instance_t*)node->callback_data;
+	if (instance->data != data) {
+		instance->data = data;
+		node->needs_update = true;
+	}
+	ACGL_MUTEX_UNLOCK(node->mutex);
+	ACGL_gui_request_render(node->gui);
+}
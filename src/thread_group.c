@@ -0,0 +1,294 @@
+#include "thread_group.h"
+#include "alloc.h"
+#include "contracts.h"
+
+ACGL_barrier_t* ACGL_barrier_create(Uint32 count, bool held) {
+	ACGL_barrier_t* barrier = (ACGL_barrier_t*)ACGL_malloc(ACGL_ALLOC_THREADS, sizeof(ACGL_barrier_t));
+	if (barrier == NULL) {
+		fprintf(stderr, "Error: could not malloc barrier in ACGL_barrier_create!\n");
+		return NULL;
+	}
+	barrier->mutex = SDL_CreateMutex();
+	barrier->cond = SDL_CreateCond();
+	if (barrier->mutex == NULL || barrier->cond == NULL) {
+		fprintf(stderr, "Error: could not create barrier synchronization in ACGL_barrier_create! SDL_Error: %s\n", SDL_GetError());
+		ACGL_barrier_destroy(barrier);
+		return NULL;
+	}
+	barrier->count = count;
+	barrier->arrived = 0;
+	barrier->generation = 0;
+	barrier->held = held;
+	barrier->cancelled = false;
+	return barrier;
+}
+
+void ACGL_barrier_destroy(ACGL_barrier_t* barrier) {
+	if (barrier != NULL) {
+		if (barrier->mutex != NULL) {
+			SDL_DestroyMutex(barrier->mutex);
+			barrier->mutex = NULL;
+		}
+		if (barrier->cond != NULL) {
+			SDL_DestroyCond(barrier->cond);
+			barrier->cond = NULL;
+		}
+		ACGL_free(barrier);
+	}
+}
+
+// Call with the mutex held
+static void __acgl_barrier_release(ACGL_barrier_t* barrier) {
+	++barrier->generation;
+	barrier->arrived = 0;
+	SDL_CondBroadcast(barrier->cond);
+}
+
+int ACGL_barrier_wait(ACGL_barrier_t* barrier) {
+	REQUIRES(barrier != NULL);
+	if (SDL_LockMutex(barrier->mutex) != 0) {
+		fprintf(stderr, "Error locking mutex in ACGL_barrier_wait. SDL_Error: %s\n", SDL_GetError());
+		return ACGL_BARRIER_CANCELLED;
+	}
+
+	int result = 0;
+	Uint32 generation = barrier->generation;
+	if (barrier->cancelled) {
+		result = ACGL_BARRIER_CANCELLED;
+	} else if (++barrier->arrived >= barrier->count) {
+		if (barrier->held) {
+			// let the controller know everyone is here
+			SDL_CondBroadcast(barrier->cond);
+		} else {
+			__acgl_barrier_release(barrier);
+			result = ACGL_BARRIER_SERIAL;
+		}
+	}
+
+	while (result == 0 && generation == barrier->generation) {
+		if (barrier->cancelled) {
+			result = ACGL_BARRIER_CANCELLED;
+			break;
+		}
+		SDL_CondWait(barrier->cond, barrier->mutex);
+	}
+
+	SDL_UnlockMutex(barrier->mutex);
+	return result;
+}
+
+bool ACGL_barrier_wait_arrivals(ACGL_barrier_t* barrier, Uint32 timeout_ms) {
+	REQUIRES(barrier != NULL);
+	if (SDL_LockMutex(barrier->mutex) != 0) {
+		fprintf(stderr, "Error locking mutex in ACGL_barrier_wait_arrivals. SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	Uint64 deadline = ACGL_clock_now() + (Uint64)timeout_ms * ACGL_CLOCK_NS_PER_MS;
+	while (!barrier->cancelled && barrier->arrived < barrier->count) {
+		if (timeout_ms == SDL_MUTEX_MAXWAIT) {
+			SDL_CondWait(barrier->cond, barrier->mutex);
+			continue;
+		}
+		Uint64 now = ACGL_clock_now();
+		if (now >= deadline) {
+			break;
+		}
+		SDL_CondWaitTimeout(barrier->cond, barrier->mutex, (Uint32)((deadline - now + ACGL_CLOCK_NS_PER_MS - 1) / ACGL_CLOCK_NS_PER_MS));
+	}
+	bool all_arrived = !barrier->cancelled && barrier->arrived >= barrier->count;
+
+	SDL_UnlockMutex(barrier->mutex);
+	return all_arrived;
+}
+
+void ACGL_barrier_release(ACGL_barrier_t* barrier) {
+	REQUIRES(barrier != NULL);
+	SDL_LockMutex(barrier->mutex);
+	__acgl_barrier_release(barrier);
+	SDL_UnlockMutex(barrier->mutex);
+}
+
+void ACGL_barrier_cancel(ACGL_barrier_t* barrier) {
+	REQUIRES(barrier != NULL);
+	SDL_LockMutex(barrier->mutex);
+	barrier->cancelled = true;
+	SDL_CondBroadcast(barrier->cond);
+	SDL_UnlockMutex(barrier->mutex);
+}
+
+void ACGL_barrier_reset(ACGL_barrier_t* barrier, Uint32 count) {
+	REQUIRES(barrier != NULL);
+	SDL_LockMutex(barrier->mutex);
+	barrier->count = count;
+	barrier->arrived = 0;
+	barrier->cancelled = false;
+	++barrier->generation;
+	SDL_CondBroadcast(barrier->cond);
+	SDL_UnlockMutex(barrier->mutex);
+}
+
+void ACGL_barrier_leave(ACGL_barrier_t* barrier) {
+	REQUIRES(barrier != NULL);
+	SDL_LockMutex(barrier->mutex);
+	if (barrier->count > 0) {
+		--barrier->count;
+	}
+	if (barrier->arrived >= barrier->count) {
+		if (barrier->held || barrier->count == 0) {
+			SDL_CondBroadcast(barrier->cond);
+		} else {
+			__acgl_barrier_release(barrier);
+		}
+	}
+	SDL_UnlockMutex(barrier->mutex);
+}
+
+ACGL_thread_group_t* ACGL_thread_group_create(void) {
+	ACGL_thread_group_t* group = (ACGL_thread_group_t*)ACGL_malloc(ACGL_ALLOC_THREADS, sizeof(ACGL_thread_group_t));
+	if (group == NULL) {
+		fprintf(stderr, "Error: could not malloc thread group in ACGL_thread_group_create!\n");
+		return NULL;
+	}
+	group->members = NULL;
+	group->members_size = 0;
+	group->members_capacity = 0;
+	group->phase = NULL;
+	return group;
+}
+
+void ACGL_thread_group_destroy(ACGL_thread_group_t* group, bool destroy_members) {
+	// Like ACGL_thread_destroy, doesn't check to stop running first
+	if (group != NULL) {
+		for (size_t i=0; i<group->members_size; ++i) {
+			group->members[i]->data->tick_barrier = NULL;
+			if (destroy_members) {
+				ACGL_thread_destroy(group->members[i]);
+			}
+		}
+		ACGL_free(group->members);
+		group->members = NULL;
+		if (group->phase != NULL) {
+			ACGL_barrier_destroy(group->phase);
+			group->phase = NULL;
+		}
+		ACGL_free(group);
+	}
+}
+
+static bool __acgl_thread_group_running(ACGL_thread_group_t* group) {
+	for (size_t i=0; i<group->members_size; ++i) {
+		if (ACGL_thread_is_running(group->members[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int ACGL_thread_group_add(ACGL_thread_group_t* group, ACGL_thread_t* thread) {
+	REQUIRES(group != NULL);
+	REQUIRES(__acgl_is_thread(thread));
+
+	if (ACGL_thread_is_running(thread) || __acgl_thread_group_running(group)) {
+		fprintf(stderr, "Error: can only add stopped threads to a stopped group in ACGL_thread_group_add\n");
+		return -1;
+	}
+	if (group->members_size == group->members_capacity) {
+		size_t capacity = group->members_capacity == 0 ? 8 : group->members_capacity * 2;
+		ACGL_thread_t** members = (ACGL_thread_t**)ACGL_realloc(ACGL_ALLOC_THREADS, group->members, capacity * sizeof(ACGL_thread_t*));
+		if (members == NULL) {
+			fprintf(stderr, "Error: could not grow thread group in ACGL_thread_group_add!\n");
+			return -1;
+		}
+		group->members = members;
+		group->members_capacity = capacity;
+	}
+	group->members[group->members_size++] = thread;
+	thread->data->tick_barrier = group->phase;
+	return 0;
+}
+
+int ACGL_thread_group_enable_phase_sync(ACGL_thread_group_t* group) {
+	REQUIRES(group != NULL);
+
+	if (__acgl_thread_group_running(group)) {
+		fprintf(stderr, "Error: can't change phase sync of a running group in ACGL_thread_group_enable_phase_sync\n");
+		return -1;
+	}
+	if (group->phase == NULL) {
+		group->phase = ACGL_barrier_create((Uint32)group->members_size, true);
+		if (group->phase == NULL) {
+			return -1;
+		}
+	}
+	for (size_t i=0; i<group->members_size; ++i) {
+		group->members[i]->data->tick_barrier = group->phase;
+	}
+	return 0;
+}
+
+int ACGL_thread_group_start(ACGL_thread_group_t* group, const char* name) {
+	REQUIRES(group != NULL);
+
+	if (group->phase != NULL) {
+		ACGL_barrier_reset(group->phase, (Uint32)group->members_size);
+	}
+
+	char thread_name[64];
+	for (size_t i=0; i<group->members_size; ++i) {
+		snprintf(thread_name, sizeof(thread_name), "%s-%u", name != NULL ? name : "acgl", (unsigned)i);
+		if (ACGL_thread_start(group->members[i], thread_name) != 0) {
+			fprintf(stderr, "Error: could not start member %u in ACGL_thread_group_start\n", (unsigned)i);
+			ACGL_thread_group_stop(group);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Joins every running member. Returns: 0 if all of them returned 0
+static int __acgl_thread_group_join(ACGL_thread_group_t* group) {
+	int result = 0;
+	for (size_t i=0; i<group->members_size; ++i) {
+		if (ACGL_thread_is_running(group->members[i]) && ACGL_thread_join(group->members[i]) != 0) {
+			result = -1;
+		}
+	}
+	return result;
+}
+
+int ACGL_thread_group_stop(ACGL_thread_group_t* group) {
+	REQUIRES(group != NULL);
+
+	// signal everyone before waiting on anyone
+	for (size_t i=0; i<group->members_size; ++i) {
+		if (ACGL_thread_is_running(group->members[i])) {
+			ACGL_thread_request_stop(group->members[i]);
+		}
+	}
+	if (group->phase != NULL) {
+		ACGL_barrier_cancel(group->phase);
+	}
+	return __acgl_thread_group_join(group);
+}
+
+int ACGL_thread_group_wait(ACGL_thread_group_t* group) {
+	REQUIRES(group != NULL);
+	return __acgl_thread_group_join(group);
+}
+
+bool ACGL_thread_group_sync(ACGL_thread_group_t* group, Uint32 timeout_ms) {
+	REQUIRES(group != NULL);
+	if (group->phase == NULL) {
+		fprintf(stderr, "Error: phase sync is not enabled in ACGL_thread_group_sync\n");
+		return false;
+	}
+	return ACGL_barrier_wait_arrivals(group->phase, timeout_ms);
+}
+
+void ACGL_thread_group_release(ACGL_thread_group_t* group) {
+	REQUIRES(group != NULL);
+	if (group->phase != NULL) {
+		ACGL_barrier_release(group->phase);
+	}
+}
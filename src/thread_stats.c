@@ -0,0 +1,68 @@
+#include "thread_stats.h"
+#include "contracts.h"
+
+static int __acgl_histogram_bucket(Uint64 value) {
+	if (value < ((Uint64)1 << ACGL_HISTOGRAM_SUB_BITS)) {
+		return (int)value;
+	}
+	int exponent = 63 - __builtin_clzll(value);
+	if (exponent > ACGL_HISTOGRAM_MAX_BITS) {
+		return ACGL_HISTOGRAM_BUCKETS - 1;
+	}
+	int sub = (int)(value >> (exponent - ACGL_HISTOGRAM_SUB_BITS)) & ((1 << ACGL_HISTOGRAM_SUB_BITS) - 1);
+	return ((exponent - ACGL_HISTOGRAM_SUB_BITS + 1) << ACGL_HISTOGRAM_SUB_BITS) + sub;
+}
+
+// Returns: largest value that lands in bucket
+static Uint64 __acgl_histogram_bucket_max(int bucket) {
+	if (bucket < (1 << ACGL_HISTOGRAM_SUB_BITS)) {
+		return (Uint64)bucket;
+	}
+	int exponent = (bucket >> ACGL_HISTOGRAM_SUB_BITS) + ACGL_HISTOGRAM_SUB_BITS - 1;
+	Uint64 sub = (Uint64)(bucket & ((1 << ACGL_HISTOGRAM_SUB_BITS) - 1));
+	Uint64 width = (Uint64)1 << (exponent - ACGL_HISTOGRAM_SUB_BITS);
+	return ((Uint64)1 << exponent) + (sub + 1) * width - 1;
+}
+
+void ACGL_histogram_reset(ACGL_histogram_t* histogram) {
+	REQUIRES(histogram != NULL);
+	memset(histogram, 0, sizeof(ACGL_histogram_t));
+}
+
+void ACGL_histogram_record(ACGL_histogram_t* histogram, Uint64 value) {
+	REQUIRES(histogram != NULL);
+	if (histogram->count == 0 || value < histogram->min) {
+		histogram->min = value;
+	}
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+	++histogram->count;
+	histogram->sum += value;
+	++histogram->buckets[__acgl_histogram_bucket(value)];
+}
+
+Uint64 ACGL_histogram_percentile(const ACGL_histogram_t* histogram, double p) {
+	REQUIRES(histogram != NULL);
+	if (histogram->count == 0) {
+		return 0;
+	}
+	Uint64 rank = (Uint64)(p * (double)histogram->count + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+	Uint64 seen = 0;
+	for (int bucket=0; bucket<ACGL_HISTOGRAM_BUCKETS; ++bucket) {
+		seen += histogram->buckets[bucket];
+		if (seen >= rank && bucket != ACGL_HISTOGRAM_BUCKETS - 1) {
+			Uint64 bound = __acgl_histogram_bucket_max(bucket);
+			return bound > histogram->max ? histogram->max : bound;
+		}
+	}
+	return histogram->max;
+}
+
+void ACGL_thread_stats_reset(ACGL_thread_stats_t* stats) {
+	REQUIRES(stats != NULL);
+	memset(stats, 0, sizeof(ACGL_thread_stats_t));
+}
@@ -1,7 +1,35 @@
+#ifdef __linux__
+// for sched_setaffinity and the CPU_SET macros
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
 #include "threads.h"
+#include "alloc.h"
+#include "thread_group.h"
 #include "contracts.h"
 
-Uint32 ACGL_THREAD_DELAY_CUTOFF = 5;
+Uint32 ACGL_THREAD_DELAY_CUTOFF = 2;
+
+#define ACGL_SNAPSHOT_FRESH 4
+
+// Thread-local slot that ACGL_thread_current reads, created on first use
+static SDL_atomic_t __acgl_thread_tls;
+static SDL_SpinLock __acgl_thread_tls_lock = 0;
+
+static SDL_TLSID __acgl_thread_get_tls(void) {
+	SDL_TLSID id = (SDL_TLSID)SDL_AtomicGet(&__acgl_thread_tls);
+	if (id == 0) {
+		SDL_AtomicLock(&__acgl_thread_tls_lock);
+		id = (SDL_TLSID)SDL_AtomicGet(&__acgl_thread_tls);
+		if (id == 0) {
+			id = SDL_TLSCreate();
+			SDL_AtomicSet(&__acgl_thread_tls, (int)id);
+		}
+		SDL_AtomicUnlock(&__acgl_thread_tls_lock);
+	}
+	return id;
+}
 
 // Safety functions
 bool __acgl_is_thread_data(ACGL_thread_data_t* data) {
@@ -9,12 +37,22 @@ bool __acgl_is_thread_data(ACGL_thread_data_t* data) {
 		fprintf(stderr, "Error, internal thread data is NULL!\n");
 		return false;
 	}
+#if ACGL_THREADING
 	if (data->mutex == NULL) {
 		fprintf(stderr, "Error, thread data has no mutex!\n");
 		return false;
 	}
-	if (data->min_tick < ACGL_THREAD_DELAY_CUTOFF) {
-		fprintf(stderr, "Error, thread data wants to loop faster than we can handle!\n");
+#endif
+	if (data->wake == NULL) {
+		fprintf(stderr, "Error, thread data has no wake semaphore!\n");
+		return false;
+	}
+	if (data->overrun_policy != ACGL_THREAD_OVERRUN_SKIP && data->overrun_policy != ACGL_THREAD_OVERRUN_CATCH_UP) {
+		fprintf(stderr, "Error, thread data has an unknown overrun policy!\n");
+		return false;
+	}
+	if (data->thread_class < ACGL_THREAD_CLASS_NORMAL || data->thread_class > ACGL_THREAD_CLASS_DEADLINE) {
+		fprintf(stderr, "Error, thread data has an unknown scheduling class!\n");
 		return false;
 	}
 	return true;
@@ -28,10 +66,6 @@ bool __acgl_is_thread(ACGL_thread_t* target) {
 		fprintf(stderr, "Error, thread has no data!\n");
 		return false;
 	}
-	if (target->data->running && target->thread == NULL) {
-		fprintf(stderr, "Error, thread set to running, but no associated thread handle!\n");
-		return false;
-	}
 	/* if (!target->data->running && target->thread != NULL) {
 	  fprintf(stderr, "Error, thread handle acquired but not running!\n");
 	  return false;
@@ -42,21 +76,63 @@ bool __acgl_is_thread(ACGL_thread_t* target) {
 
 
 ACGL_thread_t* ACGL_thread_create(ACGL_tick_callback_t setupfn, ACGL_tick_callback_t tickfn, ACGL_tick_callback_t cleanupfn, Uint32 min_tick, void* extra_data, ACGL_destroy_callback_t extra_data_destroy) {
-	ACGL_thread_data_t* data = (ACGL_thread_data_t*)malloc(sizeof(ACGL_thread_data_t));
+	ACGL_thread_data_t* data = (ACGL_thread_data_t*)ACGL_malloc(ACGL_ALLOC_THREADS, sizeof(ACGL_thread_data_t));
 	if (data == NULL) {
 		fprintf(stderr, "Error: could not malloc thread data in ACGL_thread_create!\n");
 		return NULL;
 	}
-	data->mutex = SDL_CreateMutex();
-	data->running = false;
-	data->min_tick = min_tick;
+	bool created = ACGL_MUTEX_CREATE(data->mutex);
+	data->wake = SDL_CreateSemaphore(0);
+	if (!created || data->wake == NULL) {
+		fprintf(stderr, "Error: could not create thread synchronization in ACGL_thread_create! SDL_Error: %s\n", SDL_GetError());
+		if (created) {
+			ACGL_MUTEX_DESTROY(data->mutex);
+		}
+		if (data->wake != NULL) {
+			SDL_DestroySemaphore(data->wake);
+		}
+		ACGL_free(data);
+		return NULL;
+	}
+	SDL_AtomicSet(&data->running, 0);
+	SDL_AtomicSet(&data->stop_requested, 0);
+	data->period = (Uint64)min_tick * ACGL_CLOCK_NS_PER_MS;
+	data->overrun_policy = ACGL_THREAD_OVERRUN_SKIP;
+	data->max_catch_up = 0;
+	data->thread_class = ACGL_THREAD_CLASS_NORMAL;
+	data->priority = -1;
+	data->affinity = 0;
+	data->stack_size = 0;
+	data->tick_barrier = NULL;
+	data->inbox = NULL;
+	SDL_AtomicSet(&data->inbox_dropped, 0);
+	data->stats_callback = NULL;
+	data->stats_callback_data = NULL;
+	data->stats_interval = 0;
+	data->stats = (ACGL_thread_stats_t*)ACGL_malloc(ACGL_ALLOC_THREADS, sizeof(ACGL_thread_stats_t));
+	data->stats_snapshot = ACGL_snapshot_create(sizeof(ACGL_thread_stats_t));
+	if (data->stats == NULL || data->stats_snapshot == NULL) {
+		fprintf(stderr, "Error: could not malloc thread stats in ACGL_thread_create!\n");
+		ACGL_free(data->stats);
+		if (data->stats_snapshot != NULL) {
+			ACGL_snapshot_destroy(data->stats_snapshot);
+		}
+		ACGL_MUTEX_DESTROY(data->mutex);
+		SDL_DestroySemaphore(data->wake);
+		ACGL_free(data);
+		return NULL;
+	}
+	ACGL_thread_stats_reset(data->stats);
 	data->extra_data = extra_data;
 
-	ACGL_thread_t* thread = (ACGL_thread_t*)malloc(sizeof(ACGL_thread_t));
+	ACGL_thread_t* thread = (ACGL_thread_t*)ACGL_malloc(ACGL_ALLOC_THREADS, sizeof(ACGL_thread_t));
 	if (thread == NULL) {
 		fprintf(stderr, "Error: could not malloc thread object in ACGL_thread_create!\n");
-		SDL_DestroyMutex(data->mutex);
-		free(data);
+		ACGL_MUTEX_DESTROY(data->mutex);
+		SDL_DestroySemaphore(data->wake);
+		ACGL_free(data->stats);
+		ACGL_snapshot_destroy(data->stats_snapshot);
+		ACGL_free(data);
 		return NULL;
 	}
 	thread->thread = NULL;
@@ -70,6 +146,98 @@ ACGL_thread_t* ACGL_thread_create(ACGL_tick_callback_t setupfn, ACGL_tick_callba
 	return thread;
 }
 
+void ACGL_thread_set_period(ACGL_thread_t* target, Uint64 period_ns) {
+	REQUIRES(__acgl_is_thread(target));
+	target->data->period = period_ns;
+}
+
+void ACGL_thread_set_overrun_policy(ACGL_thread_t* target, int policy, Uint32 max_catch_up) {
+	REQUIRES(__acgl_is_thread(target));
+	target->data->overrun_policy = policy;
+	target->data->max_catch_up = max_catch_up;
+	ENSURES(__acgl_is_thread(target));
+}
+
+void ACGL_thread_set_class(ACGL_thread_t* target, int thread_class) {
+	REQUIRES(__acgl_is_thread(target));
+	target->data->thread_class = thread_class;
+	ENSURES(__acgl_is_thread(target));
+}
+
+void ACGL_thread_set_priority(ACGL_thread_t* target, SDL_ThreadPriority priority) {
+	REQUIRES(__acgl_is_thread(target));
+	target->data->priority = (int)priority;
+}
+
+void ACGL_thread_set_stack_size(ACGL_thread_t* target, size_t stack_size) {
+	REQUIRES(__acgl_is_thread(target));
+	target->data->stack_size = stack_size;
+}
+
+int ACGL_thread_set_affinity(ACGL_thread_t* target, Uint64 cpu_mask) {
+	REQUIRES(__acgl_is_thread(target));
+#ifdef __linux__
+	target->data->affinity = cpu_mask;
+	return 0;
+#else
+	(void)cpu_mask;
+	fprintf(stderr, "Error: CPU affinity is not supported on this platform in ACGL_thread_set_affinity\n");
+	return -1;
+#endif
+}
+
+void ACGL_thread_set_stats_callback(ACGL_thread_t* target, ACGL_thread_stats_callback_t callback, Uint64 interval_ns, void* data) {
+	REQUIRES(__acgl_is_thread(target));
+	target->data->stats_callback = callback;
+	target->data->stats_callback_data = data;
+	target->data->stats_interval = interval_ns;
+}
+
+bool ACGL_thread_get_stats(ACGL_thread_t* target, ACGL_thread_stats_t* out) {
+	REQUIRES(__acgl_is_thread(target));
+	REQUIRES(out != NULL);
+	memcpy(out, ACGL_snapshot_read(target->data->stats_snapshot, NULL), sizeof(ACGL_thread_stats_t));
+	return out->ticks != 0;
+}
+
+int ACGL_thread_enable_inbox(ACGL_thread_t* target, Uint32 capacity) {
+	REQUIRES(__acgl_is_thread(target));
+	REQUIRES(!ACGL_thread_is_running(target));
+	REQUIRES(capacity > 0);
+	if (target->data->inbox != NULL) {
+		return 0;
+	}
+	target->data->inbox = ACGL_channel_create(ACGL_CHANNEL_MPSC, sizeof(ACGL_thread_message_t), capacity);
+	if (target->data->inbox == NULL) {
+		fprintf(stderr, "Error: could not create inbox in ACGL_thread_enable_inbox!\n");
+		return -1;
+	}
+	return 0;
+}
+
+bool ACGL_thread_post(ACGL_thread_t* target, ACGL_thread_event_callback_t callback, void* data, const SDL_Event* event) {
+	REQUIRES(__acgl_is_thread(target));
+	REQUIRES(callback != NULL);
+	REQUIRES(event != NULL);
+	if (target->data->inbox == NULL) {
+		return false;
+	}
+	ACGL_thread_message_t message;
+	message.callback = callback;
+	message.data = data;
+	message.event = *event;
+	if (ACGL_channel_send(target->data->inbox, &message, 1) != 1) {
+		SDL_AtomicAdd(&target->data->inbox_dropped, 1);
+		return false;
+	}
+	return true;
+}
+
+Uint32 ACGL_thread_inbox_dropped(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
+	return (Uint32)SDL_AtomicGet(&target->data->inbox_dropped);
+}
+
 int ACGL_thread_start(ACGL_thread_t* target, const char* thread_name) {
 	REQUIRES(__acgl_is_thread(target));
 
@@ -78,58 +246,130 @@ int ACGL_thread_start(ACGL_thread_t* target, const char* thread_name) {
 		return -1;
 	}
 
-	if (SDL_LockMutex(target->data->mutex) != 0) {
-		fprintf(stderr, "Error locking mutex in ACGL_thread_start. SDL_Error: %s", SDL_GetError());
+	if (!SDL_AtomicCAS(&target->data->running, 0, 1)) {
+		fprintf(stderr, "Error: Attempted to start already-running thread!\n");
 		return -1;
 	}
 
-	if (target->data->running) {
-		fprintf(stderr, "Error: Attempted to start already-running thread!\n");
-		SDL_UnlockMutex(target->data->mutex);
+	// throw away wakeups left over from the last run
+	SDL_AtomicSet(&target->data->stop_requested, 0);
+	while (SDL_SemTryWait(target->data->wake) == 0) {}
+
+	printf("parent: starting thread %p", (void*)target);
+	if (target->data->stack_size != 0) {
+		target->thread = SDL_CreateThreadWithStackSize(
+			&ACGL_thread_mainloop,
+			thread_name,
+			target->data->stack_size,
+			target
+		);
+	} else {
+		target->thread = SDL_CreateThread(
+			&ACGL_thread_mainloop,
+			thread_name,
+			target
+		);
+	}
+	if (target->thread == NULL) {
+		fprintf(stderr, "Error: could not create thread in ACGL_thread_start. SDL_Error: %s\n", SDL_GetError());
+		SDL_AtomicSet(&target->data->running, 0);
 		return -1;
 	}
 
-	target->data->running = true;
-	printf("parent: starting thread %p", (void*)target);
-	target->thread = SDL_CreateThread(
-		&ACGL_thread_mainloop,
-		thread_name,
-		target
-	);
+	ENSURES(__acgl_is_thread(target));
+	return 0;
+}
+
+void ACGL_thread_request_stop(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
 
-	SDL_UnlockMutex(target->data->mutex);
+	if (SDL_AtomicSet(&target->data->stop_requested, 1) == 0) {
+		SDL_SemPost(target->data->wake);
+	}
+}
+
+int ACGL_thread_join(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
+	if (target == NULL) {
+		fprintf(stderr, "Error: tried to join a NULL thread in ACGL_thread_join\n");
+		return -1;
+	}
+
+	if (!SDL_AtomicGet(&target->data->running) || target->thread == NULL) {
+		fprintf(stderr, "Error: tried to join already-stopped thread in ACGL_thread_join\n");
+		return -1;
+	}
+
+	int result;
+	SDL_WaitThread(target->thread, &result);
+	target->thread = NULL;
+	SDL_AtomicSet(&target->data->running, 0);
 
 	ENSURES(__acgl_is_thread(target));
-	return 0;
+	return result;
 }
 
 int ACGL_thread_stop(ACGL_thread_t* target) {
 	REQUIRES(__acgl_is_thread(target));
 	if (target == NULL) {
 		fprintf(stderr, "Error: tried to stop a NULL thread in ACGL_thread_stop\n");
-		return false;
+		return -1;
 	}
 
-	if (SDL_LockMutex(target->data->mutex) != 0) {
-		fprintf(stderr, "Error locking mutex in ACGL_thread_stop. SDL_Error: %s", SDL_GetError());
-		return false;
+	if (!SDL_AtomicGet(&target->data->running)) {
+		fprintf(stderr, "Error: thread to stop already-stopped thread in ACGL_thread_stop\n");
+		return -1;
 	}
 
+	ACGL_thread_request_stop(target);
+	return ACGL_thread_join(target);
+}
 
-	if (!target->data->running) {
-		fprintf(stderr, "Error: thread to stop already-stopped thread in ACGL_thread_stop\n");
-		SDL_UnlockMutex(target->data->mutex);
-		return false;
-	}
+bool ACGL_thread_is_running(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
+	return SDL_AtomicGet(&target->data->running) != 0;
+}
 
-	target->data->running = false;
-	SDL_UnlockMutex(target->data->mutex);
+bool ACGL_thread_should_stop(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
+	return SDL_AtomicGet(&target->data->stop_requested) != 0;
+}
 
-	int result;
-	SDL_WaitThread(target->thread, &result);
+ACGL_thread_t* ACGL_thread_current(void) {
+	return (ACGL_thread_t*)SDL_TLSGet(__acgl_thread_get_tls());
+}
 
-	ENSURES(__acgl_is_thread(target));
-	return result;
+int ACGL_thread_lock_data(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
+	if (ACGL_thread_current() == target) {
+		// only the thread itself may touch its stats. if the lock is
+		// free there is no wait worth reading the clock for
+		++target->data->stats->lock_waits;
+		if (ACGL_MUTEX_TRYLOCK(target->data->mutex) == 0) {
+			return 0;
+		}
+		Uint64 started = ACGL_clock_now();
+		if (ACGL_MUTEX_LOCK(target->data->mutex) != 0) {
+			fprintf(stderr, "Error locking mutex in ACGL_thread_lock_data. SDL_Error: %s\n", SDL_GetError());
+			return -1;
+		}
+		target->data->stats->lock_wait += ACGL_clock_now() - started;
+		return 0;
+	}
+
+	if (ACGL_MUTEX_LOCK(target->data->mutex) != 0) {
+		fprintf(stderr, "Error locking mutex in ACGL_thread_lock_data. SDL_Error: %s\n", SDL_GetError());
+		return -1;
+	}
+	return 0;
+}
+
+void ACGL_thread_unlock_data(ACGL_thread_t* target) {
+	REQUIRES(__acgl_is_thread(target));
+#if !ACGL_THREADING
+	(void)target; // the unlock below compiles away
+#endif
+	ACGL_MUTEX_UNLOCK(target->data->mutex);
 }
 
 void ACGL_thread_destroy(ACGL_thread_t* target) {
@@ -142,78 +382,277 @@ void ACGL_thread_destroy(ACGL_thread_t* target) {
 				}
 				target->data->extra_data = NULL;
 			}
-			if (target->data->mutex != NULL) {
-				SDL_DestroyMutex(target->data->mutex);
-				target->data->mutex = NULL;
+			ACGL_MUTEX_DESTROY(target->data->mutex);
+			if (target->data->wake != NULL) {
+				SDL_DestroySemaphore(target->data->wake);
+				target->data->wake = NULL;
+			}
+			if (target->data->inbox != NULL) {
+				ACGL_channel_destroy(target->data->inbox);
+				target->data->inbox = NULL;
+			}
+			ACGL_free(target->data->stats);
+			target->data->stats = NULL;
+			if (target->data->stats_snapshot != NULL) {
+				ACGL_snapshot_destroy(target->data->stats_snapshot);
+				target->data->stats_snapshot = NULL;
 			}
-			free(target->data);
+			ACGL_free(target->data);
 			target->data = NULL;
 		}
-		free(target);
+		ACGL_free(target);
+	}
+}
+
+// Like ACGL_clock_sleep_until, but the sleeping part can be interrupted by
+// ACGL_thread_request_stop. With spin 0 we never busy-wait and may wake up late.
+// Returns: false if a stop was requested
+static bool __acgl_thread_sleep_until(ACGL_thread_data_t* data, Uint64 deadline, Uint64 spin) {
+	Uint64 now = ACGL_clock_now();
+	while (now < deadline) {
+		if (SDL_AtomicGet(&data->stop_requested)) {
+			return false;
+		}
+		Uint64 remaining = deadline - now;
+		if (remaining > spin + ACGL_CLOCK_NS_PER_MS) {
+			SDL_SemWaitTimeout(data->wake, (Uint32)((remaining - spin) / ACGL_CLOCK_NS_PER_MS));
+		} else if (spin == 0) {
+			SDL_SemWaitTimeout(data->wake, 1);
+		}
+		now = ACGL_clock_now();
+	}
+	return !SDL_AtomicGet(&data->stop_requested);
+}
+
+// Applies the thread's class, priority and affinity to the calling thread
+static void __acgl_thread_apply_qos(ACGL_thread_data_t* data) {
+	int priority = data->priority;
+	if (priority < 0) {
+		switch (data->thread_class) {
+		case ACGL_THREAD_CLASS_BACKGROUND:  priority = SDL_THREAD_PRIORITY_LOW; break;
+		case ACGL_THREAD_CLASS_INTERACTIVE: priority = SDL_THREAD_PRIORITY_HIGH; break;
+		case ACGL_THREAD_CLASS_DEADLINE:    priority = SDL_THREAD_PRIORITY_TIME_CRITICAL; break;
+		default:                            priority = SDL_THREAD_PRIORITY_NORMAL; break;
+		}
+	}
+	if (priority != SDL_THREAD_PRIORITY_NORMAL && SDL_SetThreadPriority((SDL_ThreadPriority)priority) != 0) {
+		// usually missing permissions, the thread still works
+		fprintf(stderr, "Warning: could not set thread priority in ACGL_thread_mainloop. SDL_Error: %s\n", SDL_GetError());
+	}
+
+#ifdef __linux__
+	if (data->affinity != 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu=0; cpu<64; ++cpu) {
+			if (data->affinity & ((Uint64)1 << cpu)) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		if (sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0) {
+			fprintf(stderr, "Warning: could not set thread affinity in ACGL_thread_mainloop\n");
+		}
+	}
+#endif
+}
+
+// How close to a deadline the thread starts spinning, see ACGL_THREAD_CLASS
+static Uint64 __acgl_thread_spin(ACGL_thread_data_t* data) {
+	Uint64 spin = (Uint64)ACGL_THREAD_DELAY_CUTOFF * ACGL_CLOCK_NS_PER_MS;
+	switch (data->thread_class) {
+	case ACGL_THREAD_CLASS_BACKGROUND: return 0;
+	case ACGL_THREAD_CLASS_DEADLINE:   return spin * 2;
+	default:                           return spin;
+	}
+}
+
+static void __acgl_thread_publish_stats(ACGL_thread_data_t* data) {
+	memcpy(ACGL_snapshot_write_buffer(data->stats_snapshot), data->stats, sizeof(ACGL_thread_stats_t));
+	ACGL_snapshot_publish(data->stats_snapshot);
+}
+
+// Runs everything posted before this tick started. Messages posted while
+// we drain wait for the next tick, so a busy sender can't starve tickfn
+static void __acgl_thread_drain_inbox(ACGL_channel_t* inbox) {
+	ACGL_thread_message_t batch[ACGL_THREAD_INBOX_BATCH];
+	Uint32 remaining = ACGL_channel_size(inbox);
+	while (remaining > 0) {
+		size_t count = ACGL_channel_recv(inbox, batch, SDL_min(remaining, ACGL_THREAD_INBOX_BATCH));
+		if (count == 0) {
+			break;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			(*batch[i].callback)(&batch[i].event, batch[i].data);
+		}
+		remaining -= (Uint32)count;
 	}
 }
 
 int ACGL_thread_mainloop(void* data) {
 	ACGL_thread_t* target = (ACGL_thread_t*)data;
 	printf("child: starting thread %p", (void*)target);
-	REQUIRES(__acgl_is_thread(target));
+	REQUIRES(target != NULL && __acgl_is_thread_data(target->data));
+	SDL_TLSSet(__acgl_thread_get_tls(), target, NULL);
+	__acgl_thread_apply_qos(target->data);
 	// Each thread needs to re-seed independently
 	// for whatever reason
 	// I can't believe they didn't make `rand` return
 	// well-seeded numbers by default
 	srand((unsigned)time(NULL));
 
-	// We wouldn't need mutexes if just the target->data->running was read,
-	// but because the target->data->extra data can be modified, we take
-	// extra precautions
+	// None of the callbacks run with target->data->mutex held, so
+	// ACGL_thread_stop and the main thread never wait on a whole tick.
+	// Anything shared through extra_data has to be guarded with
+	// ACGL_thread_lock_data by both sides.
+	ACGL_thread_stats_reset(target->data->stats);
+	__acgl_thread_publish_stats(target->data);
+
 	bool unlocked_running = true;
 	if (target->setupfn != NULL) {
-		if (SDL_LockMutex(target->data->mutex) != 0) {
-			fprintf(stderr, "Could not lock mutex while setting up in ACGL_thread_mainloop! SDL_Error: %s", SDL_GetError());
-			return 1;
-		}
 		unlocked_running = (*target->setupfn)(target->data->extra_data);
-		SDL_UnlockMutex(target->data->mutex);
 	}
 
-	while (unlocked_running) {
-		if (SDL_LockMutex(target->data->mutex) != 0) {
-			fprintf(stderr, "Could not lock mutex in loop in ACGL_thread_mainloop! SDL_Error: %s", SDL_GetError());
-			return 1;
-		}
+	// Deadlines are absolute so time spent in tickfn and oversleeping
+	// doesn't accumulate into drift
+	Uint64 period = target->data->period;
+	Uint64 spin = __acgl_thread_spin(target->data);
+	Uint64 next_tick = ACGL_clock_now();
+	Uint32 caught_up = 0;
+
+	ACGL_thread_stats_t* stats = target->data->stats;
+	Uint64 last_lateness = 0;
+	Uint64 last_published = next_tick;
+	Uint64 last_reported = next_tick;
 
-		if (!target->data->running) {
+	while (unlocked_running) {
+		if (SDL_AtomicGet(&target->data->stop_requested)) {
 			// quit loop immediately
-			unlocked_running = false;
-			SDL_UnlockMutex(target->data->mutex);
 			break;
 		}
 
-		Uint32 started = SDL_GetTicks();
+		Uint64 started = ACGL_clock_now();
+		if (target->data->inbox != NULL) {
+			__acgl_thread_drain_inbox(target->data->inbox);
+		}
 		if (target->tickfn != NULL) {
 			unlocked_running = (*target->tickfn)(target->data->extra_data);
 		}
-		// We need to unlock mutex as soon as possible so we can be
-		// alerted of stopping
-		SDL_UnlockMutex(target->data->mutex);
+		Uint64 now = ACGL_clock_now();
+
+		++stats->ticks;
+		ACGL_histogram_record(&stats->duration, now - started);
+		if (period != 0) {
+			Uint64 lateness = started > next_tick ? started - next_tick : 0;
+			ACGL_histogram_record(&stats->lateness, lateness);
+			Uint64 change = lateness > last_lateness ? lateness - last_lateness : last_lateness - lateness;
+			stats->jitter = (Uint64)((Sint64)stats->jitter + ((Sint64)change - (Sint64)stats->jitter) / 16);
+			last_lateness = lateness;
+		}
+		if (now - last_published >= ACGL_THREAD_STATS_PUBLISH_INTERVAL) {
+			__acgl_thread_publish_stats(target->data);
+			last_published = now;
+		}
+		if (target->data->stats_callback != NULL && now - last_reported >= target->data->stats_interval) {
+			(*target->data->stats_callback)(stats, target->data->stats_callback_data);
+			last_reported = now;
+		}
+		if (target->data->tick_barrier != NULL) {
+			// parked until the group's controller releases this phase. a
+			// cancelled barrier means we are being stopped, which the
+			// top of the loop picks up
+			ACGL_barrier_wait(target->data->tick_barrier);
+			now = ACGL_clock_now();
+		}
+
+		if (period == 0) {
+			continue;
+		}
 
-		Uint32 elapsed = SDL_GetTicks() - started;
-		if (
-			target->data->min_tick > ACGL_THREAD_DELAY_CUTOFF &&
-			elapsed < target->data->min_tick - ACGL_THREAD_DELAY_CUTOFF
-			) {
-			SDL_Delay(target->data->min_tick - elapsed);
+		next_tick += period;
+		if (now >= next_tick) {
+			// overran the deadline of the next tick
+			++stats->overruns;
+			if (
+				target->data->overrun_policy == ACGL_THREAD_OVERRUN_CATCH_UP &&
+				caught_up < target->data->max_catch_up
+				) {
+				// start the next tick right away and stay on the original schedule
+				++caught_up;
+				continue;
+			}
+			// skip to the first deadline still in the future, keeping our phase
+			Uint64 skipped = (now - next_tick) / period + 1;
+			stats->skipped += skipped;
+			next_tick += skipped * period;
+		}
+		caught_up = 0;
+		if (!__acgl_thread_sleep_until(target->data, next_tick, spin)) {
+			break;
 		}
 	}
 
+	if (target->data->tick_barrier != NULL) {
+		// don't leave the rest of the group waiting on us
+		ACGL_barrier_leave(target->data->tick_barrier);
+	}
 	if (target->cleanupfn != NULL) {
-		if (SDL_LockMutex(target->data->mutex) != 0) {
-			fprintf(stderr, "Could not lock mutex while cleaning up in ACGL_thread_mainloop! SDL_Error: %s", SDL_GetError());
-			return 1;
-		}
 		unlocked_running = (*target->cleanupfn)(target->data->extra_data);
-		SDL_UnlockMutex(target->data->mutex);
 	}
+	__acgl_thread_publish_stats(target->data);
 
 	return 0;
 }
+
+ACGL_snapshot_t* ACGL_snapshot_create(size_t size) {
+	ACGL_snapshot_t* snapshot = (ACGL_snapshot_t*)ACGL_malloc(ACGL_ALLOC_THREADS, sizeof(ACGL_snapshot_t));
+	if (snapshot == NULL) {
+		fprintf(stderr, "Error: could not malloc snapshot in ACGL_snapshot_create!\n");
+		return NULL;
+	}
+	snapshot->buffers = (Uint8*)ACGL_calloc(ACGL_ALLOC_THREADS, 3, size);
+	if (snapshot->buffers == NULL) {
+		fprintf(stderr, "Error: could not malloc snapshot buffers in ACGL_snapshot_create!\n");
+		ACGL_free(snapshot);
+		return NULL;
+	}
+	snapshot->size = size;
+	snapshot->back = 0;
+	SDL_AtomicSet(&snapshot->middle, 1);
+	snapshot->front = 2;
+	return snapshot;
+}
+
+void ACGL_snapshot_destroy(ACGL_snapshot_t* snapshot) {
+	if (snapshot != NULL) {
+		ACGL_free(snapshot->buffers);
+		snapshot->buffers = NULL;
+		ACGL_free(snapshot);
+	}
+}
+
+void* ACGL_snapshot_write_buffer(ACGL_snapshot_t* snapshot) {
+	REQUIRES(snapshot != NULL);
+	return snapshot->buffers + (size_t)snapshot->back * snapshot->size;
+}
+
+void ACGL_snapshot_publish(ACGL_snapshot_t* snapshot) {
+	REQUIRES(snapshot != NULL);
+	// SDL_AtomicSet is a full barrier, so the writes to the back buffer
+	// are visible before the reader can swap it in
+	int old = SDL_AtomicSet(&snapshot->middle, snapshot->back | ACGL_SNAPSHOT_FRESH);
+	snapshot->back = old & ~ACGL_SNAPSHOT_FRESH;
+}
+
+const void* ACGL_snapshot_read(ACGL_snapshot_t* snapshot, bool* fresh) {
+	REQUIRES(snapshot != NULL);
+	bool swapped = false;
+	if (SDL_AtomicGet(&snapshot->middle) & ACGL_SNAPSHOT_FRESH) {
+		int old = SDL_AtomicSet(&snapshot->middle, snapshot->front);
+		snapshot->front = old & ~ACGL_SNAPSHOT_FRESH;
+		swapped = true;
+	}
+	if (fresh != NULL) {
+		*fresh = swapped;
+	}
+	return snapshot->buffers + (size_t)snapshot->front * snapshot->size;
+}
@@ -0,0 +1,341 @@
+#include "timer.h"
+#include "alloc.h"
+#include "contracts.h"
+
+enum ACGL_TIMER_STATE {
+	ACGL_TIMER_FREE,
+	ACGL_TIMER_SCHEDULED,
+	ACGL_TIMER_FIRING, // one-shot timer collected by advance, not dispatched yet
+};
+
+static ACGL_timer_id_t __acgl_timer_make_id(Uint32 index, Uint32 generation) {
+	return ((Uint64)generation << 32) | (Uint64)(index + 1);
+}
+
+// Returns: the timer the id refers to, NULL if that timer no longer exists
+static ACGL_timer_t* __acgl_timer_lookup(ACGL_timer_wheel_t* wheel, ACGL_timer_id_t id) {
+	Uint32 index = (Uint32)(id & 0xFFFFFFFFu) - 1;
+	if (id == 0 || index >= wheel->timers_size) {
+		return NULL;
+	}
+	ACGL_timer_t* timer = &wheel->timers[index];
+	if (timer->state == ACGL_TIMER_FREE || timer->generation != (Uint32)(id >> 32)) {
+		return NULL;
+	}
+	return timer;
+}
+
+static void __acgl_timer_release(ACGL_timer_wheel_t* wheel, Uint32 index) {
+	ACGL_timer_t* timer = &wheel->timers[index];
+	timer->state = ACGL_TIMER_FREE;
+	// invalidates every id handed out for this slot
+	++timer->generation;
+	timer->next = wheel->free_list;
+	wheel->free_list = index;
+}
+
+static void __acgl_timer_link(ACGL_timer_wheel_t* wheel, Uint32 index) {
+	ACGL_timer_t* timer = &wheel->timers[index];
+	if (timer->expires < wheel->now) {
+		timer->expires = wheel->now;
+	}
+	Uint64 delta = timer->expires - wheel->now;
+
+	int level = 0;
+	while (level < ACGL_TIMER_LEVELS - 1 && delta >= ((Uint64)1 << (ACGL_TIMER_SLOTS_BITS * (level + 1)))) {
+		++level;
+	}
+	Uint64 limit = (Uint64)1 << (ACGL_TIMER_SLOTS_BITS * ACGL_TIMER_LEVELS);
+	// further out than the wheel reaches, park it in the last slot it can.
+	// expires is kept, the cascade just links it again from there
+	Uint64 at = delta >= limit ? wheel->now + limit - 1 : timer->expires;
+	Uint32 slot = (Uint32)(at >> (ACGL_TIMER_SLOTS_BITS * level)) & (ACGL_TIMER_SLOTS - 1);
+
+	Uint32* head = &wheel->slots[level][slot];
+	timer->slot = (Uint16)(level * ACGL_TIMER_SLOTS + slot);
+	timer->prev = ACGL_TIMER_NIL;
+	timer->next = *head;
+	if (*head != ACGL_TIMER_NIL) {
+		wheel->timers[*head].prev = index;
+	}
+	*head = index;
+	timer->state = ACGL_TIMER_SCHEDULED;
+}
+
+static void __acgl_timer_unlink(ACGL_timer_wheel_t* wheel, Uint32 index) {
+	ACGL_timer_t* timer = &wheel->timers[index];
+	Uint32* head = &wheel->slots[timer->slot / ACGL_TIMER_SLOTS][timer->slot % ACGL_TIMER_SLOTS];
+	if (timer->prev != ACGL_TIMER_NIL) {
+		wheel->timers[timer->prev].next = timer->next;
+	} else {
+		*head = timer->next;
+	}
+	if (timer->next != ACGL_TIMER_NIL) {
+		wheel->timers[timer->next].prev = timer->prev;
+	}
+	timer->prev = ACGL_TIMER_NIL;
+	timer->next = ACGL_TIMER_NIL;
+}
+
+// Moves every timer in a higher level slot down to where it belongs now
+static void __acgl_timer_cascade(ACGL_timer_wheel_t* wheel, int level, Uint32 slot) {
+	Uint32 index = wheel->slots[level][slot];
+	wheel->slots[level][slot] = ACGL_TIMER_NIL;
+	while (index != ACGL_TIMER_NIL) {
+		Uint32 next = wheel->timers[index].next;
+		__acgl_timer_link(wheel, index);
+		index = next;
+	}
+}
+
+static bool __acgl_timer_push_batch(ACGL_timer_wheel_t* wheel, ACGL_timer_expiry_t expiry) {
+	if (wheel->batch_size == wheel->batch_capacity) {
+		size_t capacity = wheel->batch_capacity == 0 ? 64 : wheel->batch_capacity * 2;
+		ACGL_timer_expiry_t* batch = (ACGL_timer_expiry_t*)ACGL_realloc(ACGL_ALLOC_TIMER, wheel->batch, capacity * sizeof(ACGL_timer_expiry_t));
+		if (batch == NULL) {
+			fprintf(stderr, "Error! could not grow timer batch in ACGL_timer_wheel_advance\n");
+			return false;
+		}
+		wheel->batch = batch;
+		wheel->batch_capacity = capacity;
+	}
+	wheel->batch[wheel->batch_size++] = expiry;
+	return true;
+}
+
+// Collects up to limit expirations due by wheel tick `target` into wheel->batch.
+// When release is set, one-shot timers are freed right away instead of waiting
+// for dispatch. Call with the mutex held
+static void __acgl_timer_collect(ACGL_timer_wheel_t* wheel, Uint64 target, size_t limit, bool release) {
+	wheel->batch_size = 0;
+	if (wheel->active == 0 && wheel->now <= target) {
+		// nothing to find, don't walk every tick in between
+		wheel->now = target + 1;
+		return;
+	}
+
+	while (wheel->now <= target) {
+		Uint64 tick = wheel->now;
+		// at each level boundary, pull the next slot of the level above down.
+		// higher levels go first so their timers can cascade all the way
+		int levels = 0;
+		while (levels < ACGL_TIMER_LEVELS - 1 && ((tick >> (ACGL_TIMER_SLOTS_BITS * (levels + 1))) << (ACGL_TIMER_SLOTS_BITS * (levels + 1))) == tick) {
+			++levels;
+		}
+		for (int level = levels; level >= 1; --level) {
+			__acgl_timer_cascade(wheel, level, (Uint32)(tick >> (ACGL_TIMER_SLOTS_BITS * level)) & (ACGL_TIMER_SLOTS - 1));
+		}
+
+		Uint32* head = &wheel->slots[0][tick & (ACGL_TIMER_SLOTS - 1)];
+		while (*head != ACGL_TIMER_NIL) {
+			if (wheel->batch_size >= limit) {
+				// the rest of this tick stays due
+				return;
+			}
+			Uint32 index = *head;
+			ACGL_timer_t* timer = &wheel->timers[index];
+			ACGL_timer_expiry_t expiry = {
+				__acgl_timer_make_id(index, timer->generation),
+				timer->callback,
+				timer->data
+			};
+			if (!__acgl_timer_push_batch(wheel, expiry)) {
+				return;
+			}
+			__acgl_timer_unlink(wheel, index);
+
+			if (timer->period != 0) {
+				// stay on the original schedule, skipping the periods this
+				// advance is too late for: it fires once, not once per period
+				timer->expires += timer->period;
+				if (timer->expires <= target) {
+					timer->expires += ((target - timer->expires) / timer->period + 1) * timer->period;
+				}
+				__acgl_timer_link(wheel, index);
+			} else if (release) {
+				__acgl_timer_release(wheel, index);
+				--wheel->active;
+			} else {
+				timer->state = ACGL_TIMER_FIRING;
+				--wheel->active;
+			}
+		}
+		++wheel->now;
+	}
+}
+
+static Uint64 __acgl_timer_to_tick(ACGL_timer_wheel_t* wheel, Uint64 now) {
+	if (now < wheel->origin) {
+		return 0;
+	}
+	return (now - wheel->origin) / wheel->resolution;
+}
+
+ACGL_timer_wheel_t* ACGL_timer_wheel_create(Uint64 resolution) {
+	if (resolution == 0) {
+		fprintf(stderr, "Error! timer wheel resolution must be nonzero in ACGL_timer_wheel_create\n");
+		return NULL;
+	}
+
+	ACGL_timer_wheel_t* wheel = (ACGL_timer_wheel_t*)ACGL_malloc(ACGL_ALLOC_TIMER, sizeof(ACGL_timer_wheel_t));
+	if (wheel == NULL) {
+		fprintf(stderr, "Error! could not malloc timer wheel in ACGL_timer_wheel_create\n");
+		return NULL;
+	}
+	if (!ACGL_MUTEX_CREATE(wheel->mutex)) {
+		fprintf(stderr, "Could not create mutex in ACGL_timer_wheel_create! SDL Error: %s\n", SDL_GetError());
+		ACGL_free(wheel);
+		return NULL;
+	}
+
+	wheel->resolution = resolution;
+	wheel->origin = ACGL_clock_now();
+	wheel->now = 0;
+	wheel->active = 0;
+	wheel->timers = NULL;
+	wheel->timers_size = 0;
+	wheel->timers_capacity = 0;
+	wheel->free_list = ACGL_TIMER_NIL;
+	for (int level=0; level<ACGL_TIMER_LEVELS; ++level) {
+		for (int slot=0; slot<ACGL_TIMER_SLOTS; ++slot) {
+			wheel->slots[level][slot] = ACGL_TIMER_NIL;
+		}
+	}
+	wheel->batch = NULL;
+	wheel->batch_size = 0;
+	wheel->batch_capacity = 0;
+
+	return wheel;
+}
+
+void ACGL_timer_wheel_destroy(ACGL_timer_wheel_t* wheel) {
+	if (wheel == NULL) {
+		fprintf(stderr, "Error! cannot destroy NULL timer wheel in ACGL_timer_wheel_destroy\n");
+		return;
+	}
+	ACGL_MUTEX_DESTROY(wheel->mutex);
+	ACGL_free(wheel->timers);
+	wheel->timers = NULL;
+	ACGL_free(wheel->batch);
+	wheel->batch = NULL;
+	ACGL_free(wheel);
+}
+
+ACGL_timer_id_t ACGL_timer_add(ACGL_timer_wheel_t* wheel, Uint64 delay, Uint64 period, ACGL_timer_callback_t callback, void* data) {
+	REQUIRES(wheel != NULL);
+
+	if (ACGL_MUTEX_LOCK(wheel->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_timer_add! SDL_Error: %s\n", SDL_GetError());
+		return 0;
+	}
+
+	Uint32 index = wheel->free_list;
+	if (index != ACGL_TIMER_NIL) {
+		wheel->free_list = wheel->timers[index].next;
+	} else {
+		if (wheel->timers_size == wheel->timers_capacity) {
+			Uint32 capacity = wheel->timers_capacity == 0 ? 64 : wheel->timers_capacity * 2;
+			ACGL_timer_t* timers = (ACGL_timer_t*)ACGL_realloc(ACGL_ALLOC_TIMER, wheel->timers, (size_t)capacity * sizeof(ACGL_timer_t));
+			if (timers == NULL) {
+				fprintf(stderr, "Error! could not grow timer storage in ACGL_timer_add\n");
+				ACGL_MUTEX_UNLOCK(wheel->mutex);
+				return 0;
+			}
+			wheel->timers = timers;
+			wheel->timers_capacity = capacity;
+		}
+		index = wheel->timers_size++;
+		wheel->timers[index].generation = 1;
+	}
+
+	ACGL_timer_t* timer = &wheel->timers[index];
+	// round up, a timer should never fire early
+	timer->expires = __acgl_timer_to_tick(wheel, ACGL_clock_now() + delay + wheel->resolution - 1);
+	timer->period = period == 0 ? 0 : SDL_max((period + wheel->resolution - 1) / wheel->resolution, 1);
+	timer->callback = callback;
+	timer->data = data;
+	__acgl_timer_link(wheel, index);
+	++wheel->active;
+
+	ACGL_timer_id_t id = __acgl_timer_make_id(index, timer->generation);
+	ACGL_MUTEX_UNLOCK(wheel->mutex);
+	return id;
+}
+
+bool ACGL_timer_cancel(ACGL_timer_wheel_t* wheel, ACGL_timer_id_t id) {
+	REQUIRES(wheel != NULL);
+
+	if (ACGL_MUTEX_LOCK(wheel->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_timer_cancel! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	bool cancelled = false;
+	ACGL_timer_t* timer = __acgl_timer_lookup(wheel, id);
+	if (timer != NULL) {
+		Uint32 index = (Uint32)(timer - wheel->timers);
+		if (timer->state == ACGL_TIMER_SCHEDULED) {
+			__acgl_timer_unlink(wheel, index);
+			--wheel->active;
+		}
+		__acgl_timer_release(wheel, index);
+		cancelled = true;
+	}
+
+	ACGL_MUTEX_UNLOCK(wheel->mutex);
+	return cancelled;
+}
+
+size_t ACGL_timer_wheel_advance(ACGL_timer_wheel_t* wheel, Uint64 now) {
+	REQUIRES(wheel != NULL);
+
+	if (ACGL_MUTEX_LOCK(wheel->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_timer_wheel_advance! SDL_Error: %s\n", SDL_GetError());
+		return 0;
+	}
+	__acgl_timer_collect(wheel, __acgl_timer_to_tick(wheel, now), (size_t)-1, false);
+	ACGL_MUTEX_UNLOCK(wheel->mutex);
+
+	// callbacks run unlocked so they can add and cancel timers. anything
+	// cancelled after being collected is skipped here
+	size_t called = 0;
+	for (size_t i=0; i<wheel->batch_size; ++i) {
+		ACGL_timer_expiry_t* expiry = &wheel->batch[i];
+		ACGL_MUTEX_LOCK(wheel->mutex);
+		ACGL_timer_t* timer = __acgl_timer_lookup(wheel, expiry->id);
+		if (timer != NULL && timer->state == ACGL_TIMER_FIRING) {
+			__acgl_timer_release(wheel, (Uint32)(timer - wheel->timers));
+		}
+		ACGL_MUTEX_UNLOCK(wheel->mutex);
+
+		if (timer != NULL && expiry->callback != NULL) {
+			(*expiry->callback)(expiry->id, expiry->data);
+			++called;
+		}
+	}
+	wheel->batch_size = 0;
+
+	return called;
+}
+
+size_t ACGL_timer_wheel_poll(ACGL_timer_wheel_t* wheel, Uint64 now, ACGL_timer_expiry_t* out, size_t max) {
+	REQUIRES(wheel != NULL);
+	REQUIRES(out != NULL || max == 0);
+
+	if (ACGL_MUTEX_LOCK(wheel->mutex) != 0) {
+		fprintf(stderr, "Could not lock mutex in ACGL_timer_wheel_poll! SDL_Error: %s\n", SDL_GetError());
+		return 0;
+	}
+	__acgl_timer_collect(wheel, __acgl_timer_to_tick(wheel, now), max, true);
+	size_t collected = wheel->batch_size;
+	memcpy(out, wheel->batch, collected * sizeof(ACGL_timer_expiry_t));
+	wheel->batch_size = 0;
+	ACGL_MUTEX_UNLOCK(wheel->mutex);
+
+	return collected;
+}
+
+bool ACGL_timer_wheel_tick(void* wheel) {
+	ACGL_timer_wheel_advance((ACGL_timer_wheel_t*)wheel, ACGL_clock_now());
+	return true;
+}
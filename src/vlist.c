@@ -0,0 +1,484 @@
+#include "vlist.h"
+#include "gui_safety.h"
+#include "alloc.h"
+#include "contracts.h"
+#include <string.h>
+
+static ACGL_gui_pos_t __acgl_vlist_row_extent(const ACGL_vlist_t* list, size_t row) {
+	if (list->measured != NULL && list->measured[row] >= 0) {
+		return list->measured[row];
+	}
+	return list->extent;
+}
+
+// The tree is 1-based: tree[i] holds the extents of the rows in
+// (i - lowbit(i), i], so sums and searches take O(log rows)
+static void __acgl_vlist_tree_build(ACGL_vlist_t* list) {
+	double* tree = list->tree;
+	tree[0] = 0;
+	for (size_t i = 1; i <= list->rows; ++i) {
+		tree[i] = __acgl_vlist_row_extent(list, i - 1);
+	}
+	for (size_t i = 1; i <= list->rows; ++i) {
+		size_t parent = i + (i & (0 - i));
+		if (parent <= list->rows) {
+			tree[parent] += tree[i];
+		}
+	}
+}
+
+static void __acgl_vlist_tree_add(ACGL_vlist_t* list, size_t row, double delta) {
+	for (size_t i = row + 1; i <= list->rows; i += i & (0 - i)) {
+		list->tree[i] += delta;
+	}
+}
+
+// Returns: where row starts, the extent of all rows before it
+static double __acgl_vlist_offset(const ACGL_vlist_t* list, size_t row) {
+	if (list->tree == NULL) {
+		return (double)row * list->extent;
+	}
+	double offset = 0;
+	for (size_t i = row; i > 0; i -= i & (0 - i)) {
+		offset += list->tree[i];
+	}
+	return offset;
+}
+
+// Returns: the row at offset, clamped to the rows there are.
+// REQUIRES: list->rows > 0
+static size_t __acgl_vlist_row_at(const ACGL_vlist_t* list, double offset) {
+	if (offset <= 0) {
+		return 0;
+	}
+	size_t row;
+	if (list->tree == NULL) {
+		double at = offset / list->extent;
+		row = at < (double)list->rows ? (size_t)at : list->rows;
+	} else {
+		// skip every block of rows that ends at or before offset
+		size_t step = 1;
+		while (step <= list->rows / 2) {
+			step *= 2;
+		}
+		row = 0;
+		for (; step > 0; step /= 2) {
+			if (row + step <= list->rows && list->tree[row + step] <= offset) {
+				row += step;
+				offset -= list->tree[row];
+			}
+		}
+	}
+	return row < list->rows ? row : list->rows - 1;
+}
+
+// Measures the rows in [first, end) that never were.
+// Returns: whether there were any, moving the rows after them
+static bool __acgl_vlist_measure(ACGL_vlist_t* list, size_t first, size_t end) {
+	bool measured = false;
+	for (size_t row = first; row < end; ++row) {
+		if (list->measured[row] >= 0) {
+			continue;
+		}
+		ACGL_gui_pos_t extent = (*list->measure)(list, row, list->data);
+		if (!(extent >= 0)) {
+			extent = 0;
+		}
+		list->measured[row] = extent;
+		__acgl_vlist_tree_add(list, row, (double)extent - list->extent);
+		measured = true;
+	}
+	return measured;
+}
+
+// Sets up the per row state for count items in rows of columns.
+// Returns: false if out of memory, with nothing changed
+static bool __acgl_vlist_resize(ACGL_vlist_t* list, size_t count, size_t columns, ACGL_vlist_measure_t measure) {
+	size_t rows = (count + columns - 1) / columns;
+	double* tree = NULL;
+	float* measured = NULL;
+	if (measure != NULL) {
+		// the tree and the measurements in one allocation
+		tree = (double*)ACGL_malloc(ACGL_ALLOC_GUI, (rows + 1) * sizeof(double) + rows * sizeof(float));
+		if (tree == NULL) {
+			return false;
+		}
+		measured = (float*)(tree + rows + 1);
+		// rows hold the same items as long as columns stays, so their
+		// measurements do too
+		size_t kept = 0;
+		if (list->measured != NULL && list->measure == measure && list->columns == columns) {
+			kept = rows < list->rows ? rows : list->rows;
+			memcpy(measured, list->measured, kept * sizeof(float));
+		}
+		for (size_t row = kept; row < rows; ++row) {
+			measured[row] = -1;
+		}
+	}
+	ACGL_free(list->tree);
+	list->tree = tree;
+	list->measured = measured;
+	list->measure = measure;
+	list->count = count;
+	list->columns = columns;
+	list->rows = rows;
+	if (tree != NULL) {
+		__acgl_vlist_tree_build(list);
+	}
+	return true;
+}
+
+static bool __acgl_vlist_reserve(ACGL_vlist_t* list, size_t capacity) {
+	ACGL_vlist_slot_t* slots = (ACGL_vlist_slot_t*)ACGL_realloc(ACGL_ALLOC_GUI, list->slots, capacity * sizeof(ACGL_vlist_slot_t));
+	if (slots == NULL) {
+		return false;
+	}
+	list->slots = slots;
+	ACGL_vlist_slot_t* back = (ACGL_vlist_slot_t*)ACGL_realloc(ACGL_ALLOC_GUI, list->back, capacity * sizeof(ACGL_vlist_slot_t));
+	if (back == NULL) {
+		return false;
+	}
+	list->back = back;
+	list->slots_capacity = capacity;
+	return true;
+}
+
+// Puts node at [along, along + extent) down the list and [across, across +
+// size) of the way across it. REQUIRES: node is locked.
+// Returns: whether the node moved
+static bool __acgl_vlist_place(const ACGL_vlist_t* list, ACGL_gui_object_t* node, ACGL_gui_pos_t along, ACGL_gui_pos_t extent, ACGL_gui_pos_t across, ACGL_gui_pos_t size) {
+	ACGL_gui_pos_t x = list->horizontal ? along : across;
+	ACGL_gui_pos_t y = list->horizontal ? across : along;
+	ACGL_gui_pos_t w = list->horizontal ? extent : size;
+	ACGL_gui_pos_t h = list->horizontal ? size : extent;
+	// the placement math adds nothing to x and y for this anchor
+	int anchor = ACGL_GUI_ANCHOR_TOP + ACGL_GUI_ANCHOR_RIGHT;
+	if (node->anchor == anchor && node->node_type == ACGL_GUI_NODE_FIXED_SIZE
+		&& node->x == x && node->y == y && node->w == w && node->h == h
+		&& node->x_frac == !list->horizontal && node->y_frac == list->horizontal
+		&& node->w_frac == !list->horizontal && node->h_frac == list->horizontal
+		&& node->min_w == ACGL_GUI_DIM_NONE && node->min_h == ACGL_GUI_DIM_NONE
+		&& node->max_w == ACGL_GUI_DIM_NONE && node->max_h == ACGL_GUI_DIM_NONE) {
+		return false;
+	}
+	node->anchor = anchor;
+	node->node_type = ACGL_GUI_NODE_FIXED_SIZE;
+	node->x = x;
+	node->y = y;
+	node->w = w;
+	node->h = h;
+	node->x_frac = !list->horizontal;
+	node->y_frac = list->horizontal;
+	node->w_frac = !list->horizontal;
+	node->h_frac = list->horizontal;
+	node->min_w = ACGL_GUI_DIM_NONE;
+	node->min_h = ACGL_GUI_DIM_NONE;
+	node->max_w = ACGL_GUI_DIM_NONE;
+	node->max_h = ACGL_GUI_DIM_NONE;
+	node->needs_layout = true;
+	return true;
+}
+
+static bool __acgl_vlist_render(SDL_Window* window, SDL_Rect rect, void* data) {
+	ACGL_vlist_t* list = (ACGL_vlist_t*)data;
+	if (!SDL_RectEquals(&rect, &list->viewport)) {
+		// the rows were placed for another rect, the next update fixes that
+		ACGL_gui_request_render(list->gui);
+	}
+	if (list->background != NULL) {
+		return (*list->background)(window, rect, list->background_data);
+	}
+	return false;
+}
+
+static void __acgl_vlist_free(void* data) {
+	ACGL_vlist_t* list = (ACGL_vlist_t*)data;
+	// the bound nodes went with the container, the spare ones are off the tree
+	for (size_t i = list->slots_bound; i < list->slots_size; ++i) {
+		ACGL_gui_node_destroy(list->slots[i].node);
+	}
+	ACGL_free(list->slots);
+	ACGL_free(list->back);
+	ACGL_free(list->tree);
+	ACGL_free(list);
+}
+
+ACGL_vlist_t* ACGL_vlist_create(ACGL_gui_t* gui, ACGL_vlist_bind_t bind, void* data) {
+	REQUIRES(__ACGL_is_gui_t(gui));
+	REQUIRES(bind != NULL);
+
+	ACGL_vlist_t* list = (ACGL_vlist_t*)ACGL_calloc(ACGL_ALLOC_GUI, 1, sizeof(ACGL_vlist_t));
+	if (list == NULL) {
+		fprintf(stderr, "Error! could not malloc list in ACGL_vlist_create\n");
+		return NULL;
+	}
+	list->node = ACGL_gui_node_init(gui, __acgl_vlist_render, __acgl_vlist_free, list);
+	if (list->node == NULL) {
+		ACGL_free(list);
+		return NULL;
+	}
+	// overscan rows lie past the viewport, they are culled until scrolled in
+	list->node->clip_children = true;
+	list->gui = gui;
+	list->bind = bind;
+	list->data = data;
+	list->overscan = 2;
+	list->columns = 1;
+	list->extent = 24;
+	list->scroll_item = ACGL_VLIST_NONE;
+	return list;
+}
+
+int ACGL_vlist_set_count(ACGL_vlist_t* list, size_t count) {
+	REQUIRES(list != NULL);
+	if (!__acgl_vlist_resize(list, count, list->columns, list->measure)) {
+		fprintf(stderr, "Error! could not malloc rows in ACGL_vlist_set_count\n");
+		return -1;
+	}
+	return 0;
+}
+
+int ACGL_vlist_set_columns(ACGL_vlist_t* list, size_t columns) {
+	REQUIRES(list != NULL);
+	REQUIRES(columns > 0);
+	if (!__acgl_vlist_resize(list, list->count, columns, list->measure)) {
+		fprintf(stderr, "Error! could not malloc rows in ACGL_vlist_set_columns\n");
+		return -1;
+	}
+	return 0;
+}
+
+int ACGL_vlist_set_measure(ACGL_vlist_t* list, ACGL_vlist_measure_t measure) {
+	REQUIRES(list != NULL);
+	if (!__acgl_vlist_resize(list, list->count, list->columns, measure)) {
+		fprintf(stderr, "Error! could not malloc rows in ACGL_vlist_set_measure\n");
+		return -1;
+	}
+	return 0;
+}
+
+void ACGL_vlist_set_extent(ACGL_vlist_t* list, ACGL_gui_pos_t extent) {
+	REQUIRES(list != NULL);
+	REQUIRES(extent > 0);
+	list->extent = extent;
+	if (list->tree != NULL) {
+		__acgl_vlist_tree_build(list);
+	}
+}
+
+void ACGL_vlist_invalidate(ACGL_vlist_t* list, size_t first, size_t count) {
+	REQUIRES(list != NULL);
+	if (first >= list->count || count == 0) {
+		return;
+	}
+	size_t end = count < list->count - first ? first + count : list->count;
+	for (size_t i = 0; i < list->slots_bound; ++i) {
+		ACGL_vlist_slot_t* slot = &list->slots[i];
+		if (slot->index >= first && slot->index < end) {
+			slot->stale = true;
+		}
+	}
+	if (list->measured == NULL) {
+		return;
+	}
+	for (size_t row = first / list->columns; row <= (end - 1) / list->columns; ++row) {
+		if (list->measured[row] >= 0) {
+			__acgl_vlist_tree_add(list, row, (double)list->extent - list->measured[row]);
+			list->measured[row] = -1;
+		}
+	}
+}
+
+void ACGL_vlist_scroll_to(ACGL_vlist_t* list, ACGL_gui_pos_t offset) {
+	REQUIRES(list != NULL);
+	list->scroll = offset;
+	list->scroll_item = ACGL_VLIST_NONE;
+}
+
+void ACGL_vlist_scroll_by(ACGL_vlist_t* list, ACGL_gui_pos_t delta) {
+	REQUIRES(list != NULL);
+	list->scroll += delta;
+	list->scroll_item = ACGL_VLIST_NONE;
+}
+
+void ACGL_vlist_scroll_to_item(ACGL_vlist_t* list, size_t index) {
+	REQUIRES(list != NULL);
+	REQUIRES(index < list->count);
+	list->scroll_item = index;
+}
+
+ACGL_gui_pos_t ACGL_vlist_content_extent(const ACGL_vlist_t* list) {
+	REQUIRES(list != NULL);
+	return (ACGL_gui_pos_t)__acgl_vlist_offset(list, list->rows);
+}
+
+// Hands the nodes of the items that left [first, end) to the ones that came
+// in, spare nodes after those. REQUIRES: the container is locked and there
+// are at least end - first slots. Returns: whether the tree changed
+static bool __acgl_vlist_recycle(ACGL_vlist_t* list, size_t first, size_t end) {
+	size_t old_first = list->first_item;
+	size_t old_end = old_first + list->slots_bound;
+	size_t keep_first = first > old_first ? first : old_first;
+	size_t keep_end = end < old_end ? end : old_end;
+	if (keep_first >= keep_end) {
+		keep_first = keep_end = end;
+	}
+	if (first == old_first && end == old_end) {
+		return false;
+	}
+
+	ACGL_vlist_slot_t* slots = list->slots;
+	ACGL_vlist_slot_t* back = list->back;
+	for (size_t index = keep_first; index < keep_end; ++index) {
+		back[index - first] = slots[index - old_first];
+	}
+	// slots[from] is the next one with a node to spare
+	size_t from = 0;
+	for (size_t index = first; index < end; ++index) {
+		if (index == keep_first) {
+			index = keep_end - 1;
+			continue;
+		}
+		if (from == keep_first - old_first && keep_first < keep_end) {
+			from = keep_end - old_first;
+		}
+		ACGL_vlist_slot_t* slot = &back[index - first];
+		slot->node = slots[from].node;
+		slot->index = index;
+		slot->stale = true;
+		if (from >= list->slots_bound) {
+			ACGL_gui_node_add_child_back(list->node, slot->node);
+		}
+		++from;
+	}
+	size_t size = end - first;
+	for (; from < list->slots_size; ++from) {
+		if (from == keep_first - old_first && keep_first < keep_end) {
+			from = keep_end - old_first - 1;
+			continue;
+		}
+		if (from < list->slots_bound) {
+			ACGL_gui_node_remove_child(list->node, slots[from].node);
+		}
+		back[size++] = slots[from];
+	}
+	ENSURES(size == list->slots_size);
+
+	list->slots = back;
+	list->back = slots;
+	list->slots_bound = end - first;
+	list->first_item = first;
+	return true;
+}
+
+int ACGL_vlist_update(ACGL_vlist_t* list) {
+	REQUIRES(list != NULL);
+
+	ACGL_gui_object_t* container = list->node;
+	if (ACGL_MUTEX_LOCK(container->mutex) != 0) {
+		fprintf(stderr, "Could not lock container mutex in ACGL_vlist_update. SDL_Error: %s\n", SDL_GetError());
+		return -1;
+	}
+	SDL_Rect viewport = container->rect;
+	double length = list->horizontal ? viewport.w : viewport.h;
+
+	// the rows in view and overscan; measuring them moves the ones after,
+	// which may bring more into view
+	size_t first_row = 0;
+	size_t end_row = 0;
+	do {
+		if (list->scroll_item < list->count) {
+			size_t row = list->scroll_item / list->columns;
+			double start = __acgl_vlist_offset(list, row);
+			double end = start + __acgl_vlist_row_extent(list, row);
+			if (start < list->scroll) {
+				list->scroll = start;
+			} else if (end > list->scroll + length) {
+				list->scroll = end - length;
+			}
+		}
+		double limit = __acgl_vlist_offset(list, list->rows) - length;
+		if (list->scroll > limit) {
+			list->scroll = limit;
+		}
+		if (list->scroll < 0) {
+			list->scroll = 0;
+		}
+		if (list->rows == 0 || length <= 0) {
+			break;
+		}
+		first_row = __acgl_vlist_row_at(list, list->scroll);
+		end_row = __acgl_vlist_row_at(list, list->scroll + length) + 1;
+		first_row = first_row > list->overscan ? first_row - list->overscan : 0;
+		end_row = list->rows - end_row > list->overscan ? end_row + list->overscan : list->rows;
+	} while (list->measure != NULL && __acgl_vlist_measure(list, first_row, end_row));
+	list->scroll_item = ACGL_VLIST_NONE;
+
+	size_t first = first_row * list->columns;
+	size_t end = end_row * list->columns < list->count ? end_row * list->columns : list->count;
+	size_t wanted = end - first;
+	if (wanted > list->slots_capacity && !__acgl_vlist_reserve(list, wanted)) {
+		fprintf(stderr, "Error! could not grow slots in ACGL_vlist_update\n");
+		ACGL_MUTEX_UNLOCK(container->mutex);
+		return -1;
+	}
+	if (wanted > list->slots_size) {
+		// back is free until the recycling, and big enough for the pointers
+		size_t missing = wanted - list->slots_size;
+		ACGL_gui_object_t** nodes = (ACGL_gui_object_t**)list->back;
+		if (!ACGL_gui_node_init_many(list->gui, nodes, missing)) {
+			ACGL_MUTEX_UNLOCK(container->mutex);
+			return -1;
+		}
+		for (size_t i = 0; i < missing; ++i) {
+			ACGL_vlist_slot_t* slot = &list->slots[list->slots_size + i];
+			slot->node = nodes[i];
+			slot->index = 0;
+			slot->stale = true;
+		}
+		list->slots_size = wanted;
+	}
+	bool changed = __acgl_vlist_recycle(list, first, end);
+
+	// items that stayed are only moved
+	bool rebound = false;
+	double start = __acgl_vlist_offset(list, first_row) - list->scroll;
+	size_t row = first_row;
+	ACGL_gui_pos_t size = 1.0f / (ACGL_gui_pos_t)list->columns;
+	for (size_t i = 0; i < list->slots_bound; ++i) {
+		ACGL_vlist_slot_t* slot = &list->slots[i];
+		if (slot->index / list->columns != row) {
+			start += __acgl_vlist_row_extent(list, row);
+			++row;
+		}
+		// whole pixels, so rows neither overlap nor leave gaps
+		double along = SDL_floor(start + 0.5);
+		double extent = SDL_floor(start + __acgl_vlist_row_extent(list, row) + 0.5) - along;
+		ACGL_gui_pos_t across = (ACGL_gui_pos_t)(slot->index % list->columns) * size;
+
+		ACGL_gui_object_t* node = slot->node;
+		if (ACGL_MUTEX_LOCK(node->mutex) != 0) {
+			fprintf(stderr, "Could not lock row mutex in ACGL_vlist_update. SDL_Error: %s\n", SDL_GetError());
+			continue;
+		}
+		if (slot->stale) {
+			(*list->bind)(list, node, slot->index, list->data);
+			node->needs_update = true;
+			slot->stale = false;
+			rebound = true;
+		}
+		changed |= __acgl_vlist_place(list, node, (ACGL_gui_pos_t)along, (ACGL_gui_pos_t)extent, across, size);
+		ACGL_MUTEX_UNLOCK(node->mutex);
+	}
+	if (changed) {
+		// whatever the rows left behind has to be painted over
+		container->needs_update = true;
+	}
+	list->viewport = viewport;
+	ACGL_MUTEX_UNLOCK(container->mutex);
+
+	if (changed || rebound) {
+		ACGL_gui_request_render(list->gui);
+	}
+	return 0;
+}
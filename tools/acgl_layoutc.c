@@ -0,0 +1,363 @@
+// Compiles the text form of a layout into the binary format of layout.h.
+//
+//   acgl_layoutc screen.layout screen.acgl
+//
+// The text form is a tree of nodes. Attributes left out keep the defaults of
+// ACGL_gui_node_init, and # starts a comment:
+//
+//   node anchor=top+left w=100% h=48 callback=title_bar {
+//     node type=fixed x=8 y=8 w=32 h=32 callback=icon
+//     node x=48 w=50% min_w=120 max_w=none
+//   }
+//
+// Sizes are numbers of pixels, or percentages of the parent with a trailing %
+// (x, y, w and h only). min_*/max_* also take "none". Nodes fill their parent
+// until given a w or h, or w=fill/h=fill makes them fill it that way again.
+// anchor joins center, top, left, bottom and right with +, type joins fixed,
+// fill_w, fill_h and aspect the same way. type sets every one of them, so it
+// goes before w and h. opaque is yes or no.
+#include "layout.h"
+#include <string.h>
+#include <errno.h>
+
+#define LAYOUTC_MAX_DEPTH 256
+
+typedef struct {
+	const char* text;
+	size_t pos;
+	int line;
+	const char* path;
+	char token[256];
+} layoutc_lexer_t;
+
+typedef struct {
+	ACGL_layout_node_t* nodes;
+	Uint32 nodes_size, nodes_capacity;
+	ACGL_layout_symbol_t* callbacks;
+	Uint32 callbacks_size, callbacks_capacity;
+	char* strings;
+	Uint32 strings_size, strings_capacity;
+} layoutc_output_t;
+
+static void layoutc_error(layoutc_lexer_t* lexer, const char* message) {
+	fprintf(stderr, "%s:%d: error: %s\n", lexer->path, lexer->line, message);
+	exit(1);
+}
+
+static void* layoutc_grow(void* array, Uint32* capacity, size_t elem_size) {
+	*capacity = *capacity > 0 ? *capacity * 2 : 64;
+	array = realloc(array, *capacity * elem_size);
+	if (array == NULL) {
+		fprintf(stderr, "error: out of memory\n");
+		exit(1);
+	}
+	return array;
+}
+
+// Reads the next token: "{", "}", or a run of anything else up to whitespace.
+// Returns: false at the end of the text
+static bool layoutc_next(layoutc_lexer_t* lexer) {
+	const char* text = lexer->text;
+	for (;;) {
+		char c = text[lexer->pos];
+		if (c == '\n') {
+			++lexer->line;
+			++lexer->pos;
+		} else if (c == ' ' || c == '\t' || c == '\r') {
+			++lexer->pos;
+		} else if (c == '#') {
+			while (text[lexer->pos] != '\0' && text[lexer->pos] != '\n') {
+				++lexer->pos;
+			}
+		} else {
+			break;
+		}
+	}
+	if (text[lexer->pos] == '\0') {
+		return false;
+	}
+	size_t length = 0;
+	if (text[lexer->pos] == '{' || text[lexer->pos] == '}') {
+		lexer->token[length++] = text[lexer->pos++];
+	} else {
+		while (strchr(" \t\r\n{}#", text[lexer->pos]) == NULL) {
+			if (length + 1 >= sizeof(lexer->token)) {
+				layoutc_error(lexer, "token too long");
+			}
+			lexer->token[length++] = text[lexer->pos++];
+		}
+	}
+	lexer->token[length] = '\0';
+	return true;
+}
+
+// Parses a size. Returns: true if it ended in %, with value scaled to a fraction
+static bool layoutc_size(layoutc_lexer_t* lexer, const char* value, float* out, bool allow_frac) {
+	if (!allow_frac && strcmp(value, "none") == 0) {
+		*out = ACGL_GUI_DIM_NONE;
+		return false;
+	}
+	char* end;
+	errno = 0;
+	float number = strtof(value, &end);
+	if (end == value || errno != 0) {
+		layoutc_error(lexer, "expected a number");
+	}
+	if (*end == '%' && end[1] == '\0' && allow_frac) {
+		*out = number / 100.0f;
+		return true;
+	}
+	if (*end != '\0') {
+		layoutc_error(lexer, allow_frac ? "expected a number or a percentage" : "expected a number");
+	}
+	*out = number;
+	return false;
+}
+
+// Parses names joined with +, e.g. top+left. Returns: the values added up
+static int layoutc_flags(layoutc_lexer_t* lexer, const char* value, const char* const names[], const int values[], int count) {
+	int result = 0;
+	while (*value != '\0') {
+		size_t length = strcspn(value, "+");
+		int i = 0;
+		while (i < count && (strlen(names[i]) != length || strncmp(names[i], value, length) != 0)) {
+			++i;
+		}
+		if (i == count) {
+			layoutc_error(lexer, "unknown anchor or node type");
+		}
+		result += values[i];
+		value += length;
+		if (*value == '+') {
+			++value;
+		}
+	}
+	return result;
+}
+
+static Uint32 layoutc_callback(layoutc_output_t* output, const char* name) {
+	Uint32 length = (Uint32)strlen(name);
+	for (Uint32 i = 0; i < output->callbacks_size; ++i) {
+		ACGL_layout_symbol_t* symbol = &output->callbacks[i];
+		if (symbol->length == length && memcmp(output->strings + symbol->offset, name, length) == 0) {
+			return i;
+		}
+	}
+	if (output->callbacks_size == output->callbacks_capacity) {
+		output->callbacks = (ACGL_layout_symbol_t*)layoutc_grow(output->callbacks, &output->callbacks_capacity, sizeof(ACGL_layout_symbol_t));
+	}
+	while (output->strings_size + length > output->strings_capacity) {
+		output->strings = (char*)layoutc_grow(output->strings, &output->strings_capacity, 1);
+	}
+	ACGL_layout_symbol_t* symbol = &output->callbacks[output->callbacks_size];
+	symbol->offset = output->strings_size;
+	symbol->length = length;
+	memcpy(output->strings + output->strings_size, name, length);
+	output->strings_size += length;
+	return output->callbacks_size++;
+}
+
+static void layoutc_attribute(layoutc_lexer_t* lexer, layoutc_output_t* output, ACGL_layout_node_t* node) {
+	static const char* const anchor_names[] = { "center", "top", "left", "bottom", "right" };
+	static const int anchor_values[] = {
+		ACGL_GUI_ANCHOR_CENTER, ACGL_GUI_ANCHOR_TOP, ACGL_GUI_ANCHOR_LEFT, ACGL_GUI_ANCHOR_BOTTOM, ACGL_GUI_ANCHOR_RIGHT,
+	};
+	static const char* const type_names[] = { "fixed", "fill_w", "fill_h", "aspect" };
+	static const int type_values[] = {
+		ACGL_GUI_NODE_FIXED_SIZE, ACGL_GUI_NODE_FILL_W, ACGL_GUI_NODE_FILL_H, ACGL_GUI_NODE_PRESERVE_ASPECT,
+	};
+
+	char* value = strchr(lexer->token, '=');
+	if (value == NULL) {
+		layoutc_error(lexer, "expected key=value");
+	}
+	*value++ = '\0';
+	const char* key = lexer->token;
+
+	if (strcmp(key, "x") == 0 || strcmp(key, "y") == 0 || strcmp(key, "w") == 0 || strcmp(key, "h") == 0) {
+		static const char* const keys = "xywh";
+		static const Uint8 frac_flags[] = { ACGL_LAYOUT_X_FRAC, ACGL_LAYOUT_Y_FRAC, ACGL_LAYOUT_W_FRAC, ACGL_LAYOUT_H_FRAC };
+		static const Uint8 fill_types[] = { 0, 0, ACGL_GUI_NODE_FILL_W, ACGL_GUI_NODE_FILL_H };
+		int i = (int)(strchr(keys, key[0]) - keys);
+		float* fields[] = { &node->x, &node->y, &node->w, &node->h };
+		// placement only looks at w and h when the node doesn't fill that way
+		if (i >= 2 && strcmp(value, "fill") == 0) {
+			node->node_type |= fill_types[i];
+			return;
+		}
+		node->node_type &= (Uint8)~fill_types[i];
+		if (layoutc_size(lexer, value, fields[i], true)) {
+			node->flags |= frac_flags[i];
+		} else {
+			node->flags &= (Uint8)~frac_flags[i];
+		}
+	} else if (strcmp(key, "min_w") == 0) {
+		layoutc_size(lexer, value, &node->min_w, false);
+	} else if (strcmp(key, "min_h") == 0) {
+		layoutc_size(lexer, value, &node->min_h, false);
+	} else if (strcmp(key, "max_w") == 0) {
+		layoutc_size(lexer, value, &node->max_w, false);
+	} else if (strcmp(key, "max_h") == 0) {
+		layoutc_size(lexer, value, &node->max_h, false);
+	} else if (strcmp(key, "anchor") == 0) {
+		node->anchor = (Uint8)layoutc_flags(lexer, value, anchor_names, anchor_values, 5);
+	} else if (strcmp(key, "type") == 0) {
+		node->node_type = (Uint8)layoutc_flags(lexer, value, type_names, type_values, 4);
+	} else if (strcmp(key, "opaque") == 0) {
+		if (strcmp(value, "yes") == 0) {
+			node->flags |= ACGL_LAYOUT_OPAQUE;
+		} else if (strcmp(value, "no") == 0) {
+			node->flags &= (Uint8)~ACGL_LAYOUT_OPAQUE;
+		} else {
+			layoutc_error(lexer, "expected yes or no");
+		}
+	} else if (strcmp(key, "callback") == 0) {
+		if (*value == '\0') {
+			layoutc_error(lexer, "empty callback name");
+		}
+		node->callback = layoutc_callback(output, value);
+	} else {
+		layoutc_error(lexer, "unknown attribute");
+	}
+}
+
+static void layoutc_parse(layoutc_lexer_t* lexer, layoutc_output_t* output) {
+	// indices of the nodes whose { is still open
+	Uint32 open[LAYOUTC_MAX_DEPTH];
+	int depth = 0;
+	bool has_root = false;
+	Sint64 current = -1; // node whose attributes are being read
+
+	while (layoutc_next(lexer)) {
+		if (strcmp(lexer->token, "node") == 0) {
+			if (depth == 0 && has_root) {
+				layoutc_error(lexer, "a layout has exactly one root node");
+			}
+			if (output->nodes_size == output->nodes_capacity) {
+				output->nodes = (ACGL_layout_node_t*)layoutc_grow(output->nodes, &output->nodes_capacity, sizeof(ACGL_layout_node_t));
+			}
+			// same defaults as ACGL_gui_node_init
+			ACGL_layout_node_t* node = &output->nodes[output->nodes_size];
+			memset(node, 0, sizeof(ACGL_layout_node_t));
+			node->w = 1;
+			node->h = 1;
+			node->min_w = ACGL_GUI_DIM_NONE;
+			node->min_h = ACGL_GUI_DIM_NONE;
+			node->max_w = ACGL_GUI_DIM_NONE;
+			node->max_h = ACGL_GUI_DIM_NONE;
+			node->callback = ACGL_LAYOUT_NO_CALLBACK;
+			node->anchor = ACGL_GUI_ANCHOR_CENTER;
+			node->node_type = ACGL_GUI_NODE_FILL_H + ACGL_GUI_NODE_FILL_W;
+			if (depth > 0) {
+				++output->nodes[open[depth - 1]].child_count;
+			}
+			has_root = true;
+			current = output->nodes_size++;
+		} else if (strcmp(lexer->token, "{") == 0) {
+			if (current < 0) {
+				layoutc_error(lexer, "{ has to follow a node");
+			}
+			if (depth == LAYOUTC_MAX_DEPTH) {
+				layoutc_error(lexer, "nodes are nested too deeply");
+			}
+			open[depth++] = (Uint32)current;
+			current = -1;
+		} else if (strcmp(lexer->token, "}") == 0) {
+			if (depth == 0) {
+				layoutc_error(lexer, "unmatched }");
+			}
+			--depth;
+			current = -1;
+		} else {
+			if (current < 0) {
+				layoutc_error(lexer, "attributes have to follow a node");
+			}
+			layoutc_attribute(lexer, output, &output->nodes[current]);
+		}
+	}
+	if (depth != 0) {
+		layoutc_error(lexer, "missing }");
+	}
+	if (!has_root) {
+		layoutc_error(lexer, "no nodes");
+	}
+}
+
+static char* layoutc_read(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "error: could not open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	size_t size = 0, capacity = 4096;
+	char* text = (char*)malloc(capacity);
+	while (text != NULL) {
+		size += fread(text + size, 1, capacity - size - 1, file);
+		if (size < capacity - 1) {
+			break;
+		}
+		capacity *= 2;
+		char* grown = (char*)realloc(text, capacity);
+		if (grown == NULL) {
+			free(text);
+		}
+		text = grown;
+	}
+	fclose(file);
+	if (text == NULL) {
+		fprintf(stderr, "error: out of memory\n");
+		return NULL;
+	}
+	text[size] = '\0';
+	return text;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s input.layout output.acgl\n", argv[0]);
+		return 2;
+	}
+#if SDL_BYTEORDER != SDL_LIL_ENDIAN
+	fprintf(stderr, "error: layouts can only be written on little-endian machines\n");
+	return 1;
+#endif
+	char* text = layoutc_read(argv[1]);
+	if (text == NULL) {
+		return 1;
+	}
+	layoutc_lexer_t lexer = { text, 0, 1, argv[1], { 0 } };
+	layoutc_output_t output;
+	memset(&output, 0, sizeof(output));
+	layoutc_parse(&lexer, &output);
+
+	ACGL_layout_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ACGL_LAYOUT_MAGIC, sizeof(header.magic));
+	header.version = ACGL_LAYOUT_VERSION;
+	header.node_count = output.nodes_size;
+	header.callback_count = output.callbacks_size;
+	header.strings_size = output.strings_size;
+
+	FILE* file = fopen(argv[2], "wb");
+	if (file == NULL) {
+		fprintf(stderr, "error: could not create %s: %s\n", argv[2], strerror(errno));
+		return 1;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(output.nodes, sizeof(ACGL_layout_node_t), output.nodes_size, file) == output.nodes_size
+		&& fwrite(output.callbacks, sizeof(ACGL_layout_symbol_t), output.callbacks_size, file) == output.callbacks_size
+		&& fwrite(output.strings, 1, output.strings_size, file) == output.strings_size;
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "error: could not write %s\n", argv[2]);
+		remove(argv[2]);
+		return 1;
+	}
+	printf("%s: %u nodes, %u callbacks\n", argv[2], output.nodes_size, output.callbacks_size);
+
+	free(output.nodes);
+	free(output.callbacks);
+	free(output.strings);
+	free(text);
+	return 0;
+}